@@ -47,6 +47,63 @@ void EpdFont::getTextDimensions(const char* string, int* w, int* h) const {
   *h = maxY - minY;
 }
 
+// Missing glyphs measure as the replacement glyph, or not at all without one, the same as getTextBounds
+int EpdFont::getGlyphAdvance(const uint32_t cp) const {
+  const EpdGlyph* glyph = getGlyph(cp);
+  if (!glyph) {
+    glyph = getGlyph(REPLACEMENT_GLYPH);
+  }
+  return glyph ? glyph->advanceX : 0;
+}
+
+const uint8_t* EpdFont::getAdvanceTable() const {
+  const uint8_t* table = advanceTable.load(std::memory_order_acquire);
+  if (table) {
+    return table;
+  }
+
+  auto* built = new uint8_t[ADVANCE_TABLE_SIZE];
+  for (uint32_t cp = 0; cp < LATIN_END; cp++) {
+    built[cp] = getGlyphAdvance(cp);
+  }
+  for (uint32_t cp = PUNCTUATION_START; cp < PUNCTUATION_END; cp++) {
+    built[LATIN_END + cp - PUNCTUATION_START] = getGlyphAdvance(cp);
+  }
+
+  // Layout on the prefetch task and drawing on the render task can get here together; keep whichever table landed
+  if (!advanceTable.compare_exchange_strong(table, built, std::memory_order_acq_rel)) {
+    delete[] built;
+    return table;
+  }
+  return built;
+}
+
+int EpdFont::getAdvance(const uint32_t cp) const {
+  if (cp < LATIN_END) {
+    return getAdvanceTable()[cp];
+  }
+  if (cp >= PUNCTUATION_START && cp < PUNCTUATION_END) {
+    return getAdvanceTable()[LATIN_END + cp - PUNCTUATION_START];
+  }
+  return getGlyphAdvance(cp);
+}
+
+int EpdFont::getTextAdvance(const char* string) const {
+  const uint8_t* table = getAdvanceTable();
+  int width = 0;
+  uint32_t cp;
+  while ((cp = utf8NextCodepoint(reinterpret_cast<const uint8_t**>(&string)))) {
+    if (cp < LATIN_END) {
+      width += table[cp];
+    } else if (cp >= PUNCTUATION_START && cp < PUNCTUATION_END) {
+      width += table[LATIN_END + cp - PUNCTUATION_START];
+    } else {
+      width += getGlyphAdvance(cp);
+    }
+  }
+  return width;
+}
+
 bool EpdFont::hasPrintableChars(const char* string) const {
   int w = 0, h = 0;
 
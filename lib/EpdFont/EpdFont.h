@@ -1,15 +1,32 @@
 #pragma once
+#include <atomic>
+
 #include "EpdFontData.h"
 
 class EpdFont {
+  // Advances of the code points laid out most (Latin up to U+024F and General Punctuation), indexed directly instead
+  // of searching the glyph intervals. Built on first use, so only fonts that are measured pay for one.
+  static constexpr uint32_t LATIN_END = 0x250;
+  static constexpr uint32_t PUNCTUATION_START = 0x2000;
+  static constexpr uint32_t PUNCTUATION_END = 0x2070;
+  static constexpr uint32_t ADVANCE_TABLE_SIZE = LATIN_END + (PUNCTUATION_END - PUNCTUATION_START);
+  mutable std::atomic<const uint8_t*> advanceTable{nullptr};
+
   void getTextBounds(const char* string, int startX, int startY, int* minX, int* minY, int* maxX, int* maxY) const;
+  const uint8_t* getAdvanceTable() const;
+  int getGlyphAdvance(uint32_t cp) const;
 
  public:
   const EpdFontData* data;
   explicit EpdFont(const EpdFontData* data) : data(data) {}
-  ~EpdFont() = default;
+  ~EpdFont() { delete[] advanceTable.load(); }
   void getTextDimensions(const char* string, int* w, int* h) const;
   bool hasPrintableChars(const char* string) const;
 
+  // Sum of the glyph advances, i.e. how far the pen moves. This is what text is laid out with; unlike
+  // getTextDimensions it ignores side bearings and doesn't compute bounds.
+  int getAdvance(uint32_t cp) const;
+  int getTextAdvance(const char* string) const;
+
   const EpdGlyph* getGlyph(uint32_t cp) const;
 };
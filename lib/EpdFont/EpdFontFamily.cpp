@@ -26,6 +26,12 @@ bool EpdFontFamily::hasPrintableChars(const char* string, const Style style) con
   return getFont(style)->hasPrintableChars(string);
 }
 
+int EpdFontFamily::getAdvance(const uint32_t cp, const Style style) const { return getFont(style)->getAdvance(cp); }
+
+int EpdFontFamily::getTextAdvance(const char* string, const Style style) const {
+  return getFont(style)->getTextAdvance(string);
+}
+
 const EpdFontData* EpdFontFamily::getData(const Style style) const { return getFont(style)->data; }
 
 const EpdGlyph* EpdFontFamily::getGlyph(const uint32_t cp, const Style style) const {
@@ -11,6 +11,8 @@ class EpdFontFamily {
   ~EpdFontFamily() = default;
   void getTextDimensions(const char* string, int* w, int* h, Style style = REGULAR) const;
   bool hasPrintableChars(const char* string, Style style = REGULAR) const;
+  int getAdvance(uint32_t cp, Style style = REGULAR) const;
+  int getTextAdvance(const char* string, Style style = REGULAR) const;
   const EpdFontData* getData(Style style = REGULAR) const;
   const EpdGlyph* getGlyph(uint32_t cp, Style style = REGULAR) const;
 
@@ -152,49 +152,39 @@ bool Epub::parseTocNcxFile() const {
 
   LOG_DBG("EBP", "Parsing toc ncx file: %s", tocNcxItem.c_str());
 
-  const auto tmpNcxPath = getCachePath() + "/toc.ncx";
-  FsFile tempNcxFile;
-  if (!Storage.openFileForWrite("EBP", tmpNcxPath, tempNcxFile)) {
+  ZipFile zip(filepath, zipIndexPath, &inflateContext, &nestedInflateContext);
+  ZipEntryReader ncxReader(zip);
+  if (!ncxReader.open(FsHelpers::normalisePath(tocNcxItem).c_str())) {
+    LOG_ERR("EBP", "Could not open toc ncx file");
     return false;
   }
-  readItemContentsToStream(tocNcxItem, tempNcxFile, 1024);
-  tempNcxFile.close();
-  if (!Storage.openFileForRead("EBP", tmpNcxPath, tempNcxFile)) {
-    return false;
-  }
-  const auto ncxSize = tempNcxFile.size();
 
-  TocNcxParser ncxParser(contentBasePath, ncxSize, bookMetadataCache.get());
+  TocNcxParser ncxParser(contentBasePath, ncxReader.size(), bookMetadataCache.get());
 
   if (!ncxParser.setup()) {
     LOG_ERR("EBP", "Could not setup toc ncx parser");
-    tempNcxFile.close();
     return false;
   }
 
   const auto ncxBuffer = static_cast<uint8_t*>(malloc(1024));
   if (!ncxBuffer) {
     LOG_ERR("EBP", "Could not allocate memory for toc ncx parser");
-    tempNcxFile.close();
     return false;
   }
 
-  while (tempNcxFile.available()) {
-    const auto readSize = tempNcxFile.read(ncxBuffer, 1024);
-    if (readSize == 0) break;
+  while (ncxReader.available()) {
+    const int readSize = ncxReader.read(ncxBuffer, 1024);
+    if (readSize <= 0) break;
     const auto processedSize = ncxParser.write(ncxBuffer, readSize);
 
-    if (processedSize != readSize) {
+    if (processedSize != static_cast<size_t>(readSize)) {
       LOG_ERR("EBP", "Could not process all toc ncx data");
       free(ncxBuffer);
-      tempNcxFile.close();
       return false;
     }
   }
 
   free(ncxBuffer);
-  tempNcxFile.close();
-  Storage.remove(tmpNcxPath.c_str());
 
   LOG_DBG("EBP", "Parsed TOC items");
   return true;
@@ -209,22 +199,17 @@ bool Epub::parseTocNavFile() const {
 
   LOG_DBG("EBP", "Parsing toc nav file: %s", tocNavItem.c_str());
 
-  const auto tmpNavPath = getCachePath() + "/toc.nav";
-  FsFile tempNavFile;
-  if (!Storage.openFileForWrite("EBP", tmpNavPath, tempNavFile)) {
+  ZipFile zip(filepath, zipIndexPath, &inflateContext, &nestedInflateContext);
+  ZipEntryReader navReader(zip);
+  if (!navReader.open(FsHelpers::normalisePath(tocNavItem).c_str())) {
+    LOG_ERR("EBP", "Could not open toc nav file");
     return false;
   }
-  readItemContentsToStream(tocNavItem, tempNavFile, 1024);
-  tempNavFile.close();
-  if (!Storage.openFileForRead("EBP", tmpNavPath, tempNavFile)) {
-    return false;
-  }
-  const auto navSize = tempNavFile.size();
 
   // Note: We can't use `contentBasePath` here as the nav file may be in a different folder to the content.opf
   // and the HTMLX nav file will have hrefs relative to itself
   const std::string navContentBasePath = tocNavItem.substr(0, tocNavItem.find_last_of('/') + 1);
-  TocNavParser navParser(navContentBasePath, navSize, bookMetadataCache.get());
+  TocNavParser navParser(navContentBasePath, navReader.size(), bookMetadataCache.get());
 
   if (!navParser.setup()) {
     LOG_ERR("EBP", "Could not setup toc nav parser");
@@ -237,21 +222,19 @@ bool Epub::parseTocNavFile() const {
     return false;
   }
 
-  while (tempNavFile.available()) {
-    const auto readSize = tempNavFile.read(navBuffer, 1024);
+  while (navReader.available()) {
+    const int readSize = navReader.read(navBuffer, 1024);
+    if (readSize <= 0) break;
     const auto processedSize = navParser.write(navBuffer, readSize);
 
-    if (processedSize != readSize) {
+    if (processedSize != static_cast<size_t>(readSize)) {
       LOG_ERR("EBP", "Could not process all toc nav data");
       free(navBuffer);
-      tempNavFile.close();
       return false;
     }
   }
 
   free(navBuffer);
-  tempNavFile.close();
-  Storage.remove(tmpNavPath.c_str());
 
   LOG_DBG("EBP", "Parsed TOC nav items");
   return true;
@@ -265,42 +248,24 @@ void Epub::parseCssFiles() const {
   // See if we have a cached version of the CSS rules
   if (!cssParser->hasCache()) {
     // No cache yet - parse CSS files
+    ZipFile zip(filepath, zipIndexPath, &inflateContext, &nestedInflateContext);
     for (const auto& cssPath : cssFiles) {
       LOG_DBG("EBP", "Parsing CSS file: %s", cssPath.c_str());
 
-      // Extract CSS file to temp location
-      const auto tmpCssPath = getCachePath() + "/.tmp.css";
-      FsFile tempCssFile;
-      if (!Storage.openFileForWrite("EBP", tmpCssPath, tempCssFile)) {
-        LOG_ERR("EBP", "Could not create temp CSS file");
-        continue;
-      }
-      if (!readItemContentsToStream(cssPath, tempCssFile, 1024)) {
+      ZipEntryReader cssReader(zip);
+      if (!cssReader.open(FsHelpers::normalisePath(cssPath).c_str())) {
         LOG_ERR("EBP", "Could not read CSS file: %s", cssPath.c_str());
-        tempCssFile.close();
-        Storage.remove(tmpCssPath.c_str());
         continue;
       }
-      tempCssFile.close();
-
-      // Parse the CSS file
-      if (!Storage.openFileForRead("EBP", tmpCssPath, tempCssFile)) {
-        LOG_ERR("EBP", "Could not open temp CSS file for reading");
-        Storage.remove(tmpCssPath.c_str());
-        continue;
-      }
-      cssParser->loadFromStream(tempCssFile);
-      tempCssFile.close();
-      Storage.remove(tmpCssPath.c_str());
+      cssParser->loadFromStream(cssReader);
     }
 
     // Save to cache for next time
     if (!cssParser->saveToCache()) {
       LOG_ERR("EBP", "Failed to save CSS rules to cache");
     }
-    cssParser->clear();
-
     LOG_DBG("EBP", "Loaded %zu CSS style rules from %zu files", cssParser->ruleCount(), cssFiles.size());
+    cssParser->clear();
   }
 }
 
@@ -402,7 +367,7 @@ bool Epub::load(const bool buildIfMissing, const bool skipLoadingCss) {
 
   // Build final book.bin
   const uint32_t buildStart = millis();
-  if (!bookMetadataCache->buildBookBin(filepath, bookMetadata)) {
+  if (!bookMetadataCache->buildBookBin(filepath, zipIndexPath, bookMetadata)) {
     LOG_ERR("EBP", "Could not update mappings and sizes");
     return false;
   }
@@ -429,7 +394,15 @@ bool Epub::load(const bool buildIfMissing, const bool skipLoadingCss) {
   return true;
 }
 
+Epub::~Epub() {
+  if (sectionCacheIndex) {
+    sectionCacheIndex->commit();
+  }
+}
+
 bool Epub::clearCache() const {
+  // Whatever the index still holds describes files that are about to go
+  sectionCacheIndex.reset();
   if (!Storage.exists(cachePath.c_str())) {
     LOG_DBG("EPB", "Cache does not exist, no action needed");
     return true;
@@ -444,6 +417,21 @@ bool Epub::clearCache() const {
   return true;
 }
 
+void Epub::freeMemory() const {
+  if (cssParser) {
+    cssParser->freeRules();
+  }
+  inflateContext.freeMemory();
+  nestedInflateContext.freeMemory();
+}
+
+SectionCacheIndex& Epub::getSectionCacheIndex() const {
+  if (!sectionCacheIndex) {
+    sectionCacheIndex.reset(new SectionCacheIndex(cachePath));
+  }
+  return *sectionCacheIndex;
+}
+
 void Epub::setupCacheDir() const {
   if (Storage.exists(cachePath.c_str())) {
     return;
@@ -683,7 +671,8 @@ uint8_t* Epub::readItemContentsToBytes(const std::string& itemHref, size_t* size
 
   const std::string path = FsHelpers::normalisePath(itemHref);
 
-  const auto content = ZipFile(filepath).readFileToMemory(path.c_str(), size, trailingNullByte);
+  const auto content = ZipFile(filepath, zipIndexPath, &inflateContext, &nestedInflateContext)
+                           .readFileToMemory(path.c_str(), size, trailingNullByte);
   if (!content) {
     LOG_DBG("EBP", "Failed to read item %s", path.c_str());
     return nullptr;
@@ -699,12 +688,25 @@ bool Epub::readItemContentsToStream(const std::string& itemHref, Print& out, con
   }
 
   const std::string path = FsHelpers::normalisePath(itemHref);
-  return ZipFile(filepath).readFileToStream(path.c_str(), out, chunkSize);
+  return ZipFile(filepath, zipIndexPath, &inflateContext, &nestedInflateContext)
+      .readFileToStream(path.c_str(), out, chunkSize);
+}
+
+int Epub::readItemContentsToStreams(const std::vector<std::string>& itemHrefs, const size_t chunkSize,
+                                    const std::function<Print*(size_t)>& openOutput,
+                                    const std::function<void(size_t, bool)>& closeOutput) const {
+  std::vector<std::string> paths;
+  paths.reserve(itemHrefs.size());
+  for (const auto& itemHref : itemHrefs) {
+    paths.push_back(FsHelpers::normalisePath(itemHref));
+  }
+  return ZipFile(filepath, zipIndexPath, &inflateContext, &nestedInflateContext)
+      .readFilesToStreams(paths, chunkSize, openOutput, closeOutput);
 }
 
 bool Epub::getItemSize(const std::string& itemHref, size_t* size) const {
   const std::string path = FsHelpers::normalisePath(itemHref);
-  return ZipFile(filepath).getInflatedFileSize(path.c_str(), size);
+  return ZipFile(filepath, zipIndexPath).getInflatedFileSize(path.c_str(), size);
 }
 
 int Epub::getSpineItemsCount() const {
@@ -714,7 +716,19 @@ int Epub::getSpineItemsCount() const {
   return bookMetadataCache->getSpineCount();
 }
 
-size_t Epub::getCumulativeSpineItemSize(const int spineIndex) const { return getSpineItem(spineIndex).cumulativeSize; }
+size_t Epub::getCumulativeSpineItemSize(const int spineIndex) const {
+  if (!bookMetadataCache || !bookMetadataCache->isLoaded()) {
+    LOG_ERR("EBP", "getCumulativeSpineItemSize called but cache not loaded");
+    return 0;
+  }
+
+  if (spineIndex < 0 || spineIndex >= bookMetadataCache->getSpineCount()) {
+    LOG_ERR("EBP", "getCumulativeSpineItemSize index:%d is out of range", spineIndex);
+    return bookMetadataCache->getCumulativeSize(0);
+  }
+
+  return bookMetadataCache->getCumulativeSize(spineIndex);
+}
 
 BookMetadataCache::SpineEntry Epub::getSpineItem(const int spineIndex) const {
   if (!bookMetadataCache || !bookMetadataCache->isLoaded()) {
@@ -773,7 +787,19 @@ int Epub::getSpineIndexForTocIndex(const int tocIndex) const {
   return spineIndex;
 }
 
-int Epub::getTocIndexForSpineIndex(const int spineIndex) const { return getSpineItem(spineIndex).tocIndex; }
+int Epub::getTocIndexForSpineIndex(const int spineIndex) const {
+  if (!bookMetadataCache || !bookMetadataCache->isLoaded()) {
+    LOG_ERR("EBP", "getTocIndexForSpineIndex called but cache not loaded");
+    return -1;
+  }
+
+  if (spineIndex < 0 || spineIndex >= bookMetadataCache->getSpineCount()) {
+    LOG_ERR("EBP", "getTocIndexForSpineIndex index:%d is out of range", spineIndex);
+    return bookMetadataCache->getTocIndex(0);
+  }
+
+  return bookMetadataCache->getTocIndex(spineIndex);
+}
 
 size_t Epub::getBookSize() const {
   if (!bookMetadataCache || !bookMetadataCache->isLoaded() || bookMetadataCache->getSpineCount() == 0) {
@@ -1,17 +1,18 @@
 #pragma once
 
 #include <Print.h>
+#include <ZipFile.h>
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
 #include "Epub/BookMetadataCache.h"
+#include "Epub/SectionCacheIndex.h"
 #include "Epub/css/CssParser.h"
 
-class ZipFile;
-
 class Epub {
   // the ncx file (EPUB 2)
   std::string tocNcxItem;
@@ -23,12 +24,20 @@ class Epub {
   std::string contentBasePath;
   // Uniq cache key based on filepath
   std::string cachePath;
+  // Sorted central directory index of the EPUB zip, built into the cache dir on first lookup
+  std::string zipIndexPath;
+  // Inflate buffers shared by every zip read of this book, allocated on first use
+  mutable InflateContext inflateContext;
+  // Second set for reads made while inflateContext is busy, e.g. images extracted mid-chapter
+  mutable InflateContext nestedInflateContext;
   // Spine and TOC cache
   std::unique_ptr<BookMetadataCache> bookMetadataCache;
   // CSS parser for styling
   std::unique_ptr<CssParser> cssParser;
   // CSS files
   std::vector<std::string> cssFiles;
+  // Section variants of this book, loaded on first use and written back when sections are built or the book closes
+  mutable std::unique_ptr<SectionCacheIndex> sectionCacheIndex;
 
   bool findContentOpfFile(std::string* contentOpfFile) const;
   bool parseContentOpf(BookMetadataCache::BookMetadata& bookMetadata);
@@ -40,14 +49,22 @@ class Epub {
   explicit Epub(std::string filepath, const std::string& cacheDir) : filepath(std::move(filepath)) {
     // create a cache key based on the filepath
     cachePath = cacheDir + "/epub_" + std::to_string(std::hash<std::string>{}(this->filepath));
+    zipIndexPath = cachePath + "/zip.idx";
   }
-  ~Epub() = default;
+  ~Epub();
   std::string& getBasePath() { return contentBasePath; }
   bool load(bool buildIfMissing = true, bool skipLoadingCss = false);
   bool clearCache() const;
   void setupCacheDir() const;
+  // Memory pressure hook: frees what the book session keeps loaded to save work (CSS rules, inflate buffers). Both
+  // are loaded again on demand.
+  void freeMemory() const;
   const std::string& getCachePath() const;
   const std::string& getPath() const;
+  const std::string& getZipIndexPath() const { return zipIndexPath; }
+  InflateContext* getInflateContext() const { return &inflateContext; }
+  InflateContext* getNestedInflateContext() const { return &nestedInflateContext; }
+  SectionCacheIndex& getSectionCacheIndex() const;
   const std::string& getTitle() const;
   const std::string& getAuthor() const;
   const std::string& getLanguage() const;
@@ -59,6 +76,10 @@ class Epub {
   uint8_t* readItemContentsToBytes(const std::string& itemHref, size_t* size = nullptr,
                                    bool trailingNullByte = false) const;
   bool readItemContentsToStream(const std::string& itemHref, Print& out, size_t chunkSize) const;
+  // Extracts several items in one pass over the EPUB (see ZipFile::readFilesToStreams)
+  int readItemContentsToStreams(const std::vector<std::string>& itemHrefs, size_t chunkSize,
+                                const std::function<Print*(size_t)>& openOutput,
+                                const std::function<void(size_t, bool)>& closeOutput) const;
   bool getItemSize(const std::string& itemHref, size_t* size) const;
   BookMetadataCache::SpineEntry getSpineItem(int spineIndex) const;
   BookMetadataCache::TocEntry getTocItem(int tocIndex) const;
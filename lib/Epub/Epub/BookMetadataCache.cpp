@@ -1,5 +1,6 @@
 #include "BookMetadataCache.h"
 
+#include <Fnv1a.h>
 #include <Logging.h>
 #include <Serialization.h>
 #include <ZipFile.h>
@@ -9,7 +10,7 @@
 #include "FsHelpers.h"
 
 namespace {
-constexpr uint8_t BOOK_CACHE_VERSION = 5;
+constexpr uint8_t BOOK_CACHE_VERSION = 6;
 constexpr char bookBinFile[] = "/book.bin";
 constexpr char tmpSpineBinFile[] = "/spine.bin.tmp";
 constexpr char tmpTocBinFile[] = "/toc.bin.tmp";
@@ -55,7 +56,7 @@ bool BookMetadataCache::beginTocPass() {
     for (int i = 0; i < spineCount; i++) {
       auto entry = readSpineEntry(spineFile);
       SpineHrefIndexEntry idx;
-      idx.hrefHash = fnvHash64(entry.href);
+      idx.hrefHash = fnv1a64(entry.href);
       idx.hrefLen = static_cast<uint16_t>(entry.href.size());
       idx.spineIndex = static_cast<int16_t>(i);
       spineHrefIndex.push_back(idx);
@@ -96,7 +97,8 @@ bool BookMetadataCache::endWrite() {
   return true;
 }
 
-bool BookMetadataCache::buildBookBin(const std::string& epubPath, const BookMetadata& metadata) {
+bool BookMetadataCache::buildBookBin(const std::string& epubPath, const std::string& zipIndexPath,
+                                     const BookMetadata& metadata) {
   // Open all three files, writing to meta, reading from spine and toc
   if (!Storage.openFileForWrite("BMC", cachePath + bookBinFile, bookFile)) {
     return false;
@@ -120,6 +122,10 @@ bool BookMetadataCache::buildBookBin(const std::string& epubPath, const BookMeta
                                 sizeof(uint32_t) * 5;
   const uint32_t lutSize = sizeof(uint32_t) * spineCount + sizeof(uint32_t) * tocCount;
   const uint32_t lutOffset = headerASize + metadataSize;
+  // Compact spine table (cumulative sizes, then TOC indexes) sits between the LUTs and the entries, see load()
+  const uint32_t spineTableOffset = lutOffset + lutSize;
+  const uint32_t spineTableSize = (sizeof(uint32_t) + sizeof(int16_t)) * spineCount;
+  const uint32_t entriesOffset = spineTableOffset + spineTableSize;
 
   // Header A
   serialization::writePod(bookFile, BOOK_CACHE_VERSION);
@@ -138,7 +144,7 @@ bool BookMetadataCache::buildBookBin(const std::string& epubPath, const BookMeta
   for (int i = 0; i < spineCount; i++) {
     uint32_t pos = spineFile.position();
     auto spineEntry = readSpineEntry(spineFile);
-    serialization::writePod(bookFile, pos + lutOffset + lutSize);
+    serialization::writePod(bookFile, pos + entriesOffset);
   }
 
   // Loop through toc entries, writing LUT positions
@@ -146,10 +152,15 @@ bool BookMetadataCache::buildBookBin(const std::string& epubPath, const BookMeta
   for (int i = 0; i < tocCount; i++) {
     uint32_t pos = tocFile.position();
     auto tocEntry = readTocEntry(tocFile);
-    serialization::writePod(bookFile, pos + lutOffset + lutSize + static_cast<uint32_t>(spineFile.position()));
+    serialization::writePod(bookFile, pos + entriesOffset + static_cast<uint32_t>(spineFile.position()));
   }
 
-  // LUTs complete
+  // LUTs complete, reserve the spine table until sizes are known
+  std::vector<uint32_t> cumulativeSizes(spineCount, 0);
+  std::vector<int16_t> tocIndices(spineCount, -1);
+  bookFile.write(reinterpret_cast<const uint8_t*>(cumulativeSizes.data()), sizeof(uint32_t) * spineCount);
+  bookFile.write(reinterpret_cast<const uint8_t*>(tocIndices.data()), sizeof(int16_t) * spineCount);
+
   // Loop through spines from spine file matching up TOC indexes, calculating cumulative size and writing to book.bin
 
   // Build spineIndex->tocIndex mapping in one pass (O(n) instead of O(n*m))
@@ -164,7 +175,7 @@ bool BookMetadataCache::buildBookBin(const std::string& epubPath, const BookMeta
     }
   }
 
-  ZipFile zip(epubPath);
+  ZipFile zip(epubPath, zipIndexPath);
   // Pre-open zip file to speed up size calculations
   if (!zip.open()) {
     LOG_ERR("BMC", "Could not open EPUB zip for size calculations");
@@ -196,7 +207,7 @@ bool BookMetadataCache::buildBookBin(const std::string& epubPath, const BookMeta
       std::string path = FsHelpers::normalisePath(entry.href);
 
       ZipFile::SizeTarget t;
-      t.hash = ZipFile::fnvHash64(path.c_str(), path.size());
+      t.hash = fnv1a64(path);
       t.len = static_cast<uint16_t>(path.size());
       t.index = static_cast<uint16_t>(i);
       targets.push_back(t);
@@ -251,6 +262,8 @@ bool BookMetadataCache::buildBookBin(const std::string& epubPath, const BookMeta
 
     cumSize += itemSize;
     spineEntry.cumulativeSize = cumSize;
+    cumulativeSizes[i] = cumSize;
+    tocIndices[i] = spineEntry.tocIndex;
 
     // Write out spine data to book.bin
     writeSpineEntry(bookFile, spineEntry);
@@ -265,6 +278,11 @@ bool BookMetadataCache::buildBookBin(const std::string& epubPath, const BookMeta
     writeTocEntry(bookFile, tocEntry);
   }
 
+  // Go back and fill in the spine table
+  bookFile.seek(spineTableOffset);
+  bookFile.write(reinterpret_cast<const uint8_t*>(cumulativeSizes.data()), sizeof(uint32_t) * spineCount);
+  bookFile.write(reinterpret_cast<const uint8_t*>(tocIndices.data()), sizeof(int16_t) * spineCount);
+
   bookFile.close();
   spineFile.close();
   tocFile.close();
@@ -324,7 +342,7 @@ void BookMetadataCache::createTocEntry(const std::string& title, const std::stri
   int16_t spineIndex = -1;
 
   if (useSpineHrefIndex) {
-    uint64_t targetHash = fnvHash64(href);
+    uint64_t targetHash = fnv1a64(href);
     uint16_t targetLen = static_cast<uint16_t>(href.size());
 
     auto it =
@@ -385,6 +403,26 @@ bool BookMetadataCache::load() {
   serialization::readString(bookFile, coreMetadata.coverItemHref);
   serialization::readString(bookFile, coreMetadata.textReferenceHref);
 
+  // Keep the spine table in RAM (10 bytes per item) so progress and TOC lookups don't hit the SD card. The spine
+  // LUT doubles as the href offsets, since each spine entry starts with its href.
+  const uint32_t spineTableOffset = lutOffset + sizeof(uint32_t) * spineCount + sizeof(uint32_t) * tocCount;
+  spineHrefOffsets.resize(spineCount);
+  spineCumulativeSizes.resize(spineCount);
+  spineTocIndices.resize(spineCount);
+  const auto readArray = [this](void* data, const size_t size) {
+    return bookFile.read(data, size) == static_cast<int>(size);
+  };
+  bookFile.seek(lutOffset);
+  const bool tableRead = readArray(spineHrefOffsets.data(), sizeof(uint32_t) * spineCount) &&
+                         bookFile.seek(spineTableOffset) &&
+                         readArray(spineCumulativeSizes.data(), sizeof(uint32_t) * spineCount) &&
+                         readArray(spineTocIndices.data(), sizeof(int16_t) * spineCount);
+  if (!tableRead) {
+    LOG_ERR("BMC", "Failed to read spine table");
+    bookFile.close();
+    return false;
+  }
+
   loaded = true;
   LOG_DBG("BMC", "Loaded cache data: %d spine, %d TOC entries", spineCount, tocCount);
   return true;
@@ -401,12 +439,29 @@ BookMetadataCache::SpineEntry BookMetadataCache::getSpineEntry(const int index)
     return {};
   }
 
-  // Seek to spine LUT item, read from LUT and get out data
-  bookFile.seek(lutOffset + sizeof(uint32_t) * index);
-  uint32_t spineEntryPos;
-  serialization::readPod(bookFile, spineEntryPos);
-  bookFile.seek(spineEntryPos);
-  return readSpineEntry(bookFile);
+  // Only the href lives on the SD card, everything else comes from the spine table
+  SpineEntry entry;
+  bookFile.seek(spineHrefOffsets[index]);
+  serialization::readString(bookFile, entry.href);
+  entry.cumulativeSize = spineCumulativeSizes[index];
+  entry.tocIndex = spineTocIndices[index];
+  return entry;
+}
+
+size_t BookMetadataCache::getCumulativeSize(const int index) const {
+  if (!loaded || index < 0 || index >= static_cast<int>(spineCount)) {
+    LOG_ERR("BMC", "getCumulativeSize index %d out of range", index);
+    return 0;
+  }
+  return spineCumulativeSizes[index];
+}
+
+int16_t BookMetadataCache::getTocIndex(const int index) const {
+  if (!loaded || index < 0 || index >= static_cast<int>(spineCount)) {
+    LOG_ERR("BMC", "getTocIndex index %d out of range", index);
+    return -1;
+  }
+  return spineTocIndices[index];
 }
 
 BookMetadataCache::TocEntry BookMetadataCache::getTocEntry(const int index) {
@@ -51,6 +51,10 @@ class BookMetadataCache {
   bool buildMode;
 
   FsFile bookFile;
+  // Spine table loaded into RAM by load(); hrefs stay on the SD card and are read from their offset on demand
+  std::vector<uint32_t> spineHrefOffsets;
+  std::vector<uint32_t> spineCumulativeSizes;
+  std::vector<int16_t> spineTocIndices;
   // Temp file handles during build
   FsFile spineFile;
   FsFile tocFile;
@@ -66,16 +70,6 @@ class BookMetadataCache {
 
   static constexpr uint16_t LARGE_SPINE_THRESHOLD = 400;
 
-  // FNV-1a 64-bit hash function
-  static uint64_t fnvHash64(const std::string& s) {
-    uint64_t hash = 14695981039346656037ull;
-    for (char c : s) {
-      hash ^= static_cast<uint8_t>(c);
-      hash *= 1099511628211ull;
-    }
-    return hash;
-  }
-
   uint32_t writeSpineEntry(FsFile& file, const SpineEntry& entry) const;
   uint32_t writeTocEntry(FsFile& file, const TocEntry& entry) const;
   SpineEntry readSpineEntry(FsFile& file) const;
@@ -100,12 +94,15 @@ class BookMetadataCache {
   bool cleanupTmpFiles() const;
 
   // Post-processing to update mappings and sizes
-  bool buildBookBin(const std::string& epubPath, const BookMetadata& metadata);
+  bool buildBookBin(const std::string& epubPath, const std::string& zipIndexPath, const BookMetadata& metadata);
 
   // Reading phase (read mode)
   bool load();
   SpineEntry getSpineEntry(int index);
   TocEntry getTocEntry(int index);
+  // RAM-only spine lookups
+  size_t getCumulativeSize(int index) const;
+  int16_t getTocIndex(int index) const;
   int getSpineCount() const { return spineCount; }
   int getTocCount() const { return tocCount; }
   bool isLoaded() const { return loaded; }
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <Fnv1a.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+
+// Fixed size set associative cache for the layout hot paths (word widths, resolved styles, hyphenation breaks).
+// Keys are not stored: an entry is identified by a 64-bit FNV-1a hash of its key bytes plus the key length, which keeps
+// entries small while making a false hit vanishingly unlikely for the few thousand distinct keys of a section build.
+// A key picks its set by hash, and within a set the least recently used entry is replaced.
+template <typename Value, size_t Sets, size_t Ways>
+class HashedCache {
+  static_assert(Sets > 0 && (Sets & (Sets - 1)) == 0, "Set count must be a power of two");
+
+  struct Entry {
+    uint64_t hash;
+    uint32_t lastUse;  // 0 = empty
+    uint16_t length;
+    Value value;
+  };
+
+  Entry entries[Sets * Ways] = {};
+  uint32_t clock = 0;
+  uint32_t hits = 0;
+  uint32_t misses = 0;
+
+  Entry* setOf(const uint64_t hash) { return &entries[(hash & (Sets - 1)) * Ways]; }
+
+ public:
+  struct Key {
+    uint64_t hash = FNV1A_64_BASIS;
+    uint32_t length = 0;
+
+    // Appends key bytes, so composite keys can be built piece by piece
+    Key& add(const void* data, const size_t size) {
+      hash = fnv1a64(data, size, hash);
+      length += size;
+      return *this;
+    }
+    Key& add(const std::string_view bytes) { return add(bytes.data(), bytes.size()); }
+    Key& addByte(const uint8_t byte) { return add(&byte, 1); }
+  };
+
+  // True and `value` set if the key was inserted before
+  bool lookup(const Key& key, Value& value) {
+    Entry* set = setOf(key.hash);
+    for (size_t i = 0; i < Ways; i++) {
+      if (set[i].lastUse != 0 && set[i].hash == key.hash && set[i].length == static_cast<uint16_t>(key.length)) {
+        set[i].lastUse = ++clock;
+        value = set[i].value;
+        hits++;
+        return true;
+      }
+    }
+    misses++;
+    return false;
+  }
+
+  void insert(const Key& key, const Value& value) {
+    Entry* set = setOf(key.hash);
+    Entry* victim = std::min_element(set, set + Ways, [](const Entry& a, const Entry& b) {
+      return a.lastUse < b.lastUse;
+    });
+    *victim = {key.hash, ++clock, static_cast<uint16_t>(key.length), value};
+  }
+
+  void clear() { std::fill(std::begin(entries), std::end(entries), Entry{}); }
+
+  uint32_t getHits() const { return hits; }
+  uint32_t getMisses() const { return misses; }
+};
@@ -0,0 +1,271 @@
+#include "PageCodec.h"
+
+#include <Logging.h>
+
+#include <cstring>
+
+namespace {
+// Guards against corrupt records asking for huge allocations
+constexpr uint32_t MAX_PAGE_RECORD_SIZE = 64 * 1024;
+
+enum StyleFlags : uint8_t {
+  STYLE_TEXT_ALIGN_DEFINED = 1 << 0,
+  STYLE_TEXT_INDENT_DEFINED = 1 << 1,
+};
+
+bool sameStyle(const BlockStyle& a, const BlockStyle& b) {
+  return a.alignment == b.alignment && a.textAlignDefined == b.textAlignDefined &&
+         a.textIndentDefined == b.textIndentDefined && a.marginTop == b.marginTop &&
+         a.marginBottom == b.marginBottom && a.marginLeft == b.marginLeft && a.marginRight == b.marginRight &&
+         a.paddingTop == b.paddingTop && a.paddingBottom == b.paddingBottom && a.paddingLeft == b.paddingLeft &&
+         a.paddingRight == b.paddingRight && a.textIndent == b.textIndent;
+}
+}  // namespace
+
+void PageWriter::putVarUint(std::vector<uint8_t>& out, uint32_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+void PageWriter::writeString(const std::string& value) {
+  writeVarUint(value.size());
+  elements.insert(elements.end(), value.begin(), value.end());
+}
+
+uint32_t PageWriter::internWord(const std::string& word) {
+  const auto inserted = wordIndex.emplace(word, static_cast<uint32_t>(words.size()));
+  if (inserted.second) {
+    words.push_back(&inserted.first->first);
+  }
+  return inserted.first->second;
+}
+
+uint32_t PageWriter::internStyle(const BlockStyle& style) {
+  // A page holds a handful of paragraphs at most, a linear scan is fine
+  for (size_t i = 0; i < styles.size(); i++) {
+    if (sameStyle(styles[i], style)) {
+      return i;
+    }
+  }
+  styles.push_back(style);
+  return styles.size() - 1;
+}
+
+std::vector<uint8_t> PageWriter::encode() const {
+  std::vector<uint8_t> record(sizeof(uint32_t));
+  record.reserve(sizeof(uint32_t) + elements.size() + styles.size() * 12 + words.size() * 8);
+
+  putVarUint(record, styles.size());
+  for (const auto& style : styles) {
+    record.push_back(static_cast<uint8_t>(style.alignment));
+    record.push_back((style.textAlignDefined ? STYLE_TEXT_ALIGN_DEFINED : 0) |
+                     (style.textIndentDefined ? STYLE_TEXT_INDENT_DEFINED : 0));
+    for (const int16_t value : {style.marginTop, style.marginBottom, style.marginLeft, style.marginRight,
+                                style.paddingTop, style.paddingBottom, style.paddingLeft, style.paddingRight,
+                                style.textIndent}) {
+      putVarUint(record, zigzag(value));
+    }
+  }
+
+  putVarUint(record, words.size());
+  for (const auto* word : words) {
+    putVarUint(record, word->size());
+    record.insert(record.end(), word->begin(), word->end());
+  }
+  record.insert(record.end(), elements.begin(), elements.end());
+
+  const uint32_t payloadSize = record.size() - sizeof(uint32_t);
+  memcpy(record.data(), &payloadSize, sizeof(payloadSize));
+  return record;
+}
+
+bool PageWriter::flush(FsFile& file) const {
+  const auto record = encode();
+  return file.write(record.data(), record.size()) == record.size();
+}
+
+bool PageReader::load(FsFile& file) {
+  uint32_t payloadSize = 0;
+  if (file.read(&payloadSize, sizeof(payloadSize)) != sizeof(payloadSize)) {
+    LOG_ERR("PGC", "Page record truncated");
+    return false;
+  }
+  if (payloadSize == 0 || payloadSize > MAX_PAGE_RECORD_SIZE) {
+    LOG_ERR("PGC", "Invalid page record size %lu", static_cast<unsigned long>(payloadSize));
+    return false;
+  }
+
+  data.resize(payloadSize);
+  if (file.read(data.data(), payloadSize) != static_cast<int>(payloadSize)) {
+    LOG_ERR("PGC", "Page record truncated");
+    return false;
+  }
+  pos = 0;
+  ok = true;
+
+  const uint32_t styleCount = readVarUint();
+  if (styleCount > payloadSize) {
+    return ok = false;
+  }
+  styles.resize(styleCount);
+  for (auto& style : styles) {
+    style.alignment = static_cast<CssTextAlign>(readByte());
+    const uint8_t flags = readByte();
+    style.textAlignDefined = flags & STYLE_TEXT_ALIGN_DEFINED;
+    style.textIndentDefined = flags & STYLE_TEXT_INDENT_DEFINED;
+    for (int16_t* value : {&style.marginTop, &style.marginBottom, &style.marginLeft, &style.marginRight,
+                           &style.paddingTop, &style.paddingBottom, &style.paddingLeft, &style.paddingRight,
+                           &style.textIndent}) {
+      *value = static_cast<int16_t>(readVarInt());
+    }
+  }
+
+  const uint32_t wordCount = readVarUint();
+  if (wordCount > payloadSize) {
+    return ok = false;
+  }
+  words.resize(wordCount);
+  for (auto& word : words) {
+    word = readString();
+  }
+  return ok;
+}
+
+uint32_t PageReader::readVarUint() {
+  uint32_t value = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    const uint8_t byte = readByte();
+    value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      return value;
+    }
+  }
+  ok = false;
+  return 0;
+}
+
+std::string_view PageReader::readString() {
+  const uint32_t length = readVarUint();
+  if (!ok || length > data.size() - pos) {
+    ok = false;
+    return {};
+  }
+  const std::string_view value(reinterpret_cast<const char*>(data.data() + pos), length);
+  pos += length;
+  return value;
+}
+
+const BlockStyle* PageReader::style(const uint32_t index) {
+  if (index >= styles.size()) {
+    ok = false;
+    return nullptr;
+  }
+  return &styles[index];
+}
+
+void PageView::clear() {
+  text.clear();
+  dictionaryOffsets.clear();
+  wordOffsets.clear();
+  wordXpos.clear();
+  wordStyles.clear();
+  lines.clear();
+  images.clear();
+}
+
+uint32_t PageView::appendText(const std::string_view value) {
+  const auto offset = static_cast<uint32_t>(text.size());
+  text.insert(text.end(), value.begin(), value.end());
+  text.push_back('\0');
+  return offset;
+}
+
+bool PageView::load(FsFile& file) {
+  clear();
+  if (!reader.load(file)) {
+    return false;
+  }
+
+  // Copy the dictionary once, NUL terminated for the renderer; lines then only store offsets into it
+  dictionaryOffsets.reserve(reader.getWordCount());
+  for (size_t i = 0; i < reader.getWordCount(); i++) {
+    dictionaryOffsets.push_back(appendText(reader.word(i)));
+  }
+
+  const uint32_t count = reader.readVarUint();
+  for (uint32_t i = 0; i < count && reader.good(); i++) {
+    const uint8_t tag = reader.readByte();
+    const auto x = static_cast<int16_t>(reader.readVarInt());
+    const auto y = static_cast<int16_t>(reader.readVarInt());
+
+    bool elementOk;
+    if (tag == TAG_PageLine) {
+      elementOk = readLine(x, y);
+    } else if (tag == TAG_PageImage) {
+      elementOk = readImage(x, y);
+    } else {
+      LOG_ERR("PGC", "Deserialization failed: Unknown tag %u", tag);
+      elementOk = false;
+    }
+    if (!elementOk) {
+      clear();
+      return false;
+    }
+  }
+
+  if (!reader.good()) {
+    LOG_ERR("PGC", "Deserialization failed: page record truncated");
+    clear();
+    return false;
+  }
+  return true;
+}
+
+bool PageView::readLine(const int16_t x, const int16_t y) {
+  reader.style(reader.readVarUint());  // Insets are already part of x; the style only matters while laying out
+  const uint32_t wordCount = reader.readVarUint();
+  if (!reader.good() || wordCount > UINT16_MAX || wordOffsets.size() + wordCount > UINT16_MAX) {
+    LOG_ERR("PGC", "Deserialization failed: bad line header");
+    return false;
+  }
+  lines.push_back({x, y, static_cast<uint16_t>(wordOffsets.size()), static_cast<uint16_t>(wordCount)});
+
+  for (uint32_t i = 0; i < wordCount; i++) {
+    const uint32_t index = reader.readVarUint();
+    if (index >= dictionaryOffsets.size()) {
+      LOG_ERR("PGC", "Deserialization failed: word index out of range");
+      return false;
+    }
+    wordOffsets.push_back(dictionaryOffsets[index]);
+  }
+  int wordX = 0;
+  for (uint32_t i = 0; i < wordCount; i++) {
+    wordX += reader.readVarInt();
+    wordXpos.push_back(static_cast<uint16_t>(wordX));
+  }
+  const size_t stylesEnd = wordStyles.size() + wordCount;
+  while (wordStyles.size() < stylesEnd && reader.good()) {
+    const uint32_t run = reader.readVarUint();
+    const auto style = static_cast<EpdFontFamily::Style>(reader.readByte());
+    if (run == 0 || run > stylesEnd - wordStyles.size()) {
+      LOG_ERR("PGC", "Deserialization failed: bad style run");
+      return false;
+    }
+    wordStyles.insert(wordStyles.end(), run, style);
+  }
+  return reader.good();
+}
+
+bool PageView::readImage(const int16_t x, const int16_t y) {
+  const std::string_view path = reader.readString();
+  const auto width = static_cast<int16_t>(reader.readVarInt());
+  const auto height = static_cast<int16_t>(reader.readVarInt());
+  if (!reader.good()) {
+    return false;
+  }
+  images.push_back({x, y, width, height, appendText(path)});
+  return true;
+}
@@ -0,0 +1,132 @@
+#pragma once
+#include <EpdFontFamily.h>
+#include <HalStorage.h>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "blocks/BlockStyle.h"
+
+class GfxRenderer;
+
+enum PageElementTag : uint8_t {
+  TAG_PageLine = 1,
+  TAG_PageImage = 2,
+};
+
+// Page records of a section file. Each page is stored as a uint32 byte count followed by its payload, so it can be
+// fetched with one SD read and decoded from memory. The payload starts with the page's block style table and word
+// dictionary; lines then refer to both by index. Integers are LEB128 varints, signed ones zigzag encoded.
+//
+// payload := varint styleCount, style*, varint wordCount, (varint length, bytes)*, element stream
+// style   := u8 alignment, u8 flags (bit 0 textAlignDefined, bit 1 textIndentDefined), 9 signed varints
+//            (margin top/bottom/left/right, padding top/bottom/left/right, text indent)
+
+class PageWriter {
+  std::vector<uint8_t> elements;
+  std::vector<const std::string*> words;
+  std::unordered_map<std::string, uint32_t> wordIndex;
+  std::vector<BlockStyle> styles;
+
+  static void putVarUint(std::vector<uint8_t>& out, uint32_t value);
+  static uint32_t zigzag(const int32_t value) {
+    return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+  }
+  std::vector<uint8_t> encode() const;
+
+ public:
+  void writeByte(uint8_t value) { elements.push_back(value); }
+  void writeVarUint(const uint32_t value) { putVarUint(elements, value); }
+  void writeVarInt(const int32_t value) { writeVarUint(zigzag(value)); }
+  void writeString(const std::string& value);
+
+  // Index of `word` / `style` in the page tables, adding it on first use
+  uint32_t internWord(const std::string& word);
+  uint32_t internStyle(const BlockStyle& style);
+
+  // Writes the page record
+  bool flush(FsFile& file) const;
+};
+
+class PageReader {
+  std::vector<uint8_t> data;
+  size_t pos = 0;
+  bool ok = true;
+  std::vector<std::string_view> words;  // into `data`
+  std::vector<BlockStyle> styles;
+
+ public:
+  // Reads one page record from the current file position and decodes its tables. Buffers are reused across loads.
+  bool load(FsFile& file);
+
+  uint8_t readByte() {
+    if (pos >= data.size()) {
+      ok = false;
+      return 0;
+    }
+    return data[pos++];
+  }
+  uint32_t readVarUint();
+  int32_t readVarInt() {
+    const uint32_t value = readVarUint();
+    return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+  }
+  // View into the record, valid until the next load()
+  std::string_view readString();
+
+  size_t getWordCount() const { return words.size(); }
+  std::string_view word(const uint32_t index) const { return words[index]; }
+  // nullptr (and the reader marked bad) if the index is out of range
+  const BlockStyle* style(uint32_t index);
+
+  bool good() const { return ok; }
+};
+
+// A page loaded from a section file for display. Text, word positions and styles are kept in flat buffers owned by
+// the view and reused by the next load(), so once they have grown to fit a page, turning pages allocates nothing.
+class PageView {
+ public:
+  struct Line {
+    int16_t x;
+    int16_t y;
+    uint16_t firstWord;
+    uint16_t wordCount;
+  };
+  struct Image {
+    int16_t x;
+    int16_t y;
+    int16_t width;
+    int16_t height;
+    uint32_t pathOffset;
+  };
+
+ private:
+  PageReader reader;
+  std::vector<char> text;  // Page dictionary words and image paths, each NUL terminated
+  std::vector<uint32_t> dictionaryOffsets;
+  std::vector<uint32_t> wordOffsets;  // Per word on the page, into `text`
+  std::vector<uint16_t> wordXpos;
+  std::vector<EpdFontFamily::Style> wordStyles;
+  std::vector<Line> lines;
+  std::vector<Image> images;
+
+  uint32_t appendText(std::string_view value);
+  bool readLine(int16_t x, int16_t y);
+  bool readImage(int16_t x, int16_t y);
+
+ public:
+  // Replaces the view's contents with the page record at the current file position
+  bool load(FsFile& file);
+  void clear();
+
+  void render(GfxRenderer& renderer, int fontId, int xOffset, int yOffset) const;
+  bool hasImages() const { return !images.empty(); }
+
+  const std::vector<Line>& getLines() const { return lines; }
+  const char* getWord(const size_t index) const { return text.data() + wordOffsets[index]; }
+  uint16_t getWordX(const size_t index) const { return wordXpos[index]; }
+  EpdFontFamily::Style getWordStyle(const size_t index) const { return wordStyles[index]; }
+};
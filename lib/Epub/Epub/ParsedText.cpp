@@ -4,22 +4,29 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <functional>
-#include <iterator>
 #include <limits>
 #include <vector>
 
+#include "WordWidthCache.h"
 #include "hyphenation/Hyphenator.h"
 
 constexpr int MAX_COST = std::numeric_limits<int>::max();
 
+// Ending a line at a hyphenation point costs as much as this many spaces of slack would
+constexpr int HYPHEN_PENALTY_SPACES = 2;
+
+// Bounds the line breaker's look-ahead even for text of zero-width pieces
+constexpr size_t MAX_PIECES_PER_LINE = 128;
+
 namespace {
 
 // Soft hyphen byte pattern used throughout EPUBs (UTF-8 for U+00AD).
 constexpr char SOFT_HYPHEN_UTF8[] = "\xC2\xAD";
 constexpr size_t SOFT_HYPHEN_BYTES = 2;
 
-bool containsSoftHyphen(const std::string& word) { return word.find(SOFT_HYPHEN_UTF8) != std::string::npos; }
+bool containsSoftHyphen(const char* word) { return strstr(word, SOFT_HYPHEN_UTF8) != nullptr; }
 
 // Removes every soft hyphen in-place so rendered glyphs match measured widths.
 void stripSoftHyphensInPlace(std::string& word) {
@@ -30,14 +37,14 @@ void stripSoftHyphensInPlace(std::string& word) {
 }
 
 // Returns the rendered width for a word while ignoring soft hyphen glyphs and optionally appending a visible hyphen.
-uint16_t measureWordWidth(const GfxRenderer& renderer, const int fontId, const std::string& word,
+uint16_t measureWordWidth(const GfxRenderer& renderer, const int fontId, const char* word,
                           const EpdFontFamily::Style style, const bool appendHyphen = false) {
-  if (word.size() == 1 && word[0] == ' ' && !appendHyphen) {
+  if (word[0] == ' ' && word[1] == '\0' && !appendHyphen) {
     return renderer.getSpaceWidth(fontId);
   }
   const bool hasSoftHyphen = containsSoftHyphen(word);
   if (!hasSoftHyphen && !appendHyphen) {
-    return renderer.getTextWidth(fontId, word.c_str(), style);
+    return renderer.getTextAdvanceX(fontId, word, style);
   }
 
   std::string sanitized = word;
@@ -47,22 +54,48 @@ uint16_t measureWordWidth(const GfxRenderer& renderer, const int fontId, const s
   if (appendHyphen) {
     sanitized.push_back('-');
   }
-  return renderer.getTextWidth(fontId, sanitized.c_str(), style);
+  return renderer.getTextAdvanceX(fontId, sanitized.c_str(), style);
 }
 
 }  // namespace
 
-void ParsedText::addWord(std::string word, const EpdFontFamily::Style fontStyle, const bool underline,
+uint32_t ParsedText::appendText(const char* bytes, const size_t length) {
+  const auto offset = static_cast<uint32_t>(text.size());
+  text.append(bytes, length);
+  text.push_back('\0');
+  return offset;
+}
+
+// Drops the first `count` words, moving the rest (and their text) to the front of the buffers
+void ParsedText::consumeWords(const size_t count) {
+  if (count >= words.size()) {
+    words.clear();
+    text.clear();
+    return;
+  }
+  const uint32_t textStart = words[count].offset;
+  words.erase(words.begin(), words.begin() + count);
+  // Split words may sit out of order in `text`, so only drop the prefix no remaining word points into
+  uint32_t keepFrom = textStart;
+  for (const auto& word : words) {
+    keepFrom = std::min(keepFrom, word.offset);
+  }
+  text.erase(0, keepFrom);
+  for (auto& word : words) {
+    word.offset -= keepFrom;
+  }
+}
+
+void ParsedText::addWord(const char* word, const EpdFontFamily::Style fontStyle, const bool underline,
                          const bool attachToPrevious) {
-  if (word.empty()) return;
+  const size_t length = strlen(word);
+  if (length == 0) return;
 
-  words.push_back(std::move(word));
   EpdFontFamily::Style combinedStyle = fontStyle;
   if (underline) {
     combinedStyle = static_cast<EpdFontFamily::Style>(combinedStyle | EpdFontFamily::UNDERLINE);
   }
-  wordStyles.push_back(combinedStyle);
-  wordContinues.push_back(attachToPrevious);
+  words.push_back({appendText(word, length), static_cast<uint16_t>(length), combinedStyle, attachToPrevious});
 }
 
 // Consumes data to minimize memory usage
@@ -80,149 +113,208 @@ void ParsedText::layoutAndExtractLines(const GfxRenderer& renderer, const int fo
   const int spaceWidth = renderer.getSpaceWidth(fontId);
   auto wordWidths = calculateWordWidths(renderer, fontId);
 
-  // Build indexed continues vector from the parallel list for O(1) access during layout
-  std::vector<bool> continuesVec(wordContinues.begin(), wordContinues.end());
-
-  std::vector<size_t> lineBreakIndices;
-  if (hyphenationEnabled) {
-    // Use greedy layout that can split words mid-loop when a hyphenated prefix fits.
-    lineBreakIndices = computeHyphenatedLineBreaks(renderer, fontId, pageWidth, spaceWidth, wordWidths, continuesVec);
-  } else {
-    lineBreakIndices = computeLineBreaks(renderer, fontId, pageWidth, spaceWidth, wordWidths, continuesVec);
-  }
+  const std::vector<size_t> lineBreakIndices = computeLineBreaks(renderer, fontId, pageWidth, spaceWidth, wordWidths);
   const size_t lineCount = includeLastLine ? lineBreakIndices.size() : lineBreakIndices.size() - 1;
 
   for (size_t i = 0; i < lineCount; ++i) {
-    extractLine(i, pageWidth, spaceWidth, wordWidths, continuesVec, lineBreakIndices, processLine);
+    extractLine(i, pageWidth, spaceWidth, wordWidths, lineBreakIndices, processLine);
   }
+  consumeWords(lineCount > 0 ? lineBreakIndices[lineCount - 1] : 0);
 }
 
-std::vector<uint16_t> ParsedText::calculateWordWidths(const GfxRenderer& renderer, const int fontId) {
-  const size_t totalWordCount = words.size();
-
-  std::vector<uint16_t> wordWidths;
-  wordWidths.reserve(totalWordCount);
+// Width of `length` bytes of text, which must be NUL terminated after them
+uint16_t ParsedText::measureText(const GfxRenderer& renderer, const int fontId, const char* bytes, const size_t length,
+                                 const EpdFontFamily::Style style) const {
+  if (!widthCache) {
+    return measureWordWidth(renderer, fontId, bytes, style);
+  }
 
-  auto wordsIt = words.begin();
-  auto wordStylesIt = wordStyles.begin();
+  const auto key = WordWidthCache::keyOf(fontId, style, bytes, length);
+  uint16_t width;
+  if (!widthCache->lookup(key, width)) {
+    width = measureWordWidth(renderer, fontId, bytes, style);
+    widthCache->insert(key, width);
+  }
+  return width;
+}
 
-  while (wordsIt != words.end()) {
-    wordWidths.push_back(measureWordWidth(renderer, fontId, *wordsIt, *wordStylesIt));
+uint16_t ParsedText::measureWord(const GfxRenderer& renderer, const int fontId, const size_t index) const {
+  return measureText(renderer, fontId, wordText(index), words[index].length, words[index].style);
+}
 
-    std::advance(wordsIt, 1);
-    std::advance(wordStylesIt, 1);
+std::vector<uint16_t> ParsedText::calculateWordWidths(const GfxRenderer& renderer, const int fontId) const {
+  std::vector<uint16_t> wordWidths;
+  wordWidths.reserve(words.size());
+  for (size_t i = 0; i < words.size(); i++) {
+    wordWidths.push_back(measureWord(renderer, fontId, i));
   }
-
   return wordWidths;
 }
 
-std::vector<size_t> ParsedText::computeLineBreaks(const GfxRenderer& renderer, const int fontId, const int pageWidth,
-                                                  const int spaceWidth, std::vector<uint16_t>& wordWidths,
-                                                  std::vector<bool>& continuesVec) {
-  if (words.empty()) {
-    return {};
-  }
+int ParsedText::getFirstLineIndent() const {
+  // Only for left/justified text without extra paragraph spacing
+  return blockStyle.textIndent > 0 && !extraParagraphSpacing &&
+                 (blockStyle.alignment == CssTextAlign::Justify || blockStyle.alignment == CssTextAlign::Left)
+             ? blockStyle.textIndent
+             : 0;
+}
 
-  // Calculate first line indent (only for left/justified text without extra paragraph spacing)
-  const int firstLineIndent =
-      blockStyle.textIndent > 0 && !extraParagraphSpacing &&
-              (blockStyle.alignment == CssTextAlign::Justify || blockStyle.alignment == CssTextAlign::Left)
-          ? blockStyle.textIndent
-          : 0;
+// Cuts words at their hyphenation points into the pieces the line breaker chooses between. Without hyphenation only
+// words too wide for a line are cut, falling back to breaking anywhere if the language has no rule for them.
+std::vector<ParsedText::Piece> ParsedText::collectPieces(const GfxRenderer& renderer, const int fontId,
+                                                         const int pageWidth, const int spaceWidth,
+                                                         const std::vector<uint16_t>& wordWidths) {
+  std::vector<Piece> pieces;
+  pieces.reserve(words.size());
+
+  // A paragraph that fits on its first line never ends a line inside a word, so its words need no breaks
+  int singleLineWidth = 0;
+  for (size_t w = 0; w < words.size(); w++) {
+    singleLineWidth += wordWidths[w] + (w > 0 && !words[w].continues ? spaceWidth : 0);
+  }
+  const bool mayEndLines = singleLineWidth > pageWidth - getFirstLineIndent();
 
-  // Ensure any word that would overflow even as the first entry on a line is split using fallback hyphenation.
-  for (size_t i = 0; i < wordWidths.size(); ++i) {
+  for (size_t w = 0; w < words.size(); w++) {
+    const Word& word = words[w];
+    const bool breakAfterWord = w + 1 == words.size() || !words[w + 1].continues;
     // First word needs to fit in reduced width if there's an indent
-    const int effectiveWidth = i == 0 ? pageWidth - firstLineIndent : pageWidth;
-    while (wordWidths[i] > effectiveWidth) {
-      if (!hyphenateWordAtIndex(i, effectiveWidth, renderer, fontId, wordWidths, /*allowFallbackBreaks=*/true,
-                                &continuesVec)) {
-        break;
+    const bool overflows = wordWidths[w] > (w == 0 ? pageWidth - getFirstLineIndent() : pageWidth);
+
+    const Hyphenator::Breaks breaks = (hyphenationEnabled && mayEndLines) || overflows
+                                          ? Hyphenator::breakOffsets(wordText(w), word.length, overflows)
+                                          : Hyphenator::Breaks();
+    if (!breaks.empty()) {
+      // Advances add up glyph by glyph, so each piece is measured on its own, cut out of the word in place, and the
+      // word is only walked once. Pieces go through the width cache: common syllables and repeated words cost no
+      // glyph lookups.
+      char* bytes = &text[word.offset];
+      int hyphenWidth = -1;
+      size_t start = 0;
+      int startWidth = 0;
+      for (const auto& info : breaks) {
+        if (info.byteOffset <= start || info.byteOffset >= word.length) {
+          continue;
+        }
+        const char cut = bytes[info.byteOffset];
+        bytes[info.byteOffset] = '\0';
+        const int pieceWidth = measureText(renderer, fontId, bytes + start, info.byteOffset - start, word.style);
+        bytes[info.byteOffset] = cut;
+        if (info.requiresInsertedHyphen && hyphenWidth < 0) {
+          hyphenWidth = renderer.getTextAdvanceX(fontId, "-", word.style);
+        }
+        pieces.push_back({static_cast<uint16_t>(w), static_cast<uint16_t>(info.byteOffset),
+                          static_cast<uint16_t>(pieceWidth),
+                          static_cast<uint8_t>(info.requiresInsertedHyphen ? hyphenWidth : 0), true});
+        start = info.byteOffset;
+        startWidth += pieceWidth;
       }
+      pieces.push_back({static_cast<uint16_t>(w), word.length,
+                        static_cast<uint16_t>(std::max(0, wordWidths[w] - startWidth)), 0, breakAfterWord});
+    } else {
+      pieces.push_back({static_cast<uint16_t>(w), word.length, wordWidths[w], 0, breakAfterWord});
     }
   }
+  return pieces;
+}
 
-  const size_t totalWordCount = words.size();
+// Minimum total cost line breaking in the spirit of Knuth-Plass. A line costs its squared slack, plus a penalty when
+// it ends at a hyphenation point; the last line is free. Lines are only ever a page width long, so each piece looks
+// at a bounded window of line ends and the whole paragraph takes linear time. Hyphenated breaks are chosen here and
+// only then turned into word splits.
+std::vector<size_t> ParsedText::computeLineBreaks(const GfxRenderer& renderer, const int fontId, const int pageWidth,
+                                                  const int spaceWidth, std::vector<uint16_t>& wordWidths) {
+  if (words.empty()) {
+    return {};
+  }
 
-  // DP table to store the minimum badness (cost) of lines starting at index i
-  std::vector<int> dp(totalWordCount);
-  // 'ans[i]' stores the index 'j' of the *last word* in the optimal line starting at 'i'
-  std::vector<size_t> ans(totalWordCount);
+  const int indent = getFirstLineIndent();
+  const std::vector<Piece> pieces = collectPieces(renderer, fontId, pageWidth, spaceWidth, wordWidths);
+  const size_t pieceCount = pieces.size();
+  const long long hyphenPenalty = static_cast<long long>(HYPHEN_PENALTY_SPACES * spaceWidth) * HYPHEN_PENALTY_SPACES *
+                                  spaceWidth;
 
-  // Base Case
-  dp[totalWordCount - 1] = 0;
-  ans[totalWordCount - 1] = totalWordCount - 1;
+  // cost[i] is the minimum cost of laying out pieces [i, end) with a line starting at piece i; lineEnd[i] is where
+  // that first line ends (exclusive)
+  std::vector<int> cost(pieceCount + 1);
+  std::vector<uint32_t> lineEnd(pieceCount + 1);
+  cost[pieceCount] = 0;
+  lineEnd[pieceCount] = pieceCount;
 
-  for (int i = totalWordCount - 2; i >= 0; --i) {
-    int currlen = 0;
-    dp[i] = MAX_COST;
+  for (size_t i = pieceCount; i-- > 0;) {
+    cost[i] = MAX_COST;
+    lineEnd[i] = i + 1;
 
     // First line has reduced width due to text-indent
-    const int effectivePageWidth = i == 0 ? pageWidth - firstLineIndent : pageWidth;
+    const int effectivePageWidth = i == 0 ? pageWidth - indent : pageWidth;
+    int lineWidth = 0;
 
-    for (size_t j = i; j < totalWordCount; ++j) {
-      // Add space before word j, unless it's the first word on the line or a continuation
-      const int gap = j > static_cast<size_t>(i) && !continuesVec[j] ? spaceWidth : 0;
-      currlen += wordWidths[j] + gap;
+    for (size_t j = i; j < pieceCount && j - i < MAX_PIECES_PER_LINE; ++j) {
+      const Piece& piece = pieces[j];
+      // Add space before piece j if it starts a word, unless it's the first on the line or a continuation
+      const bool startsWord = j > i && pieces[j - 1].word != piece.word;
+      lineWidth += piece.width + (startsWord && !words[piece.word].continues ? spaceWidth : 0);
 
-      if (currlen > effectivePageWidth) {
-        break;
+      if (lineWidth + piece.hyphenWidth > effectivePageWidth) {
+        if (piece.hyphenWidth == 0 || lineWidth > effectivePageWidth) {
+          break;
+        }
+        continue;  // The hyphen doesn't fit, but the rest of the word might on this line
       }
-
-      // Cannot break after word j if the next word attaches to it (continuation group)
-      if (j + 1 < totalWordCount && continuesVec[j + 1]) {
+      if (!piece.breakAfter) {
         continue;
       }
 
-      int cost;
-      if (j == totalWordCount - 1) {
-        cost = 0;  // Last line
+      long long candidate;
+      if (j + 1 == pieceCount) {
+        candidate = 0;  // Last line
       } else {
-        const int remainingSpace = effectivePageWidth - currlen;
-        // Use long long for the square to prevent overflow
-        const long long cost_ll = static_cast<long long>(remainingSpace) * remainingSpace + dp[j + 1];
-
-        if (cost_ll > MAX_COST) {
-          cost = MAX_COST;
-        } else {
-          cost = static_cast<int>(cost_ll);
-        }
+        const int remainingSpace = effectivePageWidth - lineWidth - piece.hyphenWidth;
+        const bool midWord = pieces[j + 1].word == piece.word;
+        candidate = static_cast<long long>(remainingSpace) * remainingSpace + (midWord ? hyphenPenalty : 0) +
+                    cost[j + 1];
       }
 
-      if (cost < dp[i]) {
-        dp[i] = cost;
-        ans[i] = j;  // j is the index of the last word in this optimal line
+      if (candidate < cost[i]) {
+        cost[i] = static_cast<int>(std::min<long long>(candidate, MAX_COST - 1));
+        lineEnd[i] = j + 1;
       }
     }
 
-    // Handle oversized word: if no valid configuration found, force single-word line
+    // Handle oversized piece: if no valid configuration found, force a single piece line
     // This prevents cascade failure where one oversized word breaks all preceding words
-    if (dp[i] == MAX_COST) {
-      ans[i] = i;  // Just this word on its own line
-      // Inherit cost from next word to allow subsequent words to find valid configurations
-      if (i + 1 < static_cast<int>(totalWordCount)) {
-        dp[i] = dp[i + 1];
-      } else {
-        dp[i] = 0;
-      }
+    if (cost[i] == MAX_COST) {
+      lineEnd[i] = i + 1;
+      // Inherit cost from the next piece to allow subsequent words to find valid configurations
+      cost[i] = cost[i + 1];
     }
   }
 
-  // Stores the index of the word that starts the next line (last_word_index + 1)
-  std::vector<size_t> lineBreakIndices;
-  size_t currentWordIndex = 0;
-
-  while (currentWordIndex < totalWordCount) {
-    size_t nextBreakIndex = ans[currentWordIndex] + 1;
-
-    // Safety check: prevent infinite loop if nextBreakIndex doesn't advance
-    if (nextBreakIndex <= currentWordIndex) {
-      // Force advance by at least one word to avoid infinite loop
-      nextBreakIndex = currentWordIndex + 1;
+  // Turn the chosen mid-word breaks into word splits and the line ends into word indices. Splitting from the back
+  // keeps the indices of the words still to be split valid.
+  std::vector<size_t> lineEnds;
+  for (size_t i = 0; i < pieceCount; i = lineEnd[i]) {
+    lineEnds.push_back(lineEnd[i]);
+  }
+  std::vector<size_t> lineBreakIndices(lineEnds.size());
+  size_t splitCount = 0;
+  for (const size_t end : lineEnds) {
+    if (end < pieceCount && pieces[end].word == pieces[end - 1].word) {
+      splitCount++;
     }
-
-    lineBreakIndices.push_back(nextBreakIndex);
-    currentWordIndex = nextBreakIndex;
+  }
+  for (size_t line = lineEnds.size(); line-- > 0;) {
+    const size_t end = lineEnds[line];
+    if (end == pieceCount) {
+      lineBreakIndices[line] = words.size() + splitCount;
+      continue;
+    }
+    const Piece& last = pieces[end - 1];
+    if (pieces[end].word == last.word) {
+      splitCount--;
+      splitWord(last.word, last.end, last.hyphenWidth > 0, renderer, fontId, wordWidths);
+    }
+    // Each split before this line end adds a word in front of it
+    lineBreakIndices[line] = last.word + splitCount + 1;
   }
 
   return lineBreakIndices;
@@ -238,182 +330,46 @@ void ParsedText::applyParagraphIndent() {
     // The actual indent positioning is handled in extractLine()
   } else if (blockStyle.alignment == CssTextAlign::Justify || blockStyle.alignment == CssTextAlign::Left) {
     // No CSS text-indent defined - use EmSpace fallback for visual indent
-    words.front().insert(0, "\xe2\x80\x83");
+    Word& first = words.front();
+    const std::string indented = PARAGRAPH_INDENT + std::string(wordText(0), first.length);
+    first.offset = appendText(indented.data(), indented.size());
+    first.length = static_cast<uint16_t>(indented.size());
   }
 }
 
-// Builds break indices while opportunistically splitting the word that would overflow the current line.
-std::vector<size_t> ParsedText::computeHyphenatedLineBreaks(const GfxRenderer& renderer, const int fontId,
-                                                            const int pageWidth, const int spaceWidth,
-                                                            std::vector<uint16_t>& wordWidths,
-                                                            std::vector<bool>& continuesVec) {
-  // Calculate first line indent (only for left/justified text without extra paragraph spacing)
-  const int firstLineIndent =
-      blockStyle.textIndent > 0 && !extraParagraphSpacing &&
-              (blockStyle.alignment == CssTextAlign::Justify || blockStyle.alignment == CssTextAlign::Left)
-          ? blockStyle.textIndent
-          : 0;
-
-  std::vector<size_t> lineBreakIndices;
-  size_t currentIndex = 0;
-  bool isFirstLine = true;
-
-  while (currentIndex < wordWidths.size()) {
-    const size_t lineStart = currentIndex;
-    int lineWidth = 0;
-
-    // First line has reduced width due to text-indent
-    const int effectivePageWidth = isFirstLine ? pageWidth - firstLineIndent : pageWidth;
-
-    // Consume as many words as possible for current line, splitting when prefixes fit
-    while (currentIndex < wordWidths.size()) {
-      const bool isFirstWord = currentIndex == lineStart;
-      const int spacing = isFirstWord || continuesVec[currentIndex] ? 0 : spaceWidth;
-      const int candidateWidth = spacing + wordWidths[currentIndex];
-
-      // Word fits on current line
-      if (lineWidth + candidateWidth <= effectivePageWidth) {
-        lineWidth += candidateWidth;
-        ++currentIndex;
-        continue;
-      }
-
-      // Word would overflow — try to split based on hyphenation points
-      const int availableWidth = effectivePageWidth - lineWidth - spacing;
-      const bool allowFallbackBreaks = isFirstWord;  // Only for first word on line
-
-      if (availableWidth > 0 && hyphenateWordAtIndex(currentIndex, availableWidth, renderer, fontId, wordWidths,
-                                                     allowFallbackBreaks, &continuesVec)) {
-        // Prefix now fits; append it to this line and move to next line
-        lineWidth += spacing + wordWidths[currentIndex];
-        ++currentIndex;
-        break;
-      }
-
-      // Could not split: force at least one word per line to avoid infinite loop
-      if (currentIndex == lineStart) {
-        lineWidth += candidateWidth;
-        ++currentIndex;
-      }
-      break;
-    }
-
-    // Don't break before a continuation word (e.g., orphaned "?" after "question").
-    // Backtrack to the start of the continuation group so the whole group moves to the next line.
-    while (currentIndex > lineStart + 1 && currentIndex < wordWidths.size() && continuesVec[currentIndex]) {
-      --currentIndex;
-    }
-
-    lineBreakIndices.push_back(currentIndex);
-    isFirstLine = false;
+// Splits words[wordIndex] at byte `offset` into a prefix (with a hyphen appended if asked) and a remainder word.
+void ParsedText::splitWord(const size_t wordIndex, const size_t offset, const bool insertHyphen,
+                           const GfxRenderer& renderer, const int fontId, std::vector<uint16_t>& wordWidths) {
+  // The remainder gets a copy of its bytes at the end of the buffer; the prefix stays in place and is cut short.
+  // The remainder is at least one byte, so there is always room for the hyphen and the terminator.
+  const uint16_t remainderLength = words[wordIndex].length - offset;
+  const uint32_t remainderOffset = appendText(wordText(wordIndex) + offset, remainderLength);
+  Word& prefix = words[wordIndex];
+  char* prefixText = &text[prefix.offset];
+  prefix.length = static_cast<uint16_t>(offset);
+  if (insertHyphen) {
+    prefixText[prefix.length++] = '-';
   }
+  prefixText[prefix.length] = '\0';
 
-  return lineBreakIndices;
-}
-
-// Splits words[wordIndex] into prefix (adding a hyphen only when needed) and remainder when a legal breakpoint fits the
-// available width.
-bool ParsedText::hyphenateWordAtIndex(const size_t wordIndex, const int availableWidth, const GfxRenderer& renderer,
-                                      const int fontId, std::vector<uint16_t>& wordWidths,
-                                      const bool allowFallbackBreaks, std::vector<bool>* continuesVec) {
-  // Guard against invalid indices or zero available width before attempting to split.
-  if (availableWidth <= 0 || wordIndex >= words.size()) {
-    return false;
-  }
-
-  // Get iterators to target word and style.
-  auto wordIt = words.begin();
-  auto styleIt = wordStyles.begin();
-  std::advance(wordIt, wordIndex);
-  std::advance(styleIt, wordIndex);
-
-  const std::string& word = *wordIt;
-  const auto style = *styleIt;
-
-  // Collect candidate breakpoints (byte offsets and hyphen requirements).
-  auto breakInfos = Hyphenator::breakOffsets(word, allowFallbackBreaks);
-  if (breakInfos.empty()) {
-    return false;
-  }
-
-  size_t chosenOffset = 0;
-  int chosenWidth = -1;
-  bool chosenNeedsHyphen = true;
-
-  // Iterate over each legal breakpoint and retain the widest prefix that still fits.
-  for (const auto& info : breakInfos) {
-    const size_t offset = info.byteOffset;
-    if (offset == 0 || offset >= word.size()) {
-      continue;
-    }
-
-    const bool needsHyphen = info.requiresInsertedHyphen;
-    const int prefixWidth = measureWordWidth(renderer, fontId, word.substr(0, offset), style, needsHyphen);
-    if (prefixWidth > availableWidth || prefixWidth <= chosenWidth) {
-      continue;  // Skip if too wide or not an improvement
-    }
-
-    chosenWidth = prefixWidth;
-    chosenOffset = offset;
-    chosenNeedsHyphen = needsHyphen;
-  }
-
-  if (chosenWidth < 0) {
-    // No hyphenation point produced a prefix that fits in the remaining space.
-    return false;
-  }
-
-  // Split the word at the selected breakpoint and append a hyphen if required.
-  std::string remainder = word.substr(chosenOffset);
-  wordIt->resize(chosenOffset);
-  if (chosenNeedsHyphen) {
-    wordIt->push_back('-');
-  }
-
-  // Insert the remainder word (with matching style and continuation flag) directly after the prefix.
-  auto insertWordIt = std::next(wordIt);
-  auto insertStyleIt = std::next(styleIt);
-  words.insert(insertWordIt, remainder);
-  wordStyles.insert(insertStyleIt, style);
-
-  // The remainder inherits whatever continuation status the original word had with the word after it.
-  // Find the continues entry for the original word and insert the remainder's entry after it.
-  auto continuesIt = wordContinues.begin();
-  std::advance(continuesIt, wordIndex);
-  const bool originalContinuedToNext = *continuesIt;
-  // The original word (now prefix) does NOT continue to remainder (hyphen separates them)
-  *continuesIt = false;
-  const auto insertContinuesIt = std::next(continuesIt);
-  wordContinues.insert(insertContinuesIt, originalContinuedToNext);
-
-  // Keep the indexed vector in sync if provided
-  if (continuesVec) {
-    (*continuesVec)[wordIndex] = false;
-    continuesVec->insert(continuesVec->begin() + wordIndex + 1, originalContinuedToNext);
-  }
+  // The prefix keeps its attachment to the word before it; the remainder starts a new piece of text (a line break
+  // separates them), so it must stay breakable from the prefix
+  const Word remainder = {remainderOffset, remainderLength, prefix.style, false};
+  words.insert(words.begin() + wordIndex + 1, remainder);
 
   // Update cached widths to reflect the new prefix/remainder pairing.
-  wordWidths[wordIndex] = static_cast<uint16_t>(chosenWidth);
-  const uint16_t remainderWidth = measureWordWidth(renderer, fontId, remainder, style);
-  wordWidths.insert(wordWidths.begin() + wordIndex + 1, remainderWidth);
-  return true;
+  wordWidths[wordIndex] = measureWord(renderer, fontId, wordIndex);
+  wordWidths.insert(wordWidths.begin() + wordIndex + 1, measureWord(renderer, fontId, wordIndex + 1));
 }
 
 void ParsedText::extractLine(const size_t breakIndex, const int pageWidth, const int spaceWidth,
-                             const std::vector<uint16_t>& wordWidths, const std::vector<bool>& continuesVec,
-                             const std::vector<size_t>& lineBreakIndices,
+                             const std::vector<uint16_t>& wordWidths, const std::vector<size_t>& lineBreakIndices,
                              const std::function<void(std::shared_ptr<TextBlock>)>& processLine) {
   const size_t lineBreak = lineBreakIndices[breakIndex];
   const size_t lastBreakAt = breakIndex > 0 ? lineBreakIndices[breakIndex - 1] : 0;
   const size_t lineWordCount = lineBreak - lastBreakAt;
 
-  // Calculate first line indent (only for left/justified text without extra paragraph spacing)
-  const bool isFirstLine = breakIndex == 0;
-  const int firstLineIndent =
-      isFirstLine && blockStyle.textIndent > 0 && !extraParagraphSpacing &&
-              (blockStyle.alignment == CssTextAlign::Justify || blockStyle.alignment == CssTextAlign::Left)
-          ? blockStyle.textIndent
-          : 0;
+  const int firstLineIndent = breakIndex == 0 ? getFirstLineIndent() : 0;
 
   // Calculate total word width for this line and count actual word gaps
   // (continuation words attach to previous word with no gap)
@@ -423,7 +379,7 @@ void ParsedText::extractLine(const size_t breakIndex, const int pageWidth, const
   for (size_t wordIdx = 0; wordIdx < lineWordCount; wordIdx++) {
     lineWordWidthSum += wordWidths[lastBreakAt + wordIdx];
     // Count gaps: each word after the first creates a gap, unless it's a continuation
-    if (wordIdx > 0 && !continuesVec[lastBreakAt + wordIdx]) {
+    if (wordIdx > 0 && !words[lastBreakAt + wordIdx].continues) {
       actualGapCount++;
     }
   }
@@ -458,32 +414,19 @@ void ParsedText::extractLine(const size_t breakIndex, const int pageWidth, const
     lineXPos.push_back(xpos);
 
     // Add spacing after this word, unless the next word is a continuation
-    const bool nextIsContinuation = wordIdx + 1 < lineWordCount && continuesVec[lastBreakAt + wordIdx + 1];
+    const bool nextIsContinuation = wordIdx + 1 < lineWordCount && words[lastBreakAt + wordIdx + 1].continues;
 
     xpos += currentWordWidth + (nextIsContinuation ? 0 : spacing);
   }
 
-  // Iterators always start at the beginning as we are moving content with splice below
-  auto wordEndIt = words.begin();
-  auto wordStyleEndIt = wordStyles.begin();
-  auto wordContinuesEndIt = wordContinues.begin();
-  std::advance(wordEndIt, lineWordCount);
-  std::advance(wordStyleEndIt, lineWordCount);
-  std::advance(wordContinuesEndIt, lineWordCount);
-
-  // *** CRITICAL STEP: CONSUME DATA USING SPLICE ***
+  // Words are copied out here; layoutAndExtractLines() drops the consumed ones once all lines are extracted
   std::list<std::string> lineWords;
-  lineWords.splice(lineWords.begin(), words, words.begin(), wordEndIt);
   std::list<EpdFontFamily::Style> lineWordStyles;
-  lineWordStyles.splice(lineWordStyles.begin(), wordStyles, wordStyles.begin(), wordStyleEndIt);
-
-  // Consume continues flags (not passed to TextBlock, but must be consumed to stay in sync)
-  std::list<bool> lineContinues;
-  lineContinues.splice(lineContinues.begin(), wordContinues, wordContinues.begin(), wordContinuesEndIt);
-
-  for (auto& word : lineWords) {
-    if (containsSoftHyphen(word)) {
-      stripSoftHyphensInPlace(word);
+  for (size_t i = lastBreakAt; i < lineBreak; i++) {
+    lineWords.emplace_back(wordText(i), words[i].length);
+    lineWordStyles.push_back(words[i].style);
+    if (containsSoftHyphen(wordText(i))) {
+      stripSoftHyphensInPlace(lineWords.back());
     }
   }
 
@@ -3,7 +3,6 @@
 #include <EpdFontFamily.h>
 
 #include <functional>
-#include <list>
 #include <memory>
 #include <string>
 #include <vector>
@@ -12,36 +11,67 @@
 #include "blocks/TextBlock.h"
 
 class GfxRenderer;
+class WordWidthCache;
+
+// Prepended to the first word of a paragraph when CSS sets no text-indent
+constexpr char PARAGRAPH_INDENT[] = "\xe2\x80\x83";  // Em space
+constexpr size_t PARAGRAPH_INDENT_BYTES = sizeof(PARAGRAPH_INDENT) - 1;
 
 class ParsedText {
-  std::list<std::string> words;
-  std::list<EpdFontFamily::Style> wordStyles;
-  std::list<bool> wordContinues;  // true = word attaches to previous (no space before it)
+  // Per-word metadata; the word's bytes live in `text`
+  struct Word {
+    uint32_t offset;  // Into `text`, NUL terminated
+    uint16_t length;
+    EpdFontFamily::Style style;
+    bool continues;  // true = word attaches to previous (no space before it)
+  };
+
+  // A word, or the part of one between two of its hyphenation points; lines end after a piece
+  struct Piece {
+    uint16_t word;
+    uint16_t end;  // Byte offset in the word where the piece ends
+    uint16_t width;
+    uint8_t hyphenWidth;  // Added to the line if it ends here, 0 unless the break inserts a hyphen
+    bool breakAfter;      // False before a continuation word
+  };
+
+  std::string text;  // Word bytes, each word followed by a NUL so it can be measured in place
+  std::vector<Word> words;
   BlockStyle blockStyle;
   bool extraParagraphSpacing;
   bool hyphenationEnabled;
+  WordWidthCache* widthCache;  // Optional, shared across the paragraphs of a section build
+
+  const char* wordText(const size_t index) const { return text.data() + words[index].offset; }
+  uint16_t measureText(const GfxRenderer& renderer, int fontId, const char* bytes, size_t length,
+                       EpdFontFamily::Style style) const;
+  uint16_t measureWord(const GfxRenderer& renderer, int fontId, size_t index) const;
+  uint32_t appendText(const char* bytes, size_t length);
+  void consumeWords(size_t count);
 
   void applyParagraphIndent();
+  int getFirstLineIndent() const;
+  std::vector<Piece> collectPieces(const GfxRenderer& renderer, int fontId, int pageWidth, int spaceWidth,
+                                   const std::vector<uint16_t>& wordWidths);
   std::vector<size_t> computeLineBreaks(const GfxRenderer& renderer, int fontId, int pageWidth, int spaceWidth,
-                                        std::vector<uint16_t>& wordWidths, std::vector<bool>& continuesVec);
-  std::vector<size_t> computeHyphenatedLineBreaks(const GfxRenderer& renderer, int fontId, int pageWidth,
-                                                  int spaceWidth, std::vector<uint16_t>& wordWidths,
-                                                  std::vector<bool>& continuesVec);
-  bool hyphenateWordAtIndex(size_t wordIndex, int availableWidth, const GfxRenderer& renderer, int fontId,
-                            std::vector<uint16_t>& wordWidths, bool allowFallbackBreaks,
-                            std::vector<bool>* continuesVec = nullptr);
+                                        std::vector<uint16_t>& wordWidths);
+  void splitWord(size_t wordIndex, size_t offset, bool insertHyphen, const GfxRenderer& renderer, int fontId,
+                 std::vector<uint16_t>& wordWidths);
   void extractLine(size_t breakIndex, int pageWidth, int spaceWidth, const std::vector<uint16_t>& wordWidths,
-                   const std::vector<bool>& continuesVec, const std::vector<size_t>& lineBreakIndices,
+                   const std::vector<size_t>& lineBreakIndices,
                    const std::function<void(std::shared_ptr<TextBlock>)>& processLine);
-  std::vector<uint16_t> calculateWordWidths(const GfxRenderer& renderer, int fontId);
+  std::vector<uint16_t> calculateWordWidths(const GfxRenderer& renderer, int fontId) const;
 
  public:
   explicit ParsedText(const bool extraParagraphSpacing, const bool hyphenationEnabled = false,
-                      const BlockStyle& blockStyle = BlockStyle())
-      : blockStyle(blockStyle), extraParagraphSpacing(extraParagraphSpacing), hyphenationEnabled(hyphenationEnabled) {}
+                      const BlockStyle& blockStyle = BlockStyle(), WordWidthCache* widthCache = nullptr)
+      : blockStyle(blockStyle),
+        extraParagraphSpacing(extraParagraphSpacing),
+        hyphenationEnabled(hyphenationEnabled),
+        widthCache(widthCache) {}
   ~ParsedText() = default;
 
-  void addWord(std::string word, EpdFontFamily::Style fontStyle, bool underline = false, bool attachToPrevious = false);
+  void addWord(const char* word, EpdFontFamily::Style fontStyle, bool underline = false, bool attachToPrevious = false);
   void setBlockStyle(const BlockStyle& blockStyle) { this->blockStyle = blockStyle; }
   BlockStyle& getBlockStyle() { return blockStyle; }
   size_t size() const { return words.size(); }
@@ -1,20 +1,50 @@
 #include "Section.h"
 
+#include <Fnv1a.h>
 #include <HalStorage.h>
 #include <Logging.h>
 #include <Serialization.h>
 
+#include <climits>
+
 #include "Page.h"
+#include "SectionCacheIndex.h"
 #include "hyphenation/Hyphenator.h"
 #include "parsers/ChapterHtmlSlimParser.h"
 
 namespace {
-constexpr uint8_t SECTION_FILE_VERSION = 13;
-constexpr uint32_t HEADER_SIZE = sizeof(uint8_t) + sizeof(int) + sizeof(float) + sizeof(bool) + sizeof(uint8_t) +
-                                 sizeof(uint16_t) + sizeof(uint16_t) + sizeof(uint16_t) + sizeof(bool) + sizeof(bool) +
-                                 sizeof(uint32_t);
+constexpr uint8_t SECTION_FILE_VERSION = 16;
+constexpr uint32_t HEADER_SIZE = sizeof(uint8_t) + sizeof(uint8_t) + sizeof(int) + sizeof(float) + sizeof(bool) +
+                                 sizeof(uint8_t) + sizeof(uint16_t) + sizeof(uint16_t) + sizeof(uint16_t) + sizeof(bool) +
+                                 sizeof(bool) + sizeof(uint32_t);
+
+// FNV-1a over every parameter that changes the layout, naming the section file of that layout
+class LayoutHasher {
+  uint32_t hash = FNV1A_32_BASIS;
+
+ public:
+  template <typename T>
+  LayoutHasher& add(const T& value) {
+    hash = fnv1a(&value, sizeof(T), hash);
+    return *this;
+  }
+  uint32_t get() const { return hash; }
+};
 }  // namespace
 
+Section::Section(const std::shared_ptr<Epub>& epub, const int spineIndex, GfxRenderer& renderer)
+    : epub(epub),
+      spineIndex(spineIndex),
+      renderer(renderer) {}
+
+Section::~Section() {
+  // A chapter left half indexed can't be resumed later, drop it
+  if (builder) {
+    LOG_DBG("SCT", "Abandoning section build at page %d", pageCount);
+    abortSectionFile();
+  }
+}
+
 uint32_t Section::onPageComplete(std::unique_ptr<Page> page) {
   if (!file) {
     LOG_ERR("SCT", "File not open for writing page %d", pageCount);
@@ -32,6 +62,33 @@ uint32_t Section::onPageComplete(std::unique_ptr<Page> page) {
   return position;
 }
 
+void Section::selectVariant(const int fontId, const float lineCompression, const bool extraParagraphSpacing,
+                            const uint8_t paragraphAlignment, const uint16_t viewportWidth,
+                            const uint16_t viewportHeight, const bool hyphenationEnabled, const bool embeddedStyle) {
+  layoutHash = LayoutHasher()
+                   .add(fontId)
+                   .add(lineCompression)
+                   .add(extraParagraphSpacing)
+                   .add(paragraphAlignment)
+                   .add(viewportWidth)
+                   .add(viewportHeight)
+                   .add(hyphenationEnabled)
+                   .add(embeddedStyle)
+                   .get();
+  filePath = SectionCacheIndex::getSectionFilePath(epub->getCachePath(), spineIndex, layoutHash);
+}
+
+void Section::recordCacheUse(const uint32_t size) const {
+  SectionCacheIndex& index = epub->getSectionCacheIndex();
+  index.touch(spineIndex, layoutHash, size);
+  if (size > 0) {
+    // Only a newly built file can push the book over its budget. Plain loads (including the prefetch task checking
+    // neighbours) leave the new order in memory until the next build or the book closes.
+    index.evictToBudget();
+    index.commit();
+  }
+}
+
 void Section::writeSectionFileHeader(const int fontId, const float lineCompression, const bool extraParagraphSpacing,
                                      const uint8_t paragraphAlignment, const uint16_t viewportWidth,
                                      const uint16_t viewportHeight, const bool hyphenationEnabled,
@@ -40,12 +97,13 @@ void Section::writeSectionFileHeader(const int fontId, const float lineCompressi
     LOG_DBG("SCT", "File not open for writing header");
     return;
   }
-  static_assert(HEADER_SIZE == sizeof(SECTION_FILE_VERSION) + sizeof(fontId) + sizeof(lineCompression) +
-                                   sizeof(extraParagraphSpacing) + sizeof(paragraphAlignment) + sizeof(viewportWidth) +
-                                   sizeof(viewportHeight) + sizeof(pageCount) + sizeof(hyphenationEnabled) +
-                                   sizeof(embeddedStyle) + sizeof(uint32_t),
+  static_assert(HEADER_SIZE == sizeof(SECTION_FILE_VERSION) + sizeof(CSS_CACHE_VERSION) + sizeof(fontId) +
+                                   sizeof(lineCompression) + sizeof(extraParagraphSpacing) + sizeof(paragraphAlignment) +
+                                   sizeof(viewportWidth) + sizeof(viewportHeight) + sizeof(pageCount) +
+                                   sizeof(hyphenationEnabled) + sizeof(embeddedStyle) + sizeof(uint32_t),
                 "Header size mismatch");
   serialization::writePod(file, SECTION_FILE_VERSION);
+  serialization::writePod(file, CSS_CACHE_VERSION);  // Pages hold styles resolved under these rules
   serialization::writePod(file, fontId);
   serialization::writePod(file, lineCompression);
   serialization::writePod(file, extraParagraphSpacing);
@@ -61,17 +119,21 @@ void Section::writeSectionFileHeader(const int fontId, const float lineCompressi
 bool Section::loadSectionFile(const int fontId, const float lineCompression, const bool extraParagraphSpacing,
                               const uint8_t paragraphAlignment, const uint16_t viewportWidth,
                               const uint16_t viewportHeight, const bool hyphenationEnabled, const bool embeddedStyle) {
-  if (!Storage.openFileForRead("SCT", filePath, file)) {
+  selectVariant(fontId, lineCompression, extraParagraphSpacing, paragraphAlignment, viewportWidth, viewportHeight,
+                hyphenationEnabled, embeddedStyle);
+  if (!Storage.exists(filePath.c_str()) || !Storage.openFileForRead("SCT", filePath, file)) {
     return false;
   }
 
   // Match parameters
   {
     uint8_t version;
+    uint8_t cssVersion;
     serialization::readPod(file, version);
-    if (version != SECTION_FILE_VERSION) {
+    serialization::readPod(file, cssVersion);
+    if (version != SECTION_FILE_VERSION || cssVersion != CSS_CACHE_VERSION) {
       file.close();
-      LOG_ERR("SCT", "Deserialization failed: Unknown version %u", version);
+      LOG_ERR("SCT", "Deserialization failed: Unknown version %u (CSS %u)", version, cssVersion);
       clearCache();
       return false;
     }
@@ -97,20 +159,39 @@ bool Section::loadSectionFile(const int fontId, const float lineCompression, con
         viewportWidth != fileViewportWidth || viewportHeight != fileViewportHeight ||
         hyphenationEnabled != fileHyphenationEnabled || embeddedStyle != fileEmbeddedStyle) {
       file.close();
+      // Two layouts hashed to the same file name; the newer one takes the slot
       LOG_ERR("SCT", "Deserialization failed: Parameters do not match");
       clearCache();
       return false;
     }
   }
 
+  uint32_t lutOffset;
   serialization::readPod(file, pageCount);
+  serialization::readPod(file, lutOffset);
   file.close();
+  if (lutOffset == 0) {
+    // Left behind by a build that never finished (e.g. power loss while indexing in the background)
+    LOG_ERR("SCT", "Deserialization failed: Section was not fully indexed");
+    pageCount = 0;
+    clearCache();
+    return false;
+  }
   LOG_DBG("SCT", "Deserialization succeeded: %d pages", pageCount);
+  recordCacheUse(0);
   return true;
 }
 
-// Your updated class method (assuming you are using the 'SD' object, which is a wrapper for a specific filesystem)
-bool Section::clearCache() const {
+bool Section::clearCache() {
+  if (filePath.empty()) {
+    return true;
+  }
+  {
+    SectionCacheIndex& index = epub->getSectionCacheIndex();
+    index.forget(spineIndex, layoutHash);
+    index.commit();
+  }
+
   if (!Storage.exists(filePath.c_str())) {
     LOG_DBG("SCT", "Cache does not exist, no action needed");
     return true;
@@ -129,92 +210,94 @@ bool Section::createSectionFile(const int fontId, const float lineCompression, c
                                 const uint8_t paragraphAlignment, const uint16_t viewportWidth,
                                 const uint16_t viewportHeight, const bool hyphenationEnabled, const bool embeddedStyle,
                                 const std::function<void()>& popupFn) {
-  const auto localPath = epub->getSpineItem(spineIndex).href;
-  const auto tmpHtmlPath = epub->getCachePath() + "/.tmp_" + std::to_string(spineIndex) + ".html";
+  return beginSectionFile(fontId, lineCompression, extraParagraphSpacing, paragraphAlignment, viewportWidth,
+                          viewportHeight, hyphenationEnabled, embeddedStyle, popupFn) &&
+         continueSectionFile(INT_MAX);
+}
+
+bool Section::beginSectionFile(const int fontId, const float lineCompression, const bool extraParagraphSpacing,
+                               const uint8_t paragraphAlignment, const uint16_t viewportWidth,
+                               const uint16_t viewportHeight, const bool hyphenationEnabled, const bool embeddedStyle,
+                               const std::function<void()>& popupFn) {
+  if (builder) {
+    abortSectionFile();
+  }
+  itemHref = epub->getSpineItem(spineIndex).href;
+  selectVariant(fontId, lineCompression, extraParagraphSpacing, paragraphAlignment, viewportWidth, viewportHeight,
+                hyphenationEnabled, embeddedStyle);
 
-  // Create cache directory if it doesn't exist
+  // Create cache directories if they don't exist
   {
     const auto sectionsDir = epub->getCachePath() + "/sections";
     Storage.mkdir(sectionsDir.c_str());
+    const auto flowsDir = epub->getCachePath() + "/flows";
+    Storage.mkdir(flowsDir.c_str());
   }
 
-  // Retry logic for SD card timing issues
-  bool success = false;
-  uint32_t fileSize = 0;
-  for (int attempt = 0; attempt < 3 && !success; attempt++) {
-    if (attempt > 0) {
-      LOG_DBG("SCT", "Retrying stream (attempt %d)...", attempt + 1);
-      delay(50);  // Brief delay before retry
-    }
-
-    // Remove any incomplete file from previous attempt before retrying
-    if (Storage.exists(tmpHtmlPath.c_str())) {
-      Storage.remove(tmpHtmlPath.c_str());
-    }
-
-    FsFile tmpHtml;
-    if (!Storage.openFileForWrite("SCT", tmpHtmlPath, tmpHtml)) {
-      continue;
-    }
-    success = epub->readItemContentsToStream(localPath, tmpHtml, 1024);
-    fileSize = tmpHtml.size();
-    tmpHtml.close();
-
-    // If streaming failed, remove the incomplete file immediately
-    if (!success && Storage.exists(tmpHtmlPath.c_str())) {
-      Storage.remove(tmpHtmlPath.c_str());
-      LOG_DBG("SCT", "Removed incomplete temp file after failed attempt");
-    }
-  }
-
-  if (!success) {
-    LOG_ERR("SCT", "Failed to stream item contents to temp file after retries");
-    return false;
-  }
-
-  LOG_DBG("SCT", "Streamed temp HTML to %s (%d bytes)", tmpHtmlPath.c_str(), fileSize);
-
   if (!Storage.openFileForWrite("SCT", filePath, file)) {
     return false;
   }
+  pageCount = 0;
+  lut.clear();
   writeSectionFileHeader(fontId, lineCompression, extraParagraphSpacing, paragraphAlignment, viewportWidth,
                          viewportHeight, hyphenationEnabled, embeddedStyle);
-  std::vector<uint32_t> lut = {};
 
   // Derive the content base directory and image cache path prefix for the parser
-  size_t lastSlash = localPath.find_last_of('/');
-  std::string contentBase = (lastSlash != std::string::npos) ? localPath.substr(0, lastSlash + 1) : "";
+  size_t lastSlash = itemHref.find_last_of('/');
+  std::string contentBase = (lastSlash != std::string::npos) ? itemHref.substr(0, lastSlash + 1) : "";
   std::string imageBasePath = epub->getCachePath() + "/img_" + std::to_string(spineIndex) + "_";
 
-  CssParser* cssParser = nullptr;
-  if (embeddedStyle) {
-    cssParser = epub->getCssParser();
-    if (cssParser) {
-      if (!cssParser->loadFromCache()) {
-        LOG_ERR("SCT", "Failed to load CSS from cache");
-      }
+  // The chapter's flow only depends on embeddedStyle, so any earlier build with that setting left one to lay out from
+  std::string flowPath = epub->getCachePath() + "/flows/" + std::to_string(spineIndex) + ".bin";
+  const bool hasFlow = ChapterHtmlSlimParser::hasFlowFile(flowPath, embeddedStyle);
+
+  builderCssParser = nullptr;
+  if (embeddedStyle && !hasFlow) {
+    // Rules stay loaded between builds, only the first build of a book session reads them from the cache
+    builderCssParser = epub->getCssParser();
+    if (builderCssParser && !builderCssParser->retainRules()) {
+      LOG_ERR("SCT", "Failed to load CSS from cache");
+      // An unstyled flow would be replayed by every later build, keep the failure to this one
+      flowPath.clear();
     }
   }
 
-  ChapterHtmlSlimParser visitor(
-      epub, tmpHtmlPath, renderer, fontId, lineCompression, extraParagraphSpacing, paragraphAlignment, viewportWidth,
+  builder.reset(new ChapterHtmlSlimParser(
+      epub, itemHref, renderer, fontId, lineCompression, extraParagraphSpacing, paragraphAlignment, viewportWidth,
       viewportHeight, hyphenationEnabled,
-      [this, &lut](std::unique_ptr<Page> page) { lut.emplace_back(this->onPageComplete(std::move(page))); },
-      embeddedStyle, contentBase, imageBasePath, popupFn, cssParser);
+      [this](std::unique_ptr<Page> page) { lut.emplace_back(this->onPageComplete(std::move(page))); }, embeddedStyle,
+      contentBase, imageBasePath, popupFn, builderCssParser, flowPath));
   Hyphenator::setPreferredLanguage(epub->getLanguage());
-  success = visitor.parseAndBuildPages();
 
-  Storage.remove(tmpHtmlPath.c_str());
-  if (!success) {
-    LOG_ERR("SCT", "Failed to parse XML and build pages");
-    file.close();
-    Storage.remove(filePath.c_str());
-    if (cssParser) {
-      cssParser->clear();
-    }
+  if (!builder->beginParsing()) {
+    LOG_ERR("SCT", "Failed to start parsing XML");
+    abortSectionFile();
     return false;
   }
+  return true;
+}
+
+bool Section::continueSectionFile(const int targetPage) {
+  if (!builder) {
+    return true;
+  }
+
+  while (!builder->isParsingComplete() && pageCount <= targetPage) {
+    if (!builder->parseNextChunk()) {
+      LOG_ERR("SCT", "Failed to parse XML and build pages");
+      abortSectionFile();
+      return false;
+    }
+  }
+
+  if (!builder->isParsingComplete()) {
+    LOG_DBG("SCT", "Indexed up to page %d", pageCount);
+    return true;
+  }
+  return finishSectionFile();
+}
 
+bool Section::finishSectionFile() {
   const uint32_t lutOffset = file.position();
   bool hasFailedLutRecords = false;
   // Write LUT
@@ -228,8 +311,7 @@ bool Section::createSectionFile(const int fontId, const float lineCompression, c
 
   if (hasFailedLutRecords) {
     LOG_ERR("SCT", "Failed to write LUT due to invalid page positions");
-    file.close();
-    Storage.remove(filePath.c_str());
+    abortSectionFile();
     return false;
   }
 
@@ -237,16 +319,54 @@ bool Section::createSectionFile(const int fontId, const float lineCompression, c
   file.seek(HEADER_SIZE - sizeof(uint32_t) - sizeof(pageCount));
   serialization::writePod(file, pageCount);
   serialization::writePod(file, lutOffset);
+  const uint32_t fileSize = file.size();
   file.close();
-  if (cssParser) {
-    cssParser->clear();
+  recordCacheUse(fileSize);
+  builder.reset();
+  lut.clear();
+  lut.shrink_to_fit();
+  if (builderCssParser) {
+    builderCssParser->releaseRules();
+    builderCssParser = nullptr;
   }
   return true;
 }
 
-std::unique_ptr<Page> Section::loadPageFromSectionFile() {
+void Section::abortSectionFile() {
+  builder.reset();
+  lut.clear();
+  lut.shrink_to_fit();
+  if (file) {
+    file.close();
+  }
+  clearCache();
+  if (builderCssParser) {
+    builderCssParser->releaseRules();
+    builderCssParser = nullptr;
+  }
+}
+
+bool Section::loadPageFromSectionFile(PageView& page) {
+  if (builder) {
+    // Still indexing: the LUT is only in memory and `file` is the one being written, so flush what's been written so
+    // far and read the page through a second handle
+    if (currentPage < 0 || currentPage >= static_cast<int>(lut.size()) || lut[currentPage] == 0) {
+      LOG_ERR("SCT", "Page %d not indexed yet", currentPage);
+      return false;
+    }
+    file.flush();
+    FsFile pageFile;
+    if (!Storage.openFileForRead("SCT", filePath, pageFile)) {
+      return false;
+    }
+    pageFile.seek(lut[currentPage]);
+    const bool loaded = page.load(pageFile);
+    pageFile.close();
+    return loaded;
+  }
+
   if (!Storage.openFileForRead("SCT", filePath, file)) {
-    return nullptr;
+    return false;
   }
 
   file.seek(HEADER_SIZE - sizeof(uint32_t));
@@ -257,7 +377,7 @@ std::unique_ptr<Page> Section::loadPageFromSectionFile() {
   serialization::readPod(file, pagePos);
   file.seek(pagePos);
 
-  auto page = Page::deserialize(file);
+  const bool loaded = page.load(file);
   file.close();
-  return page;
+  return loaded;
 }
@@ -1,39 +1,64 @@
 #pragma once
 #include <functional>
 #include <memory>
+#include <vector>
 
 #include "Epub.h"
 
 class Page;
+class PageView;
 class GfxRenderer;
+class ChapterHtmlSlimParser;
+class CssParser;
 
 class Section {
   std::shared_ptr<Epub> epub;
   const int spineIndex;
   GfxRenderer& renderer;
+  // Section files are per layout (sections/<spine>.<layout hash>.bin), chosen by the load/begin call
+  uint32_t layoutHash = 0;
   std::string filePath;
   FsFile file;
 
+  // Progressive build state, live between beginSectionFile() and the end of the chapter
+  std::string itemHref;  // referenced by the parser
+  std::vector<uint32_t> lut;
+  std::unique_ptr<ChapterHtmlSlimParser> builder;
+  CssParser* builderCssParser = nullptr;
+
+  void selectVariant(int fontId, float lineCompression, bool extraParagraphSpacing, uint8_t paragraphAlignment,
+                     uint16_t viewportWidth, uint16_t viewportHeight, bool hyphenationEnabled, bool embeddedStyle);
+  void recordCacheUse(uint32_t size) const;
   void writeSectionFileHeader(int fontId, float lineCompression, bool extraParagraphSpacing, uint8_t paragraphAlignment,
                               uint16_t viewportWidth, uint16_t viewportHeight, bool hyphenationEnabled,
                               bool embeddedStyle);
   uint32_t onPageComplete(std::unique_ptr<Page> page);
+  bool finishSectionFile();
+  void abortSectionFile();
 
  public:
   uint16_t pageCount = 0;
   int currentPage = 0;
 
-  explicit Section(const std::shared_ptr<Epub>& epub, const int spineIndex, GfxRenderer& renderer)
-      : epub(epub),
-        spineIndex(spineIndex),
-        renderer(renderer),
-        filePath(epub->getCachePath() + "/sections/" + std::to_string(spineIndex) + ".bin") {}
-  ~Section() = default;
+  explicit Section(const std::shared_ptr<Epub>& epub, int spineIndex, GfxRenderer& renderer);
+  ~Section();
   bool loadSectionFile(int fontId, float lineCompression, bool extraParagraphSpacing, uint8_t paragraphAlignment,
                        uint16_t viewportWidth, uint16_t viewportHeight, bool hyphenationEnabled, bool embeddedStyle);
-  bool clearCache() const;
+  bool clearCache();
   bool createSectionFile(int fontId, float lineCompression, bool extraParagraphSpacing, uint8_t paragraphAlignment,
                          uint16_t viewportWidth, uint16_t viewportHeight, bool hyphenationEnabled, bool embeddedStyle,
                          const std::function<void()>& popupFn = nullptr);
-  std::unique_ptr<Page> loadPageFromSectionFile();
+  // Progressive form of createSectionFile(): beginSectionFile() writes the header and starts parsing, then
+  // continueSectionFile() indexes until page `targetPage` exists or the chapter ends, so the page being opened can
+  // be shown while the rest of the chapter is still being laid out. The file is only finalized (LUT and page count
+  // written) once the whole chapter is indexed; until then pageCount is provisional and isIndexing() is true. Both
+  // return false on failure, after which the partial file is gone.
+  bool beginSectionFile(int fontId, float lineCompression, bool extraParagraphSpacing, uint8_t paragraphAlignment,
+                        uint16_t viewportWidth, uint16_t viewportHeight, bool hyphenationEnabled, bool embeddedStyle,
+                        const std::function<void()>& popupFn = nullptr);
+  bool continueSectionFile(int targetPage);
+  bool isIndexing() const { return builder != nullptr; }
+  int getSpineIndex() const { return spineIndex; }
+  // Loads the current page into `page`, reusing its buffers
+  bool loadPageFromSectionFile(PageView& page);
 };
@@ -0,0 +1,182 @@
+#include "SectionCacheIndex.h"
+
+#include <HalStorage.h>
+#include <Logging.h>
+#include <Serialization.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+constexpr uint8_t SECTION_INDEX_VERSION = 2;
+constexpr char indexFile[] = "/sections/variants.bin";
+// u8 version | u32 clock | u16 count, then per entry u16 spineIndex | u32 layoutHash | u32 size | u32 lastUsed
+constexpr size_t INDEX_HEADER_SIZE = sizeof(uint8_t) + sizeof(uint32_t) + sizeof(uint16_t);
+constexpr size_t INDEX_ENTRY_SIZE = sizeof(uint16_t) + 3 * sizeof(uint32_t);
+// Version 1 wrote entries as raw structs, with two padding bytes after spineIndex
+constexpr uint8_t SECTION_INDEX_VERSION_PADDED = 1;
+constexpr size_t INDEX_ENTRY_PADDING_V1 = 2;
+}  // namespace
+
+std::string SectionCacheIndex::getSectionFilePath(const std::string& cachePath, const int spineIndex,
+                                                  const uint32_t layoutHash) {
+  char name[32];
+  snprintf(name, sizeof(name), "/sections/%d.%08lx.bin", spineIndex, static_cast<unsigned long>(layoutHash));
+  return cachePath + name;
+}
+
+SectionCacheIndex::Entry* SectionCacheIndex::find(const int spineIndex, const uint32_t layoutHash) {
+  for (auto& entry : entries) {
+    if (entry.spineIndex == spineIndex && entry.layoutHash == layoutHash) {
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+
+bool SectionCacheIndex::load() {
+  entries.clear();
+  clock = 0;
+
+  const std::string path = cachePath + indexFile;
+  FsFile file;
+  if (!Storage.exists(path.c_str())) {
+    removeLegacySectionFiles();
+    return false;
+  }
+  if (!Storage.openFileForRead("SCI", path, file)) {
+    return false;
+  }
+
+  uint8_t version;
+  uint16_t count;
+  serialization::readPod(file, version);
+  if (version != SECTION_INDEX_VERSION && version != SECTION_INDEX_VERSION_PADDED) {
+    LOG_DBG("SCI", "Index version mismatch (got %u, expected %u)", version, SECTION_INDEX_VERSION);
+    file.close();
+    return false;
+  }
+  serialization::readPod(file, clock);
+  serialization::readPod(file, count);
+  const size_t padding = version == SECTION_INDEX_VERSION_PADDED ? INDEX_ENTRY_PADDING_V1 : 0;
+  if (file.size() < INDEX_HEADER_SIZE + (INDEX_ENTRY_SIZE + padding) * count) {
+    LOG_ERR("SCI", "Index truncated");
+    clock = 0;
+    file.close();
+    return false;
+  }
+  entries.resize(count);
+  for (auto& entry : entries) {
+    serialization::readPod(file, entry.spineIndex);
+    if (padding > 0) {
+      file.seekCur(padding);
+    }
+    serialization::readPod(file, entry.layoutHash);
+    serialization::readPod(file, entry.size);
+    serialization::readPod(file, entry.lastUsed);
+  }
+  file.close();
+  return true;
+}
+
+bool SectionCacheIndex::save() {
+  FsFile file;
+  if (!Storage.openFileForWrite("SCI", cachePath + indexFile, file)) {
+    return false;
+  }
+  serialization::writePod(file, SECTION_INDEX_VERSION);
+  serialization::writePod(file, clock);
+  serialization::writePod(file, static_cast<uint16_t>(entries.size()));
+  for (const auto& entry : entries) {
+    serialization::writePod(file, entry.spineIndex);
+    serialization::writePod(file, entry.layoutHash);
+    serialization::writePod(file, entry.size);
+    serialization::writePod(file, entry.lastUsed);
+  }
+  file.close();
+  dirty = false;
+  return true;
+}
+
+// Before layout variants, section files were named sections/<spine>.bin. Nothing reads those any more, so they are
+// deleted the first time a book is opened without a variants index.
+void SectionCacheIndex::removeLegacySectionFiles() const {
+  const std::string dirPath = cachePath + "/sections";
+  auto dir = Storage.open(dirPath.c_str());
+  if (!dir || !dir.isDirectory()) {
+    if (dir) dir.close();
+    return;
+  }
+
+  // Collect first, removing entries while iterating the directory would skip some
+  std::vector<std::string> legacy;
+  char name[64];
+  for (auto file = dir.openNextFile(); file; file = dir.openNextFile()) {
+    file.getName(name, sizeof(name));
+    const bool isDirectory = file.isDirectory();
+    file.close();
+    const size_t digits = strspn(name, "0123456789");
+    if (!isDirectory && digits > 0 && strcmp(name + digits, ".bin") == 0) {
+      legacy.emplace_back(name);
+    }
+  }
+  dir.close();
+
+  for (const auto& name : legacy) {
+    Storage.remove((dirPath + "/" + name).c_str());
+  }
+  if (!legacy.empty()) {
+    LOG_DBG("SCI", "Removed %d legacy section files", static_cast<int>(legacy.size()));
+  }
+}
+
+void SectionCacheIndex::touch(const int spineIndex, const uint32_t layoutHash, const uint32_t size) {
+  Entry* entry = find(spineIndex, layoutHash);
+  if (!entry) {
+    entries.push_back({static_cast<uint16_t>(spineIndex), layoutHash, 0, 0});
+    entry = &entries.back();
+  }
+  if (size > 0) {
+    entry->size = size;
+  }
+  entry->lastUsed = ++clock;
+  dirty = true;
+}
+
+void SectionCacheIndex::forget(const int spineIndex, const uint32_t layoutHash) {
+  entries.erase(std::remove_if(entries.begin(), entries.end(),
+                               [spineIndex, layoutHash](const Entry& entry) {
+                                 return entry.spineIndex == spineIndex && entry.layoutHash == layoutHash;
+                               }),
+                entries.end());
+  dirty = true;
+}
+
+uint32_t SectionCacheIndex::getTotalSize() const {
+  uint32_t total = 0;
+  for (const auto& entry : entries) {
+    total += entry.size;
+  }
+  return total;
+}
+
+void SectionCacheIndex::evictToBudget(const uint32_t budget) {
+  uint32_t total = getTotalSize();
+  if (total <= budget) {
+    return;
+  }
+
+  // Oldest first, keeping the most recent entry (the section being read) whatever its size
+  std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.lastUsed < b.lastUsed; });
+  size_t evicted = 0;
+  while (total > budget && evicted + 1 < entries.size()) {
+    const Entry& entry = entries[evicted++];
+    Storage.remove(getSectionFilePath(cachePath, entry.spineIndex, entry.layoutHash).c_str());
+    total -= entry.size;
+  }
+  LOG_DBG("SCI", "Evicted %d section files, %lu bytes left", static_cast<int>(evicted),
+          static_cast<unsigned long>(total));
+  entries.erase(entries.begin(), entries.begin() + evicted);
+  dirty = true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Tracks the section files of one book (sections/variants.bin). Section files are keyed by spine index and a hash of
+// their layout parameters, so several layouts of a chapter can coexist; this records their sizes and the order they
+// were last opened in, and drops the least recently opened ones once the book goes over its budget. One instance
+// lives for the book session (Epub::getSectionCacheIndex) so opening a section only updates it in memory.
+class SectionCacheIndex {
+  struct Entry {
+    uint16_t spineIndex;
+    uint32_t layoutHash;
+    uint32_t size;
+    uint32_t lastUsed;
+  };
+
+  std::string cachePath;
+  std::vector<Entry> entries;
+  uint32_t clock = 0;
+  bool dirty = false;
+
+  Entry* find(int spineIndex, uint32_t layoutHash);
+  bool load();
+  bool save();
+  void removeLegacySectionFiles() const;
+
+ public:
+  // Section bytes kept per book before older variants are evicted
+  static constexpr uint32_t DEFAULT_BOOK_BUDGET = 16 * 1024 * 1024;
+
+  explicit SectionCacheIndex(std::string cachePath) : cachePath(std::move(cachePath)) { load(); }
+
+  static std::string getSectionFilePath(const std::string& cachePath, int spineIndex, uint32_t layoutHash);
+
+  // Marks a variant as the most recently used one. `size` of 0 keeps the recorded size.
+  void touch(int spineIndex, uint32_t layoutHash, uint32_t size = 0);
+  void forget(int spineIndex, uint32_t layoutHash);
+  // Deletes least recently used section files (never the most recent one) until the total fits `budget`
+  void evictToBudget(uint32_t budget = DEFAULT_BOOK_BUDGET);
+  uint32_t getTotalSize() const;
+  // Writes the index if anything changed since it was loaded or last committed
+  bool commit() { return !dirty || save(); }
+};
@@ -0,0 +1,8 @@
+#include "WordWidthCache.h"
+
+WordWidthCache::Key WordWidthCache::keyOf(const int fontId, const EpdFontFamily::Style style, const char* word,
+                                          const size_t length) {
+  Key key;
+  key.add(&fontId, sizeof(fontId)).addByte(style).add(word, length);
+  return key;
+}
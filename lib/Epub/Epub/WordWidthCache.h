@@ -0,0 +1,16 @@
+#pragma once
+
+#include <EpdFontFamily.h>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "HashedCache.h"
+
+// Cache of measured word widths, kept by the chapter parser for the whole section build. Most of a chapter's words are
+// repeats ("the", "and", ...), and measuring one decodes its UTF-8 and looks up every glyph. 4-way sets hold about
+// as many hits as a direct mapped table twice the size.
+class WordWidthCache : public HashedCache<uint16_t, 64, 4> {  // 4KB
+ public:
+  static Key keyOf(int fontId, EpdFontFamily::Style style, const char* word, size_t length);
+};
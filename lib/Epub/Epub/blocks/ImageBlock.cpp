@@ -3,8 +3,8 @@
 #include <GfxRenderer.h>
 #include <Logging.h>
 #include <SDCardManager.h>
-#include <Serialization.h>
 
+#include "../PageCodec.h"
 #include "../converters/DitherUtils.h"
 #include "../converters/ImageDecoderFactory.h"
 
@@ -157,18 +157,9 @@ void ImageBlock::render(GfxRenderer& renderer, const int x, const int y) {
   LOG_DBG("IMG", "Decode successful");
 }
 
-bool ImageBlock::serialize(FsFile& file) {
-  serialization::writeString(file, imagePath);
-  serialization::writePod(file, width);
-  serialization::writePod(file, height);
+bool ImageBlock::serialize(PageWriter& writer) const {
+  writer.writeString(imagePath);
+  writer.writeVarInt(width);
+  writer.writeVarInt(height);
   return true;
 }
-
-std::unique_ptr<ImageBlock> ImageBlock::deserialize(FsFile& file) {
-  std::string path;
-  serialization::readString(file, path);
-  int16_t w, h;
-  serialization::readPod(file, w);
-  serialization::readPod(file, h);
-  return std::unique_ptr<ImageBlock>(new ImageBlock(path, w, h));
-}
@@ -9,6 +9,8 @@
 #include "Block.h"
 #include "BlockStyle.h"
 
+class PageWriter;
+
 // Represents a line of text on a page
 class TextBlock final : public Block {
  private:
@@ -28,9 +30,9 @@ class TextBlock final : public Block {
   void setBlockStyle(const BlockStyle& blockStyle) { this->blockStyle = blockStyle; }
   const BlockStyle& getBlockStyle() const { return blockStyle; }
   bool isEmpty() override { return words.empty(); }
-  // given a renderer works out where to break the words into lines
-  void render(const GfxRenderer& renderer, int fontId, int x, int y) const;
+  // Draws one word at (x, y), underlined if the style asks for it
+  static void renderWord(const GfxRenderer& renderer, int fontId, int x, int y, const char* word,
+                         EpdFontFamily::Style style);
   BlockType getType() override { return TEXT_BLOCK; }
-  bool serialize(FsFile& file) const;
-  static std::unique_ptr<TextBlock> deserialize(FsFile& file);
+  bool serialize(PageWriter& writer) const;
 };
@@ -0,0 +1,39 @@
+#include "CssElementStack.h"
+
+#include <algorithm>
+
+#include "CssParser.h"
+
+bool CssElementStack::Element::matches(const uint32_t tag, const uint32_t cls) const {
+  if (tag != 0 && tag != tagHash) {
+    return false;
+  }
+  if (cls == 0) {
+    return true;
+  }
+  for (uint8_t i = 0; i < classCount; i++) {
+    if (classHashes[i] == cls) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void CssElementStack::enter(const size_t depth, const std::string_view tagName, const std::string_view classAttr) {
+  current = depth;
+  if (depth >= MAX_DEPTH) {
+    return;
+  }
+
+  Element& element = elements[depth];
+  element.tagHash = CssParser::nameHash(tagName);
+  element.classCount = 0;
+  size_t start = 0;
+  while (start < classAttr.size() && element.classCount < MAX_CLASSES) {
+    const size_t end = std::min(classAttr.find_first_of(" \t\n\r\f", start), classAttr.size());
+    if (end > start) {
+      element.classHashes[element.classCount++] = CssParser::nameHash(classAttr.substr(start, end - start));
+    }
+    start = end + 1;
+  }
+}
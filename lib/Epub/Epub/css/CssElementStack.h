@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Tag and class hashes of the elements enclosing the one being styled, kept by the chapter parser while it walks the
+// document so CssParser can match descendant and child selectors. Entries are indexed by element depth; entering an
+// element replaces whatever was recorded at its depth, so entries below it are always its ancestors.
+class CssElementStack {
+ public:
+  static constexpr size_t MAX_DEPTH = 32;
+  static constexpr size_t MAX_CLASSES = 4;  // Further classes of an element are not matched
+
+  struct Element {
+    uint32_t tagHash;
+    uint32_t classHashes[MAX_CLASSES];
+    uint8_t classCount;
+
+    // A zero hash matches anything
+    bool matches(uint32_t tag, uint32_t cls) const;
+  };
+
+  // Records the element starting at `depth` (0 = document root) as the one being styled
+  void enter(size_t depth, std::string_view tagName, std::string_view classAttr);
+
+  // Ancestors of the element last entered, outermost first. Unknown if it is nested deeper than MAX_DEPTH.
+  bool complete() const { return current <= MAX_DEPTH; }
+  size_t ancestorCount() const { return current; }
+  const Element& operator[](const size_t index) const { return elements[index]; }
+
+ private:
+  Element elements[MAX_DEPTH] = {};
+  size_t current = 0;
+};
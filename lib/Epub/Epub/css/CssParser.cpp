@@ -1,11 +1,14 @@
 #include "CssParser.h"
 
 #include <Arduino.h>
+#include <Fnv1a.h>
 #include <Logging.h>
+#include <ZipFile.h>
 
 #include <algorithm>
 #include <array>
 #include <cctype>
+#include <cstring>
 #include <string_view>
 
 namespace {
@@ -41,10 +44,14 @@ constexpr size_t READ_BUFFER_SIZE = 512;
 // Prevents unbounded memory growth from pathological CSS files
 constexpr size_t MAX_RULES = 1500;
 
-// Minimum free heap required to apply CSS during rendering
-// If below this threshold, we skip CSS to avoid display artifacts.
+// Minimum free heap to leave after loading the CSS rules into memory
+// Below it, rules are looked up in the cache file on the card instead.
 constexpr size_t MIN_FREE_HEAP_FOR_CSS = 48 * 1024;
 
+// Maximum number of descendant/child selectors; each is checked against the ancestors of every element it may apply
+// to, and all of them stay in memory
+constexpr size_t MAX_ANCESTOR_SELECTORS = 128;
+
 // Maximum length for a single selector string
 // Prevents parsing of extremely long or malformed selectors
 constexpr size_t MAX_SELECTOR_LENGTH = 256;
@@ -52,6 +59,32 @@ constexpr size_t MAX_SELECTOR_LENGTH = 256;
 // Check if character is CSS whitespace
 bool isCssWhitespace(const char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f'; }
 
+// Cache file layout (see saveToCache): header, then fixed size style records, key entries and ancestor selectors
+constexpr size_t CACHE_HEADER_SIZE = 1 + 3 * sizeof(uint16_t);
+constexpr size_t STYLE_RECORD_SIZE = 4 + 9 * (sizeof(float) + 1) + sizeof(uint16_t);
+constexpr size_t KEY_ENTRY_SIZE = sizeof(uint32_t) + sizeof(uint16_t);
+constexpr size_t ANCESTOR_RECORD_SIZE = sizeof(uint32_t) + 3 * sizeof(uint16_t) + 2 + 4 * 2 * sizeof(uint32_t);
+
+// FNV-1a over a lowercased selector, continuing from `hash` so that keys like "p.note" can be hashed piece by piece
+uint32_t hashSelector(uint32_t hash, const std::string_view part) {
+  for (const char c : part) {
+    hash = fnv1aByte(hash, static_cast<uint8_t>(std::tolower(static_cast<unsigned char>(c))));
+  }
+  return hash;
+}
+
+// Whether a selector part is a tag, .class or tag.class made of name characters only
+bool isSimpleCompound(const std::string_view compound) {
+  const size_t dot = compound.find('.');
+  if (compound.empty() || dot == compound.size() - 1 ||
+      (dot != std::string_view::npos && compound.find('.', dot + 1) != std::string_view::npos)) {
+    return false;
+  }
+  return std::all_of(compound.begin(), compound.end(), [](const char c) {
+    return c == '.' || c == '-' || c == '_' || std::isalnum(static_cast<unsigned char>(c));
+  });
+}
+
 }  // anonymous namespace
 
 // String utilities implementation
@@ -298,7 +331,7 @@ void CssParser::parseDeclarationIntoStyle(const std::string& decl, CssStyle& sty
   }
 }
 
-CssStyle CssParser::parseDeclarations(const std::string& declBlock) {
+CssStyle CssParser::parseDeclarations(const std::string_view declBlock) {
   CssStyle style;
   std::string propNameBuf;
   std::string propValueBuf;
@@ -308,7 +341,7 @@ CssStyle CssParser::parseDeclarations(const std::string& declBlock) {
     if (i == declBlock.size() || declBlock[i] == ';') {
       if (i > start) {
         const size_t len = i - start;
-        std::string decl = declBlock.substr(start, len);
+        std::string decl(declBlock.substr(start, len));
         if (!decl.empty()) {
           parseDeclarationIntoStyle(decl, style, propNameBuf, propValueBuf);
         }
@@ -339,9 +372,14 @@ void CssParser::processRuleBlockWithStyle(const std::string& selectorGroup, cons
       continue;
     }
 
-    // Normalize the selector
-    std::string key = normalized(sel);
-    if (key.empty()) continue;
+    // Normalize the selector; rules are keyed by its hash
+    const std::string normalizedSelector = normalized(sel);
+    if (normalizedSelector.empty()) continue;
+    if (normalizedSelector.find_first_of(" >+~") != std::string::npos) {
+      addAncestorSelector(normalizedSelector, style);
+      continue;
+    }
+    const uint32_t key = hashSelector(FNV1A_32_BASIS, normalizedSelector);
 
     // Skip if this would exceed the rule limit
     if (rulesBySelector_.size() >= MAX_RULES) {
@@ -359,11 +397,90 @@ void CssParser::processRuleBlockWithStyle(const std::string& selectorGroup, cons
   }
 }
 
+uint32_t CssParser::nameHash(const std::string_view name) { return hashSelector(FNV1A_32_BASIS, name); }
+
+bool CssParser::compileAncestorSelector(const std::string_view selector, AncestorSelector& compiled) {
+  // Split into compounds, noting which ones follow a child combinator
+  std::string_view compounds[MAX_ANCESTOR_COMPOUNDS + 1];
+  bool afterChild[MAX_ANCESTOR_COMPOUNDS + 1] = {};
+  size_t count = 0;
+  bool pendingChild = false;
+  size_t pos = 0;
+  while (pos < selector.size()) {
+    if (selector[pos] == ' ') {
+      pos++;
+      continue;
+    }
+    if (selector[pos] == '>') {
+      if (count == 0 || pendingChild) return false;
+      pendingChild = true;
+      pos++;
+      continue;
+    }
+    const size_t end = std::min(selector.find_first_of(" >", pos), selector.size());
+    const std::string_view compound = selector.substr(pos, end - pos);
+    if (count == MAX_ANCESTOR_COMPOUNDS + 1 || !isSimpleCompound(compound)) return false;
+    compounds[count] = compound;
+    afterChild[count] = pendingChild;
+    count++;
+    pendingChild = false;
+    pos = end;
+  }
+  if (count < 2 || pendingChild) return false;
+
+  compiled = {};
+  compiled.keyHash = hashSelector(FNV1A_32_BASIS, compounds[count - 1]);
+  compiled.ancestorCount = static_cast<uint8_t>(count - 1);
+  for (size_t i = 0; i < count; i++) {
+    const std::string_view compound = compounds[count - 1 - i];
+    const size_t dot = compound.find('.');
+    const std::string_view tag = compound.substr(0, dot);
+    compiled.specificity += (tag.empty() ? 0 : 1) + (dot == std::string_view::npos ? 0 : 256);
+    if (i == 0) continue;
+
+    auto& ancestor = compiled.ancestors[i - 1];
+    ancestor.tagHash = tag.empty() ? 0 : nameHash(tag);
+    ancestor.classHash = dot == std::string_view::npos ? 0 : nameHash(compound.substr(dot + 1));
+    if (afterChild[count - i]) {
+      compiled.childMask |= 1 << (i - 1);
+    }
+  }
+  return true;
+}
+
+void CssParser::addAncestorSelector(const std::string& selector, const CssStyle& style) {
+  AncestorSelector compiled;
+  if (!compileAncestorSelector(selector, compiled)) {
+    LOG_DBG("CSS", "Unsupported selector, skipping: %s", selector.c_str());
+    return;
+  }
+
+  // Store or merge with an identical selector
+  for (auto& existing : ancestorSelectors_) {
+    if (existing.keyHash == compiled.keyHash && existing.ancestorCount == compiled.ancestorCount &&
+        existing.childMask == compiled.childMask &&
+        std::equal(existing.ancestors, existing.ancestors + existing.ancestorCount, compiled.ancestors,
+                   [](const auto& a, const auto& b) { return a.tagHash == b.tagHash && a.classHash == b.classHash; })) {
+      ancestorStyles_[existing.styleIndex].applyOver(style);
+      return;
+    }
+  }
+
+  if (ancestorSelectors_.size() >= MAX_ANCESTOR_SELECTORS) {
+    LOG_DBG("CSS", "Reached max descendant selectors limit (%zu), skipping", MAX_ANCESTOR_SELECTORS);
+    return;
+  }
+  compiled.styleIndex = static_cast<uint16_t>(ancestorStyles_.size());
+  compiled.order = static_cast<uint16_t>(ancestorSelectors_.size());
+  ancestorSelectors_.push_back(compiled);
+  ancestorStyles_.push_back(style);
+}
+
 // Main parsing entry point
 
-bool CssParser::loadFromStream(FsFile& source) {
-  if (!source) {
-    LOG_ERR("CSS", "Cannot read from invalid file");
+bool CssParser::loadFromStream(ZipEntryReader& source) {
+  if (!source.isOpen()) {
+    LOG_ERR("CSS", "Cannot read from closed entry");
     return false;
   }
 
@@ -460,7 +577,7 @@ bool CssParser::loadFromStream(FsFile& source) {
 
   char buffer[READ_BUFFER_SIZE];
   while (source.available()) {
-    int bytesRead = source.read(buffer, sizeof(buffer));
+    const int bytesRead = source.read(buffer, sizeof(buffer));
     if (bytesRead <= 0) break;
 
     totalRead += static_cast<size_t>(bytesRead);
@@ -503,136 +620,437 @@ bool CssParser::loadFromStream(FsFile& source) {
     handleChar('/');
   }
 
-  LOG_DBG("CSS", "Parsed %zu rules from %zu bytes", rulesBySelector_.size(), totalRead);
+  LOG_DBG("CSS", "Parsed %zu rules (%zu descendant/child) from %zu bytes", ruleCount(), ancestorSelectors_.size(),
+          totalRead);
   return true;
 }
 
 // Style resolution
 
-CssStyle CssParser::resolveStyle(const std::string& tagName, const std::string& classAttr) const {
-  static bool lowHeapWarningLogged = false;
-  if (ESP.getFreeHeap() < MIN_FREE_HEAP_FOR_CSS) {
-    if (!lowHeapWarningLogged) {
-      lowHeapWarningLogged = true;
-      LOG_DBG("CSS", "Warning: low heap (%u bytes) below MIN_FREE_HEAP_FOR_CSS (%u), returning empty style",
-              ESP.getFreeHeap(), static_cast<unsigned>(MIN_FREE_HEAP_FOR_CSS));
-    }
-    return CssStyle{};
+bool CssParser::findRule(const uint32_t selectorHash, CssStyle& style) const {
+  if (cacheFile_) {
+    return findRuleOnCard(selectorHash, style);
   }
-  CssStyle result;
-  const std::string tag = normalized(tagName);
 
-  // 1. Apply element-level style (lowest priority)
-  const auto tagIt = rulesBySelector_.find(tag);
-  if (tagIt != rulesBySelector_.end()) {
-    result.applyOver(tagIt->second);
+  const auto it = std::lower_bound(selectorHashes_.begin(), selectorHashes_.end(), selectorHash);
+  if (it == selectorHashes_.end() || *it != selectorHash) {
+    return false;
   }
+  style = styles_[styleIndexes_[it - selectorHashes_.begin()]];
+  return true;
+}
 
-  // 2. Apply class styles (medium priority)
-  if (!classAttr.empty()) {
-    const auto classes = splitWhitespace(classAttr);
+bool CssParser::findRuleOnCard(const uint32_t selectorHash, CssStyle& style) const {
+  // Same binary search as over the loaded keys, one key entry read per probe
+  const size_t keysOffset = CACHE_HEADER_SIZE + cardStyleCount_ * STYLE_RECORD_SIZE;
+  uint8_t entry[KEY_ENTRY_SIZE];
+  size_t low = 0;
+  size_t high = cardRuleCount_;
+  while (low < high) {
+    const size_t mid = low + (high - low) / 2;
+    if (!cacheFile_.seek(keysOffset + mid * KEY_ENTRY_SIZE) ||
+        cacheFile_.read(entry, KEY_ENTRY_SIZE) != KEY_ENTRY_SIZE) {
+      return false;
+    }
+    uint32_t hash;
+    memcpy(&hash, entry, sizeof(hash));
+    if (hash == selectorHash) {
+      uint16_t styleIndex;
+      memcpy(&styleIndex, entry + sizeof(hash), sizeof(styleIndex));
+      return styleAt(styleIndex, style);
+    }
+    if (hash < selectorHash) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return false;
+}
 
-    for (const auto& cls : classes) {
-      std::string classKey = "." + normalized(cls);
+bool CssParser::styleAt(const uint16_t index, CssStyle& style) const {
+  if (!cacheFile_) {
+    style = styles_[index];
+    return true;
+  }
+  uint8_t record[STYLE_RECORD_SIZE];
+  if (index >= cardStyleCount_ || !cacheFile_.seek(CACHE_HEADER_SIZE + index * STYLE_RECORD_SIZE) ||
+      cacheFile_.read(record, STYLE_RECORD_SIZE) != STYLE_RECORD_SIZE) {
+    return false;
+  }
+  style = decodeStyleRecord(record);
+  return true;
+}
 
-      auto classIt = rulesBySelector_.find(classKey);
-      if (classIt != rulesBySelector_.end()) {
-        result.applyOver(classIt->second);
+CssParser::AncestorMatch CssParser::matchAncestors(const AncestorSelector& selector, const size_t index,
+                                                   const CssElementStack& ancestors, const size_t count) {
+  // Requirements from `index` on, against ancestors [0, count) with the nearest last. A descendant requirement takes
+  // the nearest matching ancestor and only moves further out when a child requirement after it fails there; if a
+  // later descendant requirement finds no ancestor at all, further out has even fewer, so nothing is retried.
+  if (index == selector.ancestorCount) {
+    return AncestorMatch::Matched;
+  }
+  const auto& required = selector.ancestors[index];
+  if (selector.childMask & 1 << index) {
+    if (count == 0) {
+      return AncestorMatch::FailsCompletely;
+    }
+    if (!ancestors[count - 1].matches(required.tagHash, required.classHash)) {
+      return AncestorMatch::FailsLocally;
+    }
+    return matchAncestors(selector, index + 1, ancestors, count - 1);
+  }
+  for (size_t i = count; i-- > 0;) {
+    if (ancestors[i].matches(required.tagHash, required.classHash)) {
+      const AncestorMatch result = matchAncestors(selector, index + 1, ancestors, i);
+      if (result != AncestorMatch::FailsLocally) {
+        return result;
       }
     }
+  }
+  return AncestorMatch::FailsCompletely;
+}
+
+CssStyle CssParser::resolveStyle(const std::string_view tagName, const std::string_view classAttr) const {
+  bool ancestorDependent = false;
+  return resolve(tagName, classAttr, nullptr, ancestorDependent);
+}
 
-    // 3. Apply element.class styles (higher priority)
-    for (const auto& cls : classes) {
-      std::string combinedKey = tag + "." + normalized(cls);
+CssStyle CssParser::resolveStyle(const std::string_view tagName, const std::string_view classAttr,
+                                 const CssElementStack& ancestors, bool& ancestorDependent) const {
+  return resolve(tagName, classAttr, &ancestors, ancestorDependent);
+}
 
-      auto combinedIt = rulesBySelector_.find(combinedKey);
-      if (combinedIt != rulesBySelector_.end()) {
-        result.applyOver(combinedIt->second);
+CssStyle CssParser::resolve(const std::string_view tagName, const std::string_view classAttr,
+                            const CssElementStack* ancestors, bool& ancestorDependent) const {
+  CssStyle result;
+  CssStyle rule;
+  const uint32_t tagHash = hashSelector(FNV1A_32_BASIS, tagName);
+
+  // Visits each class of the attribute, hashed the way its selector was when the rules were parsed
+  const auto forEachClass = [&classAttr](const uint32_t prefixHash, const auto& visit) {
+    size_t start = 0;
+    while (start < classAttr.size()) {
+      while (start < classAttr.size() && isCssWhitespace(classAttr[start])) start++;
+      size_t end = start;
+      while (end < classAttr.size() && !isCssWhitespace(classAttr[end])) end++;
+      if (end > start) {
+        visit(hashSelector(prefixHash, classAttr.substr(start, end - start)));
+      }
+      start = end;
+    }
+  };
+  const uint32_t classPrefixHash = hashSelector(FNV1A_32_BASIS, ".");
+  const uint32_t tagClassPrefixHash = hashSelector(tagHash, ".");
+
+  // Descendant/child selectors ending in this element whose ancestors match, in the order they apply
+  constexpr size_t MAX_MATCHED = 16;
+  const AncestorSelector* matched[MAX_MATCHED];
+  size_t matchedCount = 0;
+  if (!ancestorSelectors_.empty()) {
+    const auto collect = [&](const uint32_t keyHash) {
+      const auto keyLess = [](const AncestorSelector& selector, const uint32_t key) { return selector.keyHash < key; };
+      auto it = std::lower_bound(ancestorSelectors_.begin(), ancestorSelectors_.end(), keyHash, keyLess);
+      for (; it != ancestorSelectors_.end() && it->keyHash == keyHash; ++it) {
+        ancestorDependent = true;
+        if (ancestors && ancestors->complete() && matchedCount < MAX_MATCHED &&
+            matchAncestors(*it, 0, *ancestors, ancestors->ancestorCount()) == AncestorMatch::Matched) {
+          matched[matchedCount++] = &*it;
+        }
+      }
+    };
+    collect(tagHash);
+    forEachClass(classPrefixHash, collect);
+    forEachClass(tagClassPrefixHash, collect);
+    std::sort(matched, matched + matchedCount, [](const AncestorSelector* a, const AncestorSelector* b) {
+      return a->specificity != b->specificity ? a->specificity < b->specificity : a->order < b->order;
+    });
+  }
+  size_t nextMatched = 0;
+  const auto applyMatchedBelow = [&](const uint16_t specificity) {
+    for (; nextMatched < matchedCount && matched[nextMatched]->specificity < specificity; nextMatched++) {
+      if (styleAt(matched[nextMatched]->styleIndex, rule)) {
+        result.applyOver(rule);
       }
     }
+  };
+
+  // 1. Apply element-level style (lowest priority)
+  if (findRule(tagHash, rule)) {
+    result.applyOver(rule);
   }
+  applyMatchedBelow(256);
+
+  // 2. Apply class styles (medium priority)
+  forEachClass(classPrefixHash, [&](const uint32_t hash) {
+    if (findRule(hash, rule)) {
+      result.applyOver(rule);
+    }
+  });
+
+  // 3. Apply element.class styles (higher priority)
+  forEachClass(tagClassPrefixHash, [&](const uint32_t hash) {
+    if (findRule(hash, rule)) {
+      result.applyOver(rule);
+    }
+  });
+  applyMatchedBelow(UINT16_MAX);
 
   return result;
 }
 
 // Inline style parsing (static - doesn't need rule database)
 
-CssStyle CssParser::parseInlineStyle(const std::string& styleValue) { return parseDeclarations(styleValue); }
+CssStyle CssParser::parseInlineStyle(const std::string_view styleValue) { return parseDeclarations(styleValue); }
 
 // Cache serialization
 
-// Cache format version - increment when format changes
-constexpr uint8_t CSS_CACHE_VERSION = 2;
 constexpr char rulesCache[] = "/css_rules.cache";
 
-bool CssParser::hasCache() const { return Storage.exists((cachePath + rulesCache).c_str()); }
+void CssParser::encodeStyleRecord(const CssStyle& style, uint8_t* record) {
+  uint8_t* out = record;
+  *out++ = static_cast<uint8_t>(style.textAlign);
+  *out++ = static_cast<uint8_t>(style.fontStyle);
+  *out++ = static_cast<uint8_t>(style.fontWeight);
+  *out++ = static_cast<uint8_t>(style.textDecoration);
+
+  for (const CssLength* len : {&style.textIndent, &style.marginTop, &style.marginBottom, &style.marginLeft,
+                               &style.marginRight, &style.paddingTop, &style.paddingBottom, &style.paddingLeft,
+                               &style.paddingRight}) {
+    memcpy(out, &len->value, sizeof(len->value));
+    out += sizeof(len->value);
+    *out++ = static_cast<uint8_t>(len->unit);
+  }
+
+  uint16_t definedBits = 0;
+  if (style.defined.textAlign) definedBits |= 1 << 0;
+  if (style.defined.fontStyle) definedBits |= 1 << 1;
+  if (style.defined.fontWeight) definedBits |= 1 << 2;
+  if (style.defined.textDecoration) definedBits |= 1 << 3;
+  if (style.defined.textIndent) definedBits |= 1 << 4;
+  if (style.defined.marginTop) definedBits |= 1 << 5;
+  if (style.defined.marginBottom) definedBits |= 1 << 6;
+  if (style.defined.marginLeft) definedBits |= 1 << 7;
+  if (style.defined.marginRight) definedBits |= 1 << 8;
+  if (style.defined.paddingTop) definedBits |= 1 << 9;
+  if (style.defined.paddingBottom) definedBits |= 1 << 10;
+  if (style.defined.paddingLeft) definedBits |= 1 << 11;
+  if (style.defined.paddingRight) definedBits |= 1 << 12;
+  memcpy(out, &definedBits, sizeof(definedBits));
+}
+
+void CssParser::encodeAncestorSelector(const AncestorSelector& selector, uint8_t* record) {
+  static_assert(ANCESTOR_RECORD_SIZE == sizeof(uint32_t) + 3 * sizeof(uint16_t) + 2 +
+                                            MAX_ANCESTOR_COMPOUNDS * sizeof(AncestorSelector::Compound));
+  uint8_t* out = record;
+  const auto put = [&out](const auto& value) {
+    memcpy(out, &value, sizeof(value));
+    out += sizeof(value);
+  };
+  put(selector.keyHash);
+  put(selector.styleIndex);
+  put(selector.order);
+  put(selector.specificity);
+  put(selector.ancestorCount);
+  put(selector.childMask);
+  for (const auto& ancestor : selector.ancestors) {
+    put(ancestor.tagHash);
+    put(ancestor.classHash);
+  }
+}
+
+CssParser::AncestorSelector CssParser::decodeAncestorSelector(const uint8_t* record) {
+  AncestorSelector selector;
+  const uint8_t* in = record;
+  const auto get = [&in](auto& value) {
+    memcpy(&value, in, sizeof(value));
+    in += sizeof(value);
+  };
+  get(selector.keyHash);
+  get(selector.styleIndex);
+  get(selector.order);
+  get(selector.specificity);
+  get(selector.ancestorCount);
+  get(selector.childMask);
+  for (auto& ancestor : selector.ancestors) {
+    get(ancestor.tagHash);
+    get(ancestor.classHash);
+  }
+  return selector;
+}
+
+CssStyle CssParser::decodeStyleRecord(const uint8_t* record) {
+  CssStyle style;
+  const uint8_t* in = record;
+  style.textAlign = static_cast<CssTextAlign>(*in++);
+  style.fontStyle = static_cast<CssFontStyle>(*in++);
+  style.fontWeight = static_cast<CssFontWeight>(*in++);
+  style.textDecoration = static_cast<CssTextDecoration>(*in++);
+
+  for (CssLength* len : {&style.textIndent, &style.marginTop, &style.marginBottom, &style.marginLeft,
+                         &style.marginRight, &style.paddingTop, &style.paddingBottom, &style.paddingLeft,
+                         &style.paddingRight}) {
+    memcpy(&len->value, in, sizeof(len->value));
+    in += sizeof(len->value);
+    len->unit = static_cast<CssUnit>(*in++);
+  }
+
+  uint16_t definedBits;
+  memcpy(&definedBits, in, sizeof(definedBits));
+  style.defined.textAlign = (definedBits & 1 << 0) != 0;
+  style.defined.fontStyle = (definedBits & 1 << 1) != 0;
+  style.defined.fontWeight = (definedBits & 1 << 2) != 0;
+  style.defined.textDecoration = (definedBits & 1 << 3) != 0;
+  style.defined.textIndent = (definedBits & 1 << 4) != 0;
+  style.defined.marginTop = (definedBits & 1 << 5) != 0;
+  style.defined.marginBottom = (definedBits & 1 << 6) != 0;
+  style.defined.marginLeft = (definedBits & 1 << 7) != 0;
+  style.defined.marginRight = (definedBits & 1 << 8) != 0;
+  style.defined.paddingTop = (definedBits & 1 << 9) != 0;
+  style.defined.paddingBottom = (definedBits & 1 << 10) != 0;
+  style.defined.paddingLeft = (definedBits & 1 << 11) != 0;
+  style.defined.paddingRight = (definedBits & 1 << 12) != 0;
+  return style;
+}
+
+void CssParser::clear() {
+  rulesBySelector_.clear();
+  ancestorStyles_.clear();
+  ancestorStyles_.shrink_to_fit();
+  ancestorSelectors_.clear();
+  ancestorSelectors_.shrink_to_fit();
+  selectorHashes_.clear();
+  selectorHashes_.shrink_to_fit();
+  styleIndexes_.clear();
+  styleIndexes_.shrink_to_fit();
+  styles_.clear();
+  styles_.shrink_to_fit();
+  closeCardLookup();
+}
+
+void CssParser::closeCardLookup() {
+  if (cacheFile_) {
+    cacheFile_.close();
+  }
+  cardRuleCount_ = 0;
+  cardStyleCount_ = 0;
+}
+
+bool CssParser::hasCache() const {
+  // A cache of an older version counts as missing, so it gets rebuilt from the stylesheets
+  FsFile file;
+  if (cachePath.empty() || !Storage.exists((cachePath + rulesCache).c_str()) ||
+      !Storage.openFileForRead("CSS", cachePath + rulesCache, file)) {
+    return false;
+  }
+  uint8_t version = 0;
+  const bool current = file.read(&version, 1) == 1 && version == CSS_CACHE_VERSION;
+  file.close();
+  return current;
+}
+
+bool CssParser::retainRules() {
+  retainCount_++;
+  if (!selectorHashes_.empty() || !ancestorSelectors_.empty() || cacheFile_) {
+    return true;
+  }
+  return loadFromCache();
+}
+
+void CssParser::releaseRules() {
+  if (retainCount_ > 0) {
+    retainCount_--;
+  }
+  // Looking rules up on the card only bridges low memory; the next build decides again
+  if (retainCount_ == 0 && cacheFile_) {
+    LOG_DBG("CSS", "Closing rules cache after on-card lookups");
+    clear();
+  }
+}
+
+bool CssParser::freeRules() {
+  if (retainCount_ > 0 || (selectorHashes_.empty() && ancestorSelectors_.empty())) {
+    return false;
+  }
+  LOG_DBG("CSS", "Freeing %zu loaded rules", ruleCount());
+  clear();
+  return true;
+}
 
 bool CssParser::saveToCache() const {
   if (cachePath.empty()) {
     return false;
   }
 
+  // Keys in ascending hash order, so lookups can binary search them
+  std::vector<const std::pair<const uint32_t, CssStyle>*> sortedRules;
+  sortedRules.reserve(rulesBySelector_.size());
+  for (const auto& pair : rulesBySelector_) {
+    sortedRules.push_back(&pair);
+  }
+  std::sort(sortedRules.begin(), sortedRules.end(), [](const auto* a, const auto* b) { return a->first < b->first; });
+
+  std::vector<AncestorSelector> sortedAncestors = ancestorSelectors_;
+  std::stable_sort(sortedAncestors.begin(), sortedAncestors.end(),
+                   [](const AncestorSelector& a, const AncestorSelector& b) { return a.keyHash < b.keyHash; });
+
+  // Many selectors share the same declarations; each distinct style is stored once
+  std::vector<std::array<uint8_t, STYLE_RECORD_SIZE>> records;
+  const auto internStyle = [&records](const CssStyle& style) {
+    std::array<uint8_t, STYLE_RECORD_SIZE> record;
+    encodeStyleRecord(style, record.data());
+    const auto it = std::find(records.begin(), records.end(), record);
+    if (it != records.end()) {
+      return static_cast<uint16_t>(it - records.begin());
+    }
+    records.push_back(record);
+    return static_cast<uint16_t>(records.size() - 1);
+  };
+  std::vector<uint16_t> styleIndexes;
+  styleIndexes.reserve(sortedRules.size());
+  for (const auto* rule : sortedRules) {
+    styleIndexes.push_back(internStyle(rule->second));
+  }
+  for (auto& selector : sortedAncestors) {
+    selector.styleIndex = internStyle(ancestorStyles_[selector.styleIndex]);
+  }
+
   FsFile file;
   if (!Storage.openFileForWrite("CSS", cachePath + rulesCache, file)) {
     return false;
   }
 
-  // Write version
+  // Header: version, rule count, style count, descendant/child selector count
   file.write(CSS_CACHE_VERSION);
-
-  // Write rule count
-  const auto ruleCount = static_cast<uint16_t>(rulesBySelector_.size());
+  const auto ruleCount = static_cast<uint16_t>(sortedRules.size());
   file.write(reinterpret_cast<const uint8_t*>(&ruleCount), sizeof(ruleCount));
+  const auto styleCount = static_cast<uint16_t>(records.size());
+  file.write(reinterpret_cast<const uint8_t*>(&styleCount), sizeof(styleCount));
+  const auto ancestorCount = static_cast<uint16_t>(sortedAncestors.size());
+  file.write(reinterpret_cast<const uint8_t*>(&ancestorCount), sizeof(ancestorCount));
+
+  // Style table, fixed size records
+  for (const auto& styleRecord : records) {
+    file.write(styleRecord.data(), styleRecord.size());
+  }
 
-  // Write each rule: selector string + CssStyle fields
-  for (const auto& pair : rulesBySelector_) {
-    // Write selector string (length-prefixed)
-    const auto selectorLen = static_cast<uint16_t>(pair.first.size());
-    file.write(reinterpret_cast<const uint8_t*>(&selectorLen), sizeof(selectorLen));
-    file.write(reinterpret_cast<const uint8_t*>(pair.first.data()), selectorLen);
-
-    // Write CssStyle fields (all are POD types)
-    const CssStyle& style = pair.second;
-    file.write(static_cast<uint8_t>(style.textAlign));
-    file.write(static_cast<uint8_t>(style.fontStyle));
-    file.write(static_cast<uint8_t>(style.fontWeight));
-    file.write(static_cast<uint8_t>(style.textDecoration));
-
-    // Write CssLength fields (value + unit)
-    auto writeLength = [&file](const CssLength& len) {
-      file.write(reinterpret_cast<const uint8_t*>(&len.value), sizeof(len.value));
-      file.write(static_cast<uint8_t>(len.unit));
-    };
+  // Key table: selector hash + style index, fixed size entries
+  for (size_t i = 0; i < sortedRules.size(); i++) {
+    uint8_t entry[KEY_ENTRY_SIZE];
+    memcpy(entry, &sortedRules[i]->first, sizeof(uint32_t));
+    memcpy(entry + sizeof(uint32_t), &styleIndexes[i], sizeof(uint16_t));
+    file.write(entry, KEY_ENTRY_SIZE);
+  }
+
+  // Compiled descendant/child selectors, in key hash order
+  for (const auto& selector : sortedAncestors) {
+    uint8_t entry[ANCESTOR_RECORD_SIZE];
+    encodeAncestorSelector(selector, entry);
+    file.write(entry, ANCESTOR_RECORD_SIZE);
+  }
 
-    writeLength(style.textIndent);
-    writeLength(style.marginTop);
-    writeLength(style.marginBottom);
-    writeLength(style.marginLeft);
-    writeLength(style.marginRight);
-    writeLength(style.paddingTop);
-    writeLength(style.paddingBottom);
-    writeLength(style.paddingLeft);
-    writeLength(style.paddingRight);
-
-    // Write defined flags as uint16_t
-    uint16_t definedBits = 0;
-    if (style.defined.textAlign) definedBits |= 1 << 0;
-    if (style.defined.fontStyle) definedBits |= 1 << 1;
-    if (style.defined.fontWeight) definedBits |= 1 << 2;
-    if (style.defined.textDecoration) definedBits |= 1 << 3;
-    if (style.defined.textIndent) definedBits |= 1 << 4;
-    if (style.defined.marginTop) definedBits |= 1 << 5;
-    if (style.defined.marginBottom) definedBits |= 1 << 6;
-    if (style.defined.marginLeft) definedBits |= 1 << 7;
-    if (style.defined.marginRight) definedBits |= 1 << 8;
-    if (style.defined.paddingTop) definedBits |= 1 << 9;
-    if (style.defined.paddingBottom) definedBits |= 1 << 10;
-    if (style.defined.paddingLeft) definedBits |= 1 << 11;
-    if (style.defined.paddingRight) definedBits |= 1 << 12;
-    file.write(reinterpret_cast<const uint8_t*>(&definedBits), sizeof(definedBits));
-  }
-
-  LOG_DBG("CSS", "Saved %u rules to cache", ruleCount);
+  LOG_DBG("CSS", "Saved %u rules and %u descendant/child rules with %u distinct styles to cache", ruleCount,
+          ancestorCount, styleCount);
   file.close();
   return true;
 }
@@ -642,125 +1060,106 @@ bool CssParser::loadFromCache() {
     return false;
   }
 
-  FsFile file;
-  if (!Storage.openFileForRead("CSS", cachePath + rulesCache, file)) {
-    return false;
-  }
-
   // Clear existing rules
   clear();
 
-  // Read and verify version
-  uint8_t version = 0;
-  if (file.read(&version, 1) != 1 || version != CSS_CACHE_VERSION) {
-    LOG_DBG("CSS", "Cache version mismatch (got %u, expected %u)", version, CSS_CACHE_VERSION);
-    file.close();
+  // Opened as the lookup file; closed again below unless the rules have to stay on the card
+  FsFile& file = cacheFile_;
+  if (!Storage.openFileForRead("CSS", cachePath + rulesCache, file)) {
     return false;
   }
 
-  // Read rule count
-  uint16_t ruleCount = 0;
-  if (file.read(&ruleCount, sizeof(ruleCount)) != sizeof(ruleCount)) {
-    file.close();
+  // Read and verify the header
+  uint8_t header[CACHE_HEADER_SIZE] = {};
+  if (file.read(header, CACHE_HEADER_SIZE) != CACHE_HEADER_SIZE || header[0] != CSS_CACHE_VERSION) {
+    LOG_DBG("CSS", "Cache version mismatch (got %u, expected %u)", header[0], CSS_CACHE_VERSION);
+    closeCardLookup();
+    return false;
+  }
+  uint16_t ruleCount;
+  uint16_t styleCount;
+  uint16_t ancestorCount;
+  memcpy(&ruleCount, header + 1, sizeof(ruleCount));
+  memcpy(&styleCount, header + 3, sizeof(styleCount));
+  memcpy(&ancestorCount, header + 5, sizeof(ancestorCount));
+  const size_t keysOffset = CACHE_HEADER_SIZE + styleCount * STYLE_RECORD_SIZE;
+  const size_t ancestorsOffset = keysOffset + ruleCount * KEY_ENTRY_SIZE;
+  if (file.size() != ancestorsOffset + ancestorCount * ANCESTOR_RECORD_SIZE) {
+    LOG_ERR("CSS", "Cache size does not match its header");
+    closeCardLookup();
     return false;
   }
 
-  // Read each rule
-  for (uint16_t i = 0; i < ruleCount; ++i) {
-    // Read selector string
-    uint16_t selectorLen = 0;
-    if (file.read(&selectorLen, sizeof(selectorLen)) != sizeof(selectorLen)) {
-      rulesBySelector_.clear();
-      file.close();
-      return false;
-    }
-
-    std::string selector;
-    selector.resize(selectorLen);
-    if (file.read(&selector[0], selectorLen) != selectorLen) {
-      rulesBySelector_.clear();
-      file.close();
-      return false;
-    }
-
-    // Read CssStyle fields
-    CssStyle style;
-    uint8_t enumVal;
-
-    if (file.read(&enumVal, 1) != 1) {
-      rulesBySelector_.clear();
-      file.close();
+  // Descendant/child selectors are always loaded; they are few and checked for many elements
+  ancestorSelectors_.reserve(ancestorCount);
+  uint8_t selectorRecord[ANCESTOR_RECORD_SIZE];
+  if (!file.seek(ancestorsOffset)) {
+    clear();
+    return false;
+  }
+  for (uint16_t i = 0; i < ancestorCount; ++i) {
+    if (file.read(selectorRecord, ANCESTOR_RECORD_SIZE) != ANCESTOR_RECORD_SIZE) {
+      clear();
       return false;
     }
-    style.textAlign = static_cast<CssTextAlign>(enumVal);
-
-    if (file.read(&enumVal, 1) != 1) {
-      rulesBySelector_.clear();
-      file.close();
+    const AncestorSelector selector = decodeAncestorSelector(selectorRecord);
+    if ((i > 0 && selector.keyHash < ancestorSelectors_.back().keyHash) || selector.styleIndex >= styleCount ||
+        selector.ancestorCount == 0 || selector.ancestorCount > MAX_ANCESTOR_COMPOUNDS) {
+      LOG_ERR("CSS", "Invalid descendant/child rule in cache");
+      clear();
       return false;
     }
-    style.fontStyle = static_cast<CssFontStyle>(enumVal);
+    ancestorSelectors_.push_back(selector);
+  }
 
-    if (file.read(&enumVal, 1) != 1) {
-      rulesBySelector_.clear();
-      file.close();
-      return false;
-    }
-    style.fontWeight = static_cast<CssFontWeight>(enumVal);
+  // Without room for the tables, look rules up in the file itself rather than dropping the book's styling
+  const size_t tableBytes = ruleCount * (sizeof(uint32_t) + sizeof(uint16_t)) + styleCount * sizeof(CssStyle);
+  if (ESP.getFreeHeap() < MIN_FREE_HEAP_FOR_CSS + tableBytes) {
+    LOG_DBG("CSS", "Low heap (%u bytes), looking up %u rules on the card", ESP.getFreeHeap(), ruleCount);
+    cardRuleCount_ = ruleCount;
+    cardStyleCount_ = styleCount;
+    return true;
+  }
 
-    if (file.read(&enumVal, 1) != 1) {
-      rulesBySelector_.clear();
-      file.close();
+  if (!file.seek(CACHE_HEADER_SIZE)) {
+    clear();
+    return false;
+  }
+  styles_.reserve(styleCount);
+  uint8_t record[STYLE_RECORD_SIZE];
+  for (uint16_t i = 0; i < styleCount; ++i) {
+    if (file.read(record, STYLE_RECORD_SIZE) != STYLE_RECORD_SIZE) {
+      clear();
       return false;
     }
-    style.textDecoration = static_cast<CssTextDecoration>(enumVal);
-
-    // Read CssLength fields
-    auto readLength = [&file](CssLength& len) -> bool {
-      if (file.read(&len.value, sizeof(len.value)) != sizeof(len.value)) {
-        return false;
-      }
-      uint8_t unitVal;
-      if (file.read(&unitVal, 1) != 1) {
-        return false;
-      }
-      len.unit = static_cast<CssUnit>(unitVal);
-      return true;
-    };
+    styles_.push_back(decodeStyleRecord(record));
+  }
 
-    if (!readLength(style.textIndent) || !readLength(style.marginTop) || !readLength(style.marginBottom) ||
-        !readLength(style.marginLeft) || !readLength(style.marginRight) || !readLength(style.paddingTop) ||
-        !readLength(style.paddingBottom) || !readLength(style.paddingLeft) || !readLength(style.paddingRight)) {
-      rulesBySelector_.clear();
-      file.close();
+  selectorHashes_.reserve(ruleCount);
+  styleIndexes_.reserve(ruleCount);
+  uint8_t entry[KEY_ENTRY_SIZE];
+  for (uint16_t i = 0; i < ruleCount; ++i) {
+    if (file.read(entry, KEY_ENTRY_SIZE) != KEY_ENTRY_SIZE) {
+      clear();
       return false;
     }
-
-    // Read defined flags
-    uint16_t definedBits = 0;
-    if (file.read(&definedBits, sizeof(definedBits)) != sizeof(definedBits)) {
-      rulesBySelector_.clear();
-      file.close();
+    uint32_t hash;
+    uint16_t styleIndex;
+    memcpy(&hash, entry, sizeof(hash));
+    memcpy(&styleIndex, entry + sizeof(hash), sizeof(styleIndex));
+
+    // Lookups rely on the order saveToCache writes in
+    if ((i > 0 && hash <= selectorHashes_.back()) || styleIndex >= styleCount) {
+      LOG_ERR("CSS", "Cache rules out of order");
+      clear();
       return false;
     }
-    style.defined.textAlign = (definedBits & 1 << 0) != 0;
-    style.defined.fontStyle = (definedBits & 1 << 1) != 0;
-    style.defined.fontWeight = (definedBits & 1 << 2) != 0;
-    style.defined.textDecoration = (definedBits & 1 << 3) != 0;
-    style.defined.textIndent = (definedBits & 1 << 4) != 0;
-    style.defined.marginTop = (definedBits & 1 << 5) != 0;
-    style.defined.marginBottom = (definedBits & 1 << 6) != 0;
-    style.defined.marginLeft = (definedBits & 1 << 7) != 0;
-    style.defined.marginRight = (definedBits & 1 << 8) != 0;
-    style.defined.paddingTop = (definedBits & 1 << 9) != 0;
-    style.defined.paddingBottom = (definedBits & 1 << 10) != 0;
-    style.defined.paddingLeft = (definedBits & 1 << 11) != 0;
-    style.defined.paddingRight = (definedBits & 1 << 12) != 0;
-
-    rulesBySelector_[selector] = style;
+    selectorHashes_.push_back(hash);
+    styleIndexes_.push_back(styleIndex);
   }
+  closeCardLookup();
 
-  LOG_DBG("CSS", "Loaded %u rules from cache", ruleCount);
-  file.close();
+  LOG_DBG("CSS", "Loaded %u rules and %u descendant/child rules (%u distinct styles) from cache", ruleCount,
+          ancestorCount, styleCount);
   return true;
 }
@@ -3,12 +3,21 @@
 #include <HalStorage.h>
 
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "CssElementStack.h"
 #include "CssStyle.h"
 
+class ZipEntryReader;
+
+// Rules cache format version - increment when the format or how rules match changes. Flow and section files record
+// it too, so styles resolved under older rules are rebuilt with the cache.
+// Version 5: descendant/child selector table
+constexpr uint8_t CSS_CACHE_VERSION = 5;
+
 /**
  * Lightweight CSS parser for EPUB stylesheets
  *
@@ -16,14 +25,31 @@
  * Uses a two-phase approach: first tokenizes the CSS content, then builds
  * a rule database that can be queried during HTML parsing.
  *
+ * Stylesheets are parsed once per book into the rules cache file. Section builds
+ * then query the rules loaded from that cache, which stay resident in a packed,
+ * read-only form for the rest of the book session (see retainRules/freeRules).
+ * When the heap is too low to load them, lookups binary search the cache file
+ * on the card instead.
+ *
+ * Rules are keyed by a 32-bit hash of the normalized selector rather than the
+ * selector text, and selectors with identical declarations share one stored
+ * style. Two selectors whose hashes collide share a rule.
+ *
  * Supported selectors:
  *   - Element selectors: p, div, h1, etc.
  *   - Class selectors: .classname
  *   - Combined: element.classname
+ *   - Descendant and child selectors built from the above: div.chapter p, ul > li
+ *     (up to MAX_ANCESTOR_COMPOUNDS enclosing elements)
  *   - Grouped: selector1, selector2 { }
  *
+ * Descendant and child selectors are compiled when parsed: the rightmost part is
+ * the lookup key, like a simple selector, and the rest become requirements on
+ * the enclosing elements, checked against a CssElementStack only for elements
+ * that have the key.
+ *
  * Not supported (silently ignored):
- *   - Descendant/child selectors
+ *   - Sibling combinators, ID and attribute selectors
  *   - Pseudo-classes and pseudo-elements
  *   - Media queries (content is skipped)
  *   - @import, @font-face, etc.
@@ -38,12 +64,12 @@ class CssParser {
   CssParser& operator=(const CssParser&) = delete;
 
   /**
-   * Load and parse CSS from a file stream.
+   * Load and parse CSS from a zip entry stream.
    * Can be called multiple times to accumulate rules from multiple stylesheets.
-   * @param source Open file handle to read from
+   * @param source Open entry reader to pull inflated bytes from
    * @return true if parsing completed (even if no rules found)
    */
-  bool loadFromStream(FsFile& source);
+  bool loadFromStream(ZipEntryReader& source);
 
   /**
    * Look up the style for an HTML element, considering tag name and class attributes.
@@ -53,32 +79,55 @@ class CssParser {
    * @param classAttr The class attribute value (may contain multiple space-separated classes)
    * @return Combined style with all applicable rules merged
    */
-  [[nodiscard]] CssStyle resolveStyle(const std::string& tagName, const std::string& classAttr) const;
+  [[nodiscard]] CssStyle resolveStyle(std::string_view tagName, std::string_view classAttr) const;
+
+  /**
+   * As above, also applying descendant and child selectors whose requirements the element's ancestors meet.
+   * Rules are applied in order of specificity; at equal specificity simple selectors come first.
+   *
+   * @param ancestors Elements enclosing this one
+   * @param ancestorDependent Set to true if some descendant or child selector ends in this element's tag or classes,
+   *        i.e. the same tag and classes may be styled differently elsewhere in the document
+   */
+  [[nodiscard]] CssStyle resolveStyle(std::string_view tagName, std::string_view classAttr,
+                                      const CssElementStack& ancestors, bool& ancestorDependent) const;
+
+  /**
+   * Check if any loaded rule has a descendant or child selector, i.e. whether resolving styles needs ancestors
+   */
+  [[nodiscard]] bool hasAncestorSelectors() const { return !ancestorSelectors_.empty(); }
+
+  /**
+   * Hash of a tag or class name the way selectors refer to it
+   */
+  [[nodiscard]] static uint32_t nameHash(std::string_view name);
 
   /**
    * Parse an inline style attribute string.
    * @param styleValue The value of a style="" attribute
    * @return Parsed style properties
    */
-  [[nodiscard]] static CssStyle parseInlineStyle(const std::string& styleValue);
+  [[nodiscard]] static CssStyle parseInlineStyle(std::string_view styleValue);
 
   /**
-   * Check if any rules have been loaded
+   * Check if any rules have been parsed or loaded
    */
-  [[nodiscard]] bool empty() const { return rulesBySelector_.empty(); }
+  [[nodiscard]] bool empty() const { return ruleCount() == 0; }
 
   /**
-   * Get count of loaded rule sets
+   * Get count of parsed or loaded rule sets
    */
-  [[nodiscard]] size_t ruleCount() const { return rulesBySelector_.size(); }
+  [[nodiscard]] size_t ruleCount() const {
+    return rulesBySelector_.size() + selectorHashes_.size() + cardRuleCount_ + ancestorSelectors_.size();
+  }
 
   /**
-   * Clear all loaded rules
+   * Clear all parsed and loaded rules
    */
-  void clear() { rulesBySelector_.clear(); }
+  void clear();
 
   /**
-   * Check if CSS rules cache file exists
+   * Check if a CSS rules cache file of the current version exists
    */
   bool hasCache() const;
 
@@ -89,21 +138,96 @@ class CssParser {
   bool saveToCache() const;
 
   /**
-   * Load CSS rules from a cache file.
+   * Load CSS rules from a cache file, or keep the file open for on-card lookups when free heap is low.
    * Clears any existing rules before loading.
    * @return true if cache was loaded successfully
    */
   bool loadFromCache();
 
+  /**
+   * Mark the loaded rules as in use by a section build, loading them from the cache first unless they are already
+   * resident. Every call must be paired with releaseRules(), even if it fails.
+   * @return true if rules are loaded
+   */
+  bool retainRules();
+
+  /**
+   * End a use started with retainRules(). The rules stay loaded for the next section build.
+   */
+  void releaseRules();
+
+  /**
+   * Memory pressure hook: frees the loaded rules, the next retainRules() loads them again. No-op while a section
+   * build is using them.
+   * @return true if the rules were freed
+   */
+  bool freeRules();
+
  private:
-  // Storage: maps normalized selector -> style properties
-  std::unordered_map<std::string, CssStyle> rulesBySelector_;
+  static constexpr size_t MAX_ANCESTOR_COMPOUNDS = 4;
+
+  // A descendant or child selector compiled for matching from the element outwards. The rightmost compound is the
+  // key, hashed like a simple selector; the others are requirements on enclosing elements, nearest first.
+  struct AncestorSelector {
+    struct Compound {
+      uint32_t tagHash;    // 0 = any tag
+      uint32_t classHash;  // 0 = any classes
+    };
+    uint32_t keyHash;
+    uint16_t styleIndex;   // Into ancestorStyles_ while parsing, into styles_ once loaded
+    uint16_t order;        // Position in the stylesheets, breaks specificity ties
+    uint16_t specificity;  // Class count * 256 + tag count
+    uint8_t ancestorCount;
+    uint8_t childMask;  // Bit i: ancestor i must be the parent of the element matched before it
+    Compound ancestors[MAX_ANCESTOR_COMPOUNDS];
+  };
+
+  // Outcome of matching a selector's requirements against some of the ancestors. FailsLocally only rules out the
+  // ancestor tried for the nearest descendant requirement; FailsCompletely rules out every ancestor further out too.
+  enum class AncestorMatch : uint8_t { Matched, FailsLocally, FailsCompletely };
+
+  // Rules being parsed from stylesheets: maps normalized selector hash -> style properties
+  std::unordered_map<uint32_t, CssStyle> rulesBySelector_;
+  std::vector<CssStyle> ancestorStyles_;
+
+  // Descendant and child selectors, in stylesheet order while parsing and sorted by key hash once loaded. Kept in
+  // memory even while simple rules are looked up on the card; there are few of them.
+  std::vector<AncestorSelector> ancestorSelectors_;
+
+  // Rules loaded from the cache: selector hashes in ascending order, each with the index of its style in the
+  // deduplicated style table. Read-only once loaded.
+  std::vector<uint32_t> selectorHashes_;
+  std::vector<uint16_t> styleIndexes_;
+  std::vector<CssStyle> styles_;
+  uint8_t retainCount_ = 0;
+
+  // Cache file kept open instead of the tables above while looking rules up on the card
+  mutable FsFile cacheFile_;
+  uint16_t cardRuleCount_ = 0;
+  uint16_t cardStyleCount_ = 0;
 
   std::string cachePath;
 
+  bool findRule(uint32_t selectorHash, CssStyle& style) const;
+  bool findRuleOnCard(uint32_t selectorHash, CssStyle& style) const;
+  bool styleAt(uint16_t index, CssStyle& style) const;
+  void closeCardLookup();
+  CssStyle resolve(std::string_view tagName, std::string_view classAttr, const CssElementStack* ancestors,
+                   bool& ancestorDependent) const;
+  static AncestorMatch matchAncestors(const AncestorSelector& selector, size_t index, const CssElementStack& ancestors,
+                                      size_t count);
+
+  // Cache file records
+  static void encodeStyleRecord(const CssStyle& style, uint8_t* record);
+  static CssStyle decodeStyleRecord(const uint8_t* record);
+  static void encodeAncestorSelector(const AncestorSelector& selector, uint8_t* record);
+  static AncestorSelector decodeAncestorSelector(const uint8_t* record);
+
   // Internal parsing helpers
   void processRuleBlockWithStyle(const std::string& selectorGroup, const CssStyle& style);
-  static CssStyle parseDeclarations(const std::string& declBlock);
+  void addAncestorSelector(const std::string& selector, const CssStyle& style);
+  static bool compileAncestorSelector(std::string_view selector, AncestorSelector& compiled);
+  static CssStyle parseDeclarations(std::string_view declBlock);
   static void parseDeclarationIntoStyle(const std::string& decl, CssStyle& style, std::string& propNameBuf,
                                         std::string& propValueBuf);
 
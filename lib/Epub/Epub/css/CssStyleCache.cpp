@@ -0,0 +1,8 @@
+#include "CssStyleCache.h"
+
+CssStyleCache::Key CssStyleCache::keyOf(const std::string_view tagName, const std::string_view classAttr) {
+  // The separator keeps <a class="bc"> and <ab class="c"> apart
+  Key key;
+  key.add(tagName).addByte(0).add(classAttr);
+  return key;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "../HashedCache.h"
+#include "CssStyle.h"
+
+// Small LRU cache of resolved element styles, kept by the chapter parser for the whole section build. Chapters repeat
+// the same few tag and class combinations (<p class="calibre3">) thousands of times, and resolving one looks up and
+// merges a rule per class. A chapter rarely uses more distinct combinations than there are entries, so it is a single
+// fully associative set rather than slots that would evict each other.
+class CssStyleCache : public HashedCache<CssStyle, 1, 32> {  // ~3KB
+ public:
+  static Key keyOf(std::string_view tagName, std::string_view classAttr);
+};
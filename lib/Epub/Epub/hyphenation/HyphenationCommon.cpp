@@ -135,7 +135,7 @@ bool isExplicitHyphen(const uint32_t cp) {
 
 bool isSoftHyphen(const uint32_t cp) { return cp == 0x00AD; }
 
-void trimSurroundingPunctuationAndFootnote(std::vector<CodepointInfo>& cps) {
+void trimSurroundingPunctuationAndFootnote(WordCodepoints& cps) {
   if (cps.empty()) {
     return;
   }
@@ -143,39 +143,43 @@ void trimSurroundingPunctuationAndFootnote(std::vector<CodepointInfo>& cps) {
   // Remove trailing footnote references like [12], even if punctuation trails after the closing bracket.
   if (cps.size() >= 3) {
     int end = static_cast<int>(cps.size()) - 1;
-    while (end >= 0 && isPunctuation(cps[end].value)) {
+    while (end >= 0 && isPunctuation(cps.value(end))) {
       --end;
     }
     int pos = end;
-    if (pos >= 0 && isAsciiDigit(cps[pos].value)) {
-      while (pos >= 0 && isAsciiDigit(cps[pos].value)) {
+    if (pos >= 0 && isAsciiDigit(cps.value(pos))) {
+      while (pos >= 0 && isAsciiDigit(cps.value(pos))) {
         --pos;
       }
-      if (pos >= 0 && cps[pos].value == '[' && end - pos > 1) {
-        cps.erase(cps.begin() + pos, cps.end());
+      if (pos >= 0 && cps.value(pos) == '[' && end - pos > 1) {
+        cps.count = pos;
       }
     }
   }
 
-  while (!cps.empty() && isPunctuation(cps.front().value)) {
-    cps.erase(cps.begin());
+  while (!cps.empty() && isPunctuation(cps.value(0))) {
+    cps.first++;
+    cps.count--;
   }
-  while (!cps.empty() && isPunctuation(cps.back().value)) {
-    cps.pop_back();
+  while (!cps.empty() && isPunctuation(cps.value(cps.size() - 1))) {
+    cps.count--;
   }
 }
 
-std::vector<CodepointInfo> collectCodepoints(const std::string& word) {
-  std::vector<CodepointInfo> cps;
-  cps.reserve(word.size());
+bool collectCodepoints(const char* word, const size_t length, WordCodepoints& cps) {
+  cps.first = 0;
+  cps.count = 0;
+  if (length > MAX_HYPHENATION_WORD_BYTES) {
+    return false;
+  }
 
-  const unsigned char* base = reinterpret_cast<const unsigned char*>(word.c_str());
+  const unsigned char* base = reinterpret_cast<const unsigned char*>(word);
   const unsigned char* ptr = base;
-  while (*ptr != 0) {
+  while (ptr < base + length && *ptr != 0) {
     const unsigned char* current = ptr;
-    const uint32_t cp = utf8NextCodepoint(&ptr);
-    cps.push_back({cp, static_cast<size_t>(current - base)});
+    cps.values[cps.count] = utf8NextCodepoint(&ptr);
+    cps.byteOffsets[cps.count] = static_cast<uint8_t>(current - base);
+    cps.count++;
   }
-
-  return cps;
+  return true;
 }
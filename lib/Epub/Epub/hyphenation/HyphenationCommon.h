@@ -2,12 +2,23 @@
 
 #include <cstddef>
 #include <cstdint>
-#include <string>
-#include <vector>
 
-struct CodepointInfo {
-  uint32_t value;
-  size_t byteOffset;
+// Longest word that is hyphenated, in UTF-8 bytes. Room for the longest word the chapter parser emits plus the
+// paragraph indent ParsedText prepends to a first word; the parser asserts that it fits.
+constexpr size_t MAX_HYPHENATION_WORD_BYTES = 208;
+
+// Codepoints of one word and where each starts in it, in fixed buffers so hyphenating a word never touches the heap.
+// Trimming moves `first` and `count` instead of shifting the buffers.
+struct WordCodepoints {
+  uint32_t values[MAX_HYPHENATION_WORD_BYTES];
+  uint8_t byteOffsets[MAX_HYPHENATION_WORD_BYTES];
+  size_t first = 0;
+  size_t count = 0;
+
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+  uint32_t value(const size_t index) const { return values[first + index]; }
+  size_t byteOffset(const size_t index) const { return byteOffsets[first + index]; }
 };
 
 uint32_t toLowerLatin(uint32_t cp);
@@ -21,5 +32,6 @@ bool isPunctuation(uint32_t cp);
 bool isAsciiDigit(uint32_t cp);
 bool isExplicitHyphen(uint32_t cp);
 bool isSoftHyphen(uint32_t cp);
-void trimSurroundingPunctuationAndFootnote(std::vector<CodepointInfo>& cps);
-std::vector<CodepointInfo> collectCodepoints(const std::string& word);
+void trimSurroundingPunctuationAndFootnote(WordCodepoints& cps);
+// False if the word is longer than MAX_HYPHENATION_WORD_BYTES
+bool collectCodepoints(const char* word, size_t length, WordCodepoints& cps);
@@ -1,7 +1,6 @@
 #include "Hyphenator.h"
 
-#include <vector>
-
+#include "../HashedCache.h"
 #include "HyphenationCommon.h"
 #include "LanguageRegistry.h"
 
@@ -26,72 +25,85 @@ const LanguageHyphenator* hyphenatorForLanguage(const std::string& langTag) {
   return getLanguageHyphenatorForPrimaryTag(primary);
 }
 
-// Maps a codepoint index back to its byte offset inside the source word.
-size_t byteOffsetForIndex(const std::vector<CodepointInfo>& cps, const size_t index) {
-  return (index < cps.size()) ? cps[index].byteOffset : (cps.empty() ? 0 : cps.back().byteOffset);
-}
+// Most recently used words and their breaks. Laying out a paragraph asks about each of its words, and the same words
+// keep coming back across paragraphs; running the patterns again costs far more than a scan of this table.
+HashedCache<Hyphenator::Breaks, 1, 16> breakCache;
 
-// Builds a vector of break information from explicit hyphen markers in the given codepoints.
-std::vector<Hyphenator::BreakInfo> buildExplicitBreakInfos(const std::vector<CodepointInfo>& cps) {
-  std::vector<Hyphenator::BreakInfo> breaks;
+// Codepoints of the word being hyphenated. About 1KB, so it is kept here rather than on the stack of the task laying
+// out the page; like breakCache it is only used by one layout at a time.
+WordCodepoints wordCodepoints;
 
-  // Scan every codepoint looking for explicit/soft hyphen markers that are surrounded by letters.
-  for (size_t i = 1; i + 1 < cps.size(); ++i) {
-    const uint32_t cp = cps[i].value;
-    if (!isExplicitHyphen(cp) || !isAlphabetic(cps[i - 1].value) || !isAlphabetic(cps[i + 1].value)) {
-      continue;
-    }
-    // Offset points to the next codepoint so rendering starts after the hyphen marker.
-    breaks.push_back({cps[i + 1].byteOffset, isSoftHyphen(cp)});
+}  // namespace
+
+Hyphenator::Breaks Hyphenator::breakOffsets(const char* word, const size_t length, const bool includeFallback) {
+  if (length == 0 || length > MAX_HYPHENATION_WORD_BYTES) {
+    return {};
   }
 
+  decltype(breakCache)::Key key;
+  key.addByte(includeFallback).add(word, length);
+  Breaks breaks;
+  if (!breakCache.lookup(key, breaks)) {
+    breaks = computeBreakOffsets(word, length, includeFallback);
+    breakCache.insert(key, breaks);
+  }
   return breaks;
 }
 
-}  // namespace
-
-std::vector<Hyphenator::BreakInfo> Hyphenator::breakOffsets(const std::string& word, const bool includeFallback) {
-  if (word.empty()) {
-    return {};
-  }
+Hyphenator::Breaks Hyphenator::computeBreakOffsets(const char* word, const size_t length, const bool includeFallback) {
+  Breaks breaks;
 
   // Convert to codepoints and normalize word boundaries.
-  auto cps = collectCodepoints(word);
+  WordCodepoints& cps = wordCodepoints;
+  if (!collectCodepoints(word, length, cps)) {
+    return breaks;
+  }
   trimSurroundingPunctuationAndFootnote(cps);
   const auto* hyphenator = cachedHyphenator_;
 
-  // Explicit hyphen markers (soft or hard) take precedence over language breaks.
-  auto explicitBreakInfos = buildExplicitBreakInfos(cps);
-  if (!explicitBreakInfos.empty()) {
-    return explicitBreakInfos;
+  // Explicit hyphen markers (soft or hard) take precedence over language breaks. Only markers surrounded by letters
+  // count; the offset points to the next codepoint so rendering starts after the marker.
+  for (size_t i = 1; i + 1 < cps.size(); ++i) {
+    const uint32_t cp = cps.value(i);
+    if (!isExplicitHyphen(cp) || !isAlphabetic(cps.value(i - 1)) || !isAlphabetic(cps.value(i + 1))) {
+      continue;
+    }
+    breaks.add(cps.byteOffset(i + 1), isSoftHyphen(cp));
+  }
+  if (!breaks.empty()) {
+    return breaks;
   }
 
   // Ask language hyphenator for legal break points.
-  std::vector<size_t> indexes;
+  BreakIndexSet indexes;
   if (hyphenator) {
     indexes = hyphenator->breakIndexes(cps);
   }
 
   // Only add fallback breaks if needed
-  if (includeFallback && indexes.empty()) {
+  if (includeFallback && indexes.none()) {
     const size_t minPrefix = hyphenator ? hyphenator->minPrefix() : LiangWordConfig::kDefaultMinPrefix;
     const size_t minSuffix = hyphenator ? hyphenator->minSuffix() : LiangWordConfig::kDefaultMinSuffix;
     for (size_t idx = minPrefix; idx + minSuffix <= cps.size(); ++idx) {
-      indexes.push_back(idx);
+      indexes.set(idx);
     }
   }
 
-  if (indexes.empty()) {
-    return {};
-  }
-
-  std::vector<Hyphenator::BreakInfo> breaks;
-  breaks.reserve(indexes.size());
-  for (const size_t idx : indexes) {
-    breaks.push_back({byteOffsetForIndex(cps, idx), true});
+  // Codepoint indexes to byte offsets. Breaks always leave at least one codepoint after them.
+  for (size_t idx = 1; idx < cps.size(); ++idx) {
+    if (indexes[idx]) {
+      breaks.add(cps.byteOffset(idx), true);
+    }
   }
 
   return breaks;
 }
 
-void Hyphenator::setPreferredLanguage(const std::string& lang) { cachedHyphenator_ = hyphenatorForLanguage(lang); }
+void Hyphenator::setPreferredLanguage(const std::string& lang) {
+  const LanguageHyphenator* hyphenator = hyphenatorForLanguage(lang);
+  if (hyphenator != cachedHyphenator_) {
+    // Cached breaks came from the previous language's patterns
+    breakCache.clear();
+    cachedHyphenator_ = hyphenator;
+  }
+}
@@ -1,8 +1,12 @@
 #pragma once
 
+#include <algorithm>
+#include <bitset>
 #include <cstddef>
+#include <cstdint>
 #include <string>
-#include <vector>
+
+#include "HyphenationCommon.h"
 
 class LanguageHyphenator;
 
@@ -12,13 +16,59 @@ class Hyphenator {
     size_t byteOffset;
     bool requiresInsertedHyphen;
   };
+
+  // Break points of one word as bitmasks over its byte offsets, small enough to return and cache by value.
+  // Iterating yields BreakInfos in increasing offset order.
+  class Breaks {
+    friend class Hyphenator;
+
+    std::bitset<MAX_HYPHENATION_WORD_BYTES> offsets;
+    std::bitset<MAX_HYPHENATION_WORD_BYTES> insertedHyphens;
+    size_t limit = 0;  // One past the last break
+
+    void add(const size_t offset, const bool insertHyphen) {
+      offsets.set(offset);
+      insertedHyphens.set(offset, insertHyphen);
+      limit = std::max(limit, offset + 1);
+    }
+
+    size_t nextOffset(size_t from) const {
+      while (from < limit && !offsets[from]) {
+        from++;
+      }
+      return from;
+    }
+
+   public:
+    class Iterator {
+      const Breaks* breaks;
+      size_t offset;
+
+     public:
+      Iterator(const Breaks* breaks, const size_t offset) : breaks(breaks), offset(offset) {}
+      BreakInfo operator*() const { return {offset, breaks->insertedHyphens[offset]}; }
+      Iterator& operator++() {
+        offset = breaks->nextOffset(offset + 1);
+        return *this;
+      }
+      bool operator!=(const Iterator& other) const { return offset != other.offset; }
+    };
+
+    Iterator begin() const { return {this, nextOffset(0)}; }
+    Iterator end() const { return {this, limit}; }
+    bool empty() const { return limit == 0; }
+  };
+
   // Returns byte offsets where the word may be hyphenated. When includeFallback is true, all positions obeying the
-  // minimum prefix/suffix constraints are returned even if no language-specific rule matches.
-  static std::vector<BreakInfo> breakOffsets(const std::string& word, bool includeFallback);
+  // minimum prefix/suffix constraints are returned even if no language-specific rule matches. Words longer than
+  // MAX_HYPHENATION_WORD_BYTES are never broken. Recently asked words are answered from a small LRU cache.
+  static Breaks breakOffsets(const char* word, size_t length, bool includeFallback);
 
   // Provide a publication-level language hint (e.g. "en", "en-US", "ru") used to select hyphenation rules.
   static void setPreferredLanguage(const std::string& lang);
 
  private:
   static const LanguageHyphenator* cachedHyphenator_;
-};
\ No newline at end of file
+
+  static Breaks computeBreakOffsets(const char* word, size_t length, bool includeFallback);
+};
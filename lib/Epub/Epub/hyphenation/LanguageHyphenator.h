@@ -10,7 +10,7 @@ class LanguageHyphenator {
                      size_t minSuffix = LiangWordConfig::kDefaultMinSuffix)
       : patterns_(patterns), config_(isLetterFn, toLowerFn, minPrefix, minSuffix) {}
 
-  std::vector<size_t> breakIndexes(const std::vector<CodepointInfo>& cps) const {
+  BreakIndexSet breakIndexes(const WordCodepoints& cps) const {
     return liangBreakIndexes(cps, patterns_, config_);
   }
 
@@ -1,14 +1,13 @@
 #include "LiangHyphenation.h"
 
 #include <algorithm>
-#include <vector>
 
 /*
  * Liang hyphenation pipeline overview (Typst-style binary trie variant)
  * --------------------------------------------------------------------
  * 1.  Input normalization (buildAugmentedWord)
- *     - Accepts a vector of CodepointInfo structs emitted by the EPUB text
- *       parser. Each codepoint is validated with LiangWordConfig::isLetter so
+ *     - Accepts the WordCodepoints of a word collected from the EPUB text.
+ *       Each codepoint is validated with LiangWordConfig::isLetter so
  *       we abort early on digits, punctuation, etc. If the word is valid we
  *       build an "augmented" byte sequence: leading '.', lowercase UTF-8 bytes
  *       for every letter, then a trailing '.'. While doing this we capture the
@@ -45,84 +44,99 @@
  *       etc.
  *
  * Keeping the entire algorithm small and deterministic is critical on the
- * ESP32-C3: we avoid recursion, dynamic allocations per node, or copying the
- * trie. All lookups stay within the generated blob, which lives in flash, and
- * the working buffers (augmented bytes/scores) scale with the word length rather
- * than the pattern corpus.
+ * ESP32-C3: we avoid recursion, heap allocations, or copying the trie. All
+ * lookups stay within the generated blob, which lives in flash, and the
+ * working buffers (augmented bytes/scores) are fixed-size static arrays, sized
+ * for the longest word the parser emits (MAX_HYPHENATION_WORD_BYTES) and kept
+ * off the stack of the task laying out the page.
  */
 
+#ifdef LIANG_COUNT_NODE_VISITS
+uint64_t liangNodeVisits = 0;
+#endif
+
 namespace {
 
 using EmbeddedAutomaton = SerializedHyphenationPatterns;
 
+// Lowercasing never lengthens a letter's UTF-8 encoding, so the dotted word fits the longest word plus both dots
+constexpr size_t AUGMENTED_CAPACITY = MAX_HYPHENATION_WORD_BYTES + 2;
+constexpr uint8_t NO_CHAR = 0xFF;
+static_assert(AUGMENTED_CAPACITY < NO_CHAR, "Augmented word indexes must fit in a byte");
+
 struct AugmentedWord {
-  std::vector<uint8_t> bytes;
-  std::vector<size_t> charByteOffsets;
-  std::vector<int32_t> byteToCharIndex;
+  uint8_t bytes[AUGMENTED_CAPACITY];
+  uint8_t charByteOffsets[AUGMENTED_CAPACITY];
+  uint8_t byteToCharIndex[AUGMENTED_CAPACITY];  // NO_CHAR for bytes inside a codepoint
+  size_t byteCount = 0;
+  size_t charCount = 0;
 
-  bool empty() const { return bytes.empty(); }
-  size_t charCount() const { return charByteOffsets.size(); }
+  bool empty() const { return byteCount == 0; }
 };
 
-// Encode a single Unicode codepoint into UTF-8 and append to the provided buffer.
-size_t encodeUtf8(uint32_t cp, std::vector<uint8_t>& out) {
+// Working buffers for liangBreakIndexes, only used by one layout at a time
+AugmentedWord augmentedScratch;
+uint8_t scoresScratch[AUGMENTED_CAPACITY];
+
+// Encode a single Unicode codepoint into UTF-8, returning the number of bytes written to `out`.
+size_t encodeUtf8(uint32_t cp, uint8_t* out) {
   if (cp <= 0x7Fu) {
-    out.push_back(static_cast<uint8_t>(cp));
+    out[0] = static_cast<uint8_t>(cp);
     return 1;
   }
   if (cp <= 0x7FFu) {
-    out.push_back(static_cast<uint8_t>(0xC0u | ((cp >> 6) & 0x1Fu)));
-    out.push_back(static_cast<uint8_t>(0x80u | (cp & 0x3Fu)));
+    out[0] = static_cast<uint8_t>(0xC0u | ((cp >> 6) & 0x1Fu));
+    out[1] = static_cast<uint8_t>(0x80u | (cp & 0x3Fu));
     return 2;
   }
   if (cp <= 0xFFFFu) {
-    out.push_back(static_cast<uint8_t>(0xE0u | ((cp >> 12) & 0x0Fu)));
-    out.push_back(static_cast<uint8_t>(0x80u | ((cp >> 6) & 0x3Fu)));
-    out.push_back(static_cast<uint8_t>(0x80u | (cp & 0x3Fu)));
+    out[0] = static_cast<uint8_t>(0xE0u | ((cp >> 12) & 0x0Fu));
+    out[1] = static_cast<uint8_t>(0x80u | ((cp >> 6) & 0x3Fu));
+    out[2] = static_cast<uint8_t>(0x80u | (cp & 0x3Fu));
     return 3;
   }
-  out.push_back(static_cast<uint8_t>(0xF0u | ((cp >> 18) & 0x07u)));
-  out.push_back(static_cast<uint8_t>(0x80u | ((cp >> 12) & 0x3Fu)));
-  out.push_back(static_cast<uint8_t>(0x80u | ((cp >> 6) & 0x3Fu)));
-  out.push_back(static_cast<uint8_t>(0x80u | (cp & 0x3Fu)));
+  out[0] = static_cast<uint8_t>(0xF0u | ((cp >> 18) & 0x07u));
+  out[1] = static_cast<uint8_t>(0x80u | ((cp >> 12) & 0x3Fu));
+  out[2] = static_cast<uint8_t>(0x80u | ((cp >> 6) & 0x3Fu));
+  out[3] = static_cast<uint8_t>(0x80u | (cp & 0x3Fu));
   return 4;
 }
 
-// Build the dotted, lowercase UTF-8 representation plus lookup tables.
-AugmentedWord buildAugmentedWord(const std::vector<CodepointInfo>& cps, const LiangWordConfig& config) {
-  AugmentedWord word;
+// Build the dotted, lowercase UTF-8 representation plus lookup tables. Left empty if the word has a non-letter.
+void buildAugmentedWord(const WordCodepoints& cps, const LiangWordConfig& config, AugmentedWord& word) {
+  word.byteCount = 0;
+  word.charCount = 0;
   if (cps.empty()) {
-    return word;
+    return;
   }
 
-  word.bytes.reserve(cps.size() * 2 + 2);
-  word.charByteOffsets.reserve(cps.size() + 2);
-
-  word.charByteOffsets.push_back(0);
-  word.bytes.push_back('.');
-
-  for (const auto& info : cps) {
-    if (!config.isLetter(info.value)) {
-      word.bytes.clear();
-      word.charByteOffsets.clear();
-      word.byteToCharIndex.clear();
-      return word;
+  word.charByteOffsets[word.charCount++] = 0;
+  word.bytes[word.byteCount++] = '.';
+
+  for (size_t i = 0; i < cps.size(); ++i) {
+    uint8_t encoded[4];
+    const size_t length = config.isLetter(cps.value(i)) ? encodeUtf8(config.toLower(cps.value(i)), encoded) : 0;
+    // Keep room for the trailing dot
+    if (length == 0 || word.byteCount + length + 1 > AUGMENTED_CAPACITY) {
+      word.byteCount = 0;
+      word.charCount = 0;
+      return;
     }
-    word.charByteOffsets.push_back(word.bytes.size());
-    encodeUtf8(config.toLower(info.value), word.bytes);
+    word.charByteOffsets[word.charCount++] = static_cast<uint8_t>(word.byteCount);
+    std::copy(encoded, encoded + length, word.bytes + word.byteCount);
+    word.byteCount += length;
   }
 
-  word.charByteOffsets.push_back(word.bytes.size());
-  word.bytes.push_back('.');
+  word.charByteOffsets[word.charCount++] = static_cast<uint8_t>(word.byteCount);
+  word.bytes[word.byteCount++] = '.';
 
-  word.byteToCharIndex.assign(word.bytes.size(), -1);
-  for (size_t i = 0; i < word.charByteOffsets.size(); ++i) {
+  std::fill(word.byteToCharIndex, word.byteToCharIndex + word.byteCount, NO_CHAR);
+  for (size_t i = 0; i < word.charCount; ++i) {
     const size_t offset = word.charByteOffsets[i];
-    if (offset < word.byteToCharIndex.size()) {
-      word.byteToCharIndex[offset] = static_cast<int32_t>(i);
+    if (offset < word.byteCount) {
+      word.byteToCharIndex[offset] = static_cast<uint8_t>(i);
     }
   }
-  return word;
 }
 
 // Decoded view of a single trie node pulled straight out of the serialized blob.
@@ -145,6 +159,9 @@ struct AutomatonState {
 
 // Interpret the node located at `addr`, returning transition metadata.
 AutomatonState decodeState(const EmbeddedAutomaton& automaton, size_t addr) {
+#ifdef LIANG_COUNT_NODE_VISITS
+  liangNodeVisits++;
+#endif
   AutomatonState state;
   if (addr >= automaton.size) {
     return state;
@@ -255,11 +272,9 @@ bool transition(const EmbeddedAutomaton& automaton, const AutomatonState& state,
 
 // Converts odd score positions back into codepoint indexes, honoring min prefix/suffix constraints.
 // Each break corresponds to scores[breakIndex + 1] because of the leading '.' sentinel.
-// Convert odd score entries into hyphen positions while honoring prefix/suffix limits.
-std::vector<size_t> collectBreakIndexes(const std::vector<CodepointInfo>& cps, const std::vector<uint8_t>& scores,
-                                        const size_t minPrefix, const size_t minSuffix) {
-  std::vector<size_t> indexes;
-  const size_t cpCount = cps.size();
+BreakIndexSet collectBreakIndexes(const size_t cpCount, const uint8_t* scores, const size_t scoreCount,
+                                  const size_t minPrefix, const size_t minSuffix) {
+  BreakIndexSet indexes;
   if (cpCount < 2) {
     return indexes;
   }
@@ -275,13 +290,13 @@ std::vector<size_t> collectBreakIndexes(const std::vector<CodepointInfo>& cps, c
     }
 
     const size_t scoreIdx = breakIndex + 1;
-    if (scoreIdx >= scores.size()) {
+    if (scoreIdx >= scoreCount) {
       break;
     }
     if ((scores[scoreIdx] & 1u) == 0) {
       continue;
     }
-    indexes.push_back(breakIndex);
+    indexes.set(breakIndex);
   }
 
   return indexes;
@@ -290,9 +305,10 @@ std::vector<size_t> collectBreakIndexes(const std::vector<CodepointInfo>& cps, c
 }  // namespace
 
 // Entry point that runs the full Liang pipeline for a single word.
-std::vector<size_t> liangBreakIndexes(const std::vector<CodepointInfo>& cps,
-                                      const SerializedHyphenationPatterns& patterns, const LiangWordConfig& config) {
-  const auto augmented = buildAugmentedWord(cps, config);
+BreakIndexSet liangBreakIndexes(const WordCodepoints& cps, const SerializedHyphenationPatterns& patterns,
+                                const LiangWordConfig& config) {
+  AugmentedWord& augmented = augmentedScratch;
+  buildAugmentedWord(cps, config, augmented);
   if (augmented.empty()) {
     return {};
   }
@@ -305,14 +321,15 @@ std::vector<size_t> liangBreakIndexes(const std::vector<CodepointInfo>& cps,
   }
 
   // Liang scores: one entry per augmented char (leading/trailing dots included).
-  std::vector<uint8_t> scores(augmented.charCount(), 0);
+  uint8_t* scores = scoresScratch;
+  std::fill(scores, scores + AUGMENTED_CAPACITY, 0);
 
   // Walk every starting character position and stream bytes through the trie.
-  for (size_t charStart = 0; charStart < augmented.charByteOffsets.size(); ++charStart) {
+  for (size_t charStart = 0; charStart < augmented.charCount; ++charStart) {
     const size_t byteStart = augmented.charByteOffsets[charStart];
     AutomatonState state = root;
 
-    for (size_t cursor = byteStart; cursor < augmented.bytes.size(); ++cursor) {
+    for (size_t cursor = byteStart; cursor < augmented.byteCount; ++cursor) {
       AutomatonState next;
       if (!transition(automaton, state, augmented.bytes[cursor], next)) {
         break;  // No more matches for this prefix.
@@ -329,27 +346,23 @@ std::vector<size_t> liangBreakIndexes(const std::vector<CodepointInfo>& cps,
 
           offset += dist;
           const size_t splitByte = byteStart + offset;
-          if (splitByte >= augmented.byteToCharIndex.size()) {
+          if (splitByte >= augmented.byteCount) {
             continue;
           }
 
-          const int32_t boundary = augmented.byteToCharIndex[splitByte];
-          if (boundary < 0) {
+          const uint8_t boundary = augmented.byteToCharIndex[splitByte];
+          if (boundary == NO_CHAR) {
             continue;  // Mid-codepoint byte, wait for the next one.
           }
-          if (boundary < 2 || boundary + 2 > static_cast<int32_t>(augmented.charCount())) {
+          if (boundary < 2 || boundary + 2u > augmented.charCount) {
             continue;  // Skip splits that land in the leading/trailing sentinels.
           }
 
-          const size_t idx = static_cast<size_t>(boundary);
-          if (idx >= scores.size()) {
-            continue;
-          }
-          scores[idx] = std::max(scores[idx], level);
+          scores[boundary] = std::max(scores[boundary], level);
         }
       }
     }
   }
 
-  return collectBreakIndexes(cps, scores, config.minPrefix, config.minSuffix);
+  return collectBreakIndexes(cps.size(), scores, augmented.charCount, config.minPrefix, config.minSuffix);
 }
@@ -1,8 +1,8 @@
 #pragma once
 
+#include <bitset>
 #include <cstddef>
 #include <cstdint>
-#include <vector>
 
 #include "HyphenationCommon.h"
 #include "SerializedHyphenationTrie.h"
@@ -33,6 +33,14 @@ struct LiangWordConfig {
       : isLetter(letterFn), toLower(lowerFn), minPrefix(prefix), minSuffix(suffix) {}
 };
 
-// Shared Liang pattern evaluator used by every language-specific hyphenator.
-std::vector<size_t> liangBreakIndexes(const std::vector<CodepointInfo>& cps,
-                                      const SerializedHyphenationPatterns& patterns, const LiangWordConfig& config);
+// Codepoint indexes a word may be broken before, one bit per index.
+using BreakIndexSet = std::bitset<MAX_HYPHENATION_WORD_BYTES>;
+
+// Shared Liang pattern evaluator used by every language-specific hyphenator. Works in fixed-size static buffers.
+BreakIndexSet liangBreakIndexes(const WordCodepoints& cps, const SerializedHyphenationPatterns& patterns,
+                                const LiangWordConfig& config);
+
+#ifdef LIANG_COUNT_NODE_VISITS
+// Trie nodes decoded so far, for the host benchmark in test/hyphenation_eval. Never compiled into the firmware.
+extern uint64_t liangNodeVisits;
+#endif
@@ -4,54 +4,144 @@
 #include <GfxRenderer.h>
 #include <HalStorage.h>
 #include <Logging.h>
+#include <Serialization.h>
+#include <ZipFile.h>
 #include <expat.h>
 
+#include <algorithm>
+#include <type_traits>
+
 #include "../../Epub.h"
 #include "../Page.h"
 #include "../converters/ImageDecoderFactory.h"
 #include "../converters/ImageToFramebufferDecoder.h"
 #include "../htmlEntities.h"
-
-const char* HEADER_TAGS[] = {"h1", "h2", "h3", "h4", "h5", "h6"};
-constexpr int NUM_HEADER_TAGS = sizeof(HEADER_TAGS) / sizeof(HEADER_TAGS[0]);
+#include "../hyphenation/HyphenationCommon.h"
 
 // Minimum file size (in bytes) to show indexing popup - smaller chapters don't benefit from it
 constexpr size_t MIN_SIZE_FOR_POPUP = 10 * 1024;  // 10KB
 
-const char* BLOCK_TAGS[] = {"p", "li", "div", "br", "blockquote"};
-constexpr int NUM_BLOCK_TAGS = sizeof(BLOCK_TAGS) / sizeof(BLOCK_TAGS[0]);
-
-const char* BOLD_TAGS[] = {"b", "strong"};
-constexpr int NUM_BOLD_TAGS = sizeof(BOLD_TAGS) / sizeof(BOLD_TAGS[0]);
-
-const char* ITALIC_TAGS[] = {"i", "em"};
-constexpr int NUM_ITALIC_TAGS = sizeof(ITALIC_TAGS) / sizeof(ITALIC_TAGS[0]);
-
-const char* UNDERLINE_TAGS[] = {"u", "ins"};
-constexpr int NUM_UNDERLINE_TAGS = sizeof(UNDERLINE_TAGS) / sizeof(UNDERLINE_TAGS[0]);
+// Bytes of chapter fed to expat per parseNextChunk() call
+constexpr int PARSE_CHUNK_SIZE = 1024;
+
+// Paragraphs longer than this are laid out early, keeping only their last line buffered. At roughly 16 bytes per
+// buffered word (ParsedText) plus up to 35 per word of line breaking scratch (pieces, costs, widths), this stays
+// around 60KB.
+constexpr size_t MAX_BUFFERED_WORDS = 1200;
+
+// Image sources are collected in a second pass (and extracted as one batch) only for chapters up to this size; picture
+// heavy chapters have small XHTML, and larger chapters are not worth inflating twice
+constexpr size_t MAX_SIZE_FOR_IMAGE_PREFETCH = 64 * 1024;  // 64KB
+
+// Flow file layout:
+//   u8 version | u8 CSS_CACHE_VERSION | bool embeddedStyle | u8 complete (patched to 1 once the whole chapter is
+//   recorded) | ops... | End
+// where each op is a FlowOp byte followed by
+//   Block:          FlowBlock kind, then for Css/Header the element's CssStyle (lengths unresolved)
+//   Word:           u8 font style (bit 7 set if attached to the previous word) | u8 length | bytes
+//   Image:          string cached image path | u16 width | u16 height (intrinsic size)
+//   SplitTextBlock: nothing, the text block was laid out early here to bound memory
+// Only embeddedStyle changes what gets recorded, everything else is applied when the flow is laid out.
+constexpr uint8_t FLOW_FILE_VERSION = 2;
+constexpr uint32_t FLOW_COMPLETE_OFFSET = sizeof(uint8_t) + sizeof(uint8_t) + sizeof(bool);
+constexpr uint8_t FLOW_WORD_CONTINUES = 0x80;
+static_assert(std::is_trivially_copyable<CssStyle>::value, "CssStyle is stored verbatim in flow files");
+static_assert(MAX_WORD_SIZE <= UINT8_MAX, "Flow files store word lengths in one byte");
+static_assert(MAX_WORD_SIZE + PARAGRAPH_INDENT_BYTES <= MAX_HYPHENATION_WORD_BYTES,
+              "An indented first word must still fit the hyphenator, or an overflowing one could not be split");
+
+// Flow ops replayed per parseNextChunk() call
+constexpr int FLOW_OPS_PER_CHUNK = 128;
+
+// What the parser does with an element, looked up once per start and end tag
+enum class TagKind : uint8_t {
+  Other,
+  Header,
+  Block,
+  LineBreak,
+  ListItem,
+  Bold,
+  Italic,
+  Underline,
+  Image,
+  Skip,
+  Table,
+};
+
+struct KnownTag {
+  const char* name;
+  TagKind kind;
+};
+
+constexpr KnownTag KNOWN_TAGS[] = {
+    {"h1", TagKind::Header},
+    {"h2", TagKind::Header},
+    {"h3", TagKind::Header},
+    {"h4", TagKind::Header},
+    {"h5", TagKind::Header},
+    {"h6", TagKind::Header},
+    {"p", TagKind::Block},
+    {"div", TagKind::Block},
+    {"blockquote", TagKind::Block},
+    {"br", TagKind::LineBreak},
+    {"li", TagKind::ListItem},
+    {"b", TagKind::Bold},
+    {"strong", TagKind::Bold},
+    {"i", TagKind::Italic},
+    {"em", TagKind::Italic},
+    {"u", TagKind::Underline},
+    {"ins", TagKind::Underline},
+    {"img", TagKind::Image},
+    {"head", TagKind::Skip},
+    {"table", TagKind::Table},
+};
+constexpr size_t MAX_KNOWN_TAG_LENGTH = 10;  // "blockquote"
+constexpr size_t TAG_SLOT_COUNT = 64;
+
+// Perfect hash over KNOWN_TAGS: length, first and last character tell them all apart (asserted below), so one strcmp
+// confirms a match
+constexpr size_t tagSlot(const char* name, const size_t length) {
+  return (length + static_cast<uint8_t>(name[0]) + 4 * static_cast<uint8_t>(name[length - 1])) & (TAG_SLOT_COUNT - 1);
+}
 
-const char* IMAGE_TAGS[] = {"img"};
-constexpr int NUM_IMAGE_TAGS = sizeof(IMAGE_TAGS) / sizeof(IMAGE_TAGS[0]);
+struct TagSlots {
+  int8_t knownTag[TAG_SLOT_COUNT];  // Index into KNOWN_TAGS, -1 if none
+  bool perfect;
+};
 
-const char* SKIP_TAGS[] = {"head"};
-constexpr int NUM_SKIP_TAGS = sizeof(SKIP_TAGS) / sizeof(SKIP_TAGS[0]);
+constexpr TagSlots buildTagSlots() {
+  TagSlots slots{};
+  for (auto& slot : slots.knownTag) {
+    slot = -1;
+  }
+  slots.perfect = true;
+  for (size_t i = 0; i < sizeof(KNOWN_TAGS) / sizeof(KNOWN_TAGS[0]); i++) {
+    const size_t length = std::char_traits<char>::length(KNOWN_TAGS[i].name);
+    int8_t& slot = slots.knownTag[tagSlot(KNOWN_TAGS[i].name, length)];
+    slots.perfect = slots.perfect && slot == -1 && length <= MAX_KNOWN_TAG_LENGTH;
+    slot = static_cast<int8_t>(i);
+  }
+  return slots;
+}
 
-bool isWhitespace(const char c) { return c == ' ' || c == '\r' || c == '\n' || c == '\t'; }
+constexpr TagSlots TAG_SLOTS = buildTagSlots();
+static_assert(TAG_SLOTS.perfect, "Known tag names collide in tagSlot, adjust its hash");
 
-// given the start and end of a tag, check to see if it matches a known tag
-bool matches(const char* tag_name, const char* possible_tags[], const int possible_tag_count) {
-  for (int i = 0; i < possible_tag_count; i++) {
-    if (strcmp(tag_name, possible_tags[i]) == 0) {
-      return true;
-    }
+TagKind tagKind(const char* name) {
+  const size_t length = strnlen(name, MAX_KNOWN_TAG_LENGTH + 1);
+  if (length == 0 || length > MAX_KNOWN_TAG_LENGTH) {
+    return TagKind::Other;
   }
-  return false;
+  const int8_t index = TAG_SLOTS.knownTag[tagSlot(name, length)];
+  return index >= 0 && strcmp(name, KNOWN_TAGS[index].name) == 0 ? KNOWN_TAGS[index].kind : TagKind::Other;
 }
 
-bool isHeaderOrBlock(const char* name) {
-  return matches(name, HEADER_TAGS, NUM_HEADER_TAGS) || matches(name, BLOCK_TAGS, NUM_BLOCK_TAGS);
+bool isHeaderOrBlock(const TagKind kind) {
+  return kind == TagKind::Header || kind == TagKind::Block || kind == TagKind::LineBreak || kind == TagKind::ListItem;
 }
 
+bool isWhitespace(const char c) { return c == ' ' || c == '\r' || c == '\n' || c == '\t'; }
+
 // Update effective bold/italic/underline based on block style and inline style stack
 void ChapterHtmlSlimParser::updateEffectiveInlineStyle() {
   // Start with block-level styles
@@ -95,7 +185,7 @@ void ChapterHtmlSlimParser::flushPartWordBuffer() {
 
   // flush the buffer
   partWordBuffer[partWordBufferIndex] = '\0';
-  currentTextBlock->addWord(partWordBuffer, fontStyle, false, nextWordContinues);
+  addWord(partWordBuffer, fontStyle, nextWordContinues);
   partWordBufferIndex = 0;
   nextWordContinues = false;
 }
@@ -115,7 +205,229 @@ void ChapterHtmlSlimParser::startNewTextBlock(const BlockStyle& blockStyle) {
 
     makePages();
   }
-  currentTextBlock.reset(new ParsedText(extraParagraphSpacing, hyphenationEnabled, blockStyle));
+  currentTextBlock.reset(new ParsedText(extraParagraphSpacing, hyphenationEnabled, blockStyle, &wordWidthCache));
+}
+
+BlockStyle ChapterHtmlSlimParser::resolveBlockStyle(const FlowBlock kind, const CssStyle& cssStyle) {
+  const float emSize = static_cast<float>(renderer.getLineHeight(fontId)) * lineCompression;
+  BlockStyle blockStyle;
+  switch (kind) {
+    case FlowBlock::Initial:
+      blockStyle.textAlignDefined = true;
+      // Resolve None sentinel to Justify for initial block (no CSS context yet)
+      blockStyle.alignment = (paragraphAlignment == static_cast<uint8_t>(CssTextAlign::None))
+                                 ? CssTextAlign::Justify
+                                 : static_cast<CssTextAlign>(paragraphAlignment);
+      break;
+    case FlowBlock::Css:
+      blockStyle =
+          BlockStyle::fromCssStyle(cssStyle, emSize, static_cast<CssTextAlign>(paragraphAlignment), viewportWidth);
+      break;
+    case FlowBlock::Header:
+      blockStyle = BlockStyle::fromCssStyle(cssStyle, emSize, CssTextAlign::Center, viewportWidth);
+      blockStyle.textAlignDefined = true;
+      if (embeddedStyle && cssStyle.hasTextAlign()) {
+        blockStyle.alignment = cssStyle.textAlign;
+      }
+      break;
+    case FlowBlock::Centered:
+      blockStyle.textAlignDefined = true;
+      blockStyle.alignment = CssTextAlign::Center;
+      break;
+    case FlowBlock::Repeat:
+      if (currentTextBlock) {
+        blockStyle = currentTextBlock->getBlockStyle();
+      }
+      break;
+  }
+  return blockStyle;
+}
+
+void ChapterHtmlSlimParser::beginBlock(const FlowBlock kind, const CssStyle& cssStyle) {
+  if (recordingFlow) {
+    serialization::writePod(flowFile, FlowOp::Block);
+    serialization::writePod(flowFile, kind);
+    if (kind == FlowBlock::Css || kind == FlowBlock::Header) {
+      serialization::writePod(flowFile, cssStyle);
+    }
+  }
+  startNewTextBlock(resolveBlockStyle(kind, cssStyle));
+}
+
+void ChapterHtmlSlimParser::addWord(const char* word, const EpdFontFamily::Style fontStyle,
+                                    const bool attachToPrevious) {
+  if (recordingFlow) {
+    const auto length = static_cast<uint8_t>(strlen(word));
+    serialization::writePod(flowFile, FlowOp::Word);
+    serialization::writePod(flowFile,
+                            static_cast<uint8_t>(fontStyle | (attachToPrevious ? FLOW_WORD_CONTINUES : 0)));
+    serialization::writePod(flowFile, length);
+    flowFile.write(reinterpret_cast<const uint8_t*>(word), length);
+  }
+  currentTextBlock->addWord(word, fontStyle, false, attachToPrevious);
+}
+
+void ChapterHtmlSlimParser::splitTextBlock() {
+  if (recordingFlow) {
+    serialization::writePod(flowFile, FlowOp::SplitTextBlock);
+  }
+  currentTextBlock->layoutAndExtractLines(
+      renderer, fontId, viewportWidth,
+      [this](const std::shared_ptr<TextBlock>& textBlock) { addLineToPage(textBlock); }, false);
+}
+
+bool ChapterHtmlSlimParser::placeImage(const std::string& cachedPath, const int width, const int height) {
+  if (recordingFlow) {
+    serialization::writePod(flowFile, FlowOp::Image);
+    serialization::writeString(flowFile, cachedPath);
+    serialization::writePod(flowFile, static_cast<uint16_t>(width));
+    serialization::writePod(flowFile, static_cast<uint16_t>(height));
+  }
+
+  // Scale to fit viewport while maintaining aspect ratio
+  int maxWidth = viewportWidth;
+  int maxHeight = viewportHeight;
+  float scaleX = (width > maxWidth) ? (float)maxWidth / width : 1.0f;
+  float scaleY = (height > maxHeight) ? (float)maxHeight / height : 1.0f;
+  float scale = (scaleX < scaleY) ? scaleX : scaleY;
+  if (scale > 1.0f) scale = 1.0f;
+
+  int displayWidth = (int)(width * scale);
+  int displayHeight = (int)(height * scale);
+
+  LOG_DBG("EHP", "Display size: %dx%d (scale %.2f)", displayWidth, displayHeight, scale);
+
+  // Create page for image - only break if image won't fit remaining space
+  if (currentPage && !currentPage->elements.empty() && (currentPageNextY + displayHeight > viewportHeight)) {
+    completePageFn(std::move(currentPage));
+    completedPageCount++;
+    currentPage.reset(new Page());
+    if (!currentPage) {
+      LOG_ERR("EHP", "Failed to create new page");
+      return false;
+    }
+    currentPageNextY = 0;
+  } else if (!currentPage) {
+    currentPage.reset(new Page());
+    if (!currentPage) {
+      LOG_ERR("EHP", "Failed to create initial page");
+      return false;
+    }
+    currentPageNextY = 0;
+  }
+
+  // Create ImageBlock and add to page
+  auto imageBlock = std::make_shared<ImageBlock>(cachedPath, displayWidth, displayHeight);
+  if (!imageBlock) {
+    LOG_ERR("EHP", "Failed to create ImageBlock");
+    return false;
+  }
+  int xPos = (viewportWidth - displayWidth) / 2;
+  auto pageImage = std::make_shared<PageImage>(imageBlock, xPos, currentPageNextY);
+  if (!pageImage) {
+    LOG_ERR("EHP", "Failed to create PageImage");
+    return false;
+  }
+  currentPage->elements.push_back(pageImage);
+  currentPageNextY += displayHeight;
+  return true;
+}
+
+// Create a unique filename for the cached image
+std::string ChapterHtmlSlimParser::nextCachedImagePath(const std::string& resolvedPath) {
+  std::string ext;
+  const size_t extPos = resolvedPath.rfind('.');
+  if (extPos != std::string::npos) {
+    ext = resolvedPath.substr(extPos);
+  }
+  return imageBasePath + std::to_string(imageCounter++) + ext;
+}
+
+void XMLCALL ChapterHtmlSlimParser::collectImageSource(void* userData, const XML_Char* name, const XML_Char** atts) {
+  auto* self = static_cast<ChapterHtmlSlimParser*>(userData);
+  if (tagKind(name) != TagKind::Image || atts == nullptr) {
+    return;
+  }
+
+  for (int i = 0; atts[i]; i += 2) {
+    if (strcmp(atts[i], "src") != 0 || atts[i + 1][0] == '\0') {
+      continue;
+    }
+    std::string resolvedPath = FsHelpers::normalisePath(self->contentBase + atts[i + 1]);
+    const bool seen = std::any_of(self->prefetchedImages.begin(), self->prefetchedImages.end(),
+                                  [&resolvedPath](const PrefetchedImage& image) { return image.href == resolvedPath; });
+    if (!seen) {
+      std::string cachedPath = self->nextCachedImagePath(resolvedPath);
+      self->prefetchedImages.push_back({std::move(resolvedPath), std::move(cachedPath), false});
+    }
+    return;
+  }
+}
+
+// Extracting images one at a time from startElement reopens the zip, looks the entry up and seeks for each one.
+// For small chapters, collect the remaining sources once the first page is out and extract them in one forward pass
+// over the zip instead. Images on the first page, and any this misses (e.g. after a parse error), still go through
+// the per-image path.
+void ChapterHtmlSlimParser::prefetchImages() {
+  ZipFile zip(epub->getPath(), epub->getZipIndexPath(), epub->getInflateContext(), epub->getNestedInflateContext());
+  ZipEntryReader reader(zip);
+  if (!reader.open(FsHelpers::normalisePath(itemHref).c_str())) {
+    return;
+  }
+  const size_t firstNew = prefetchedImages.size();
+
+  const XML_Parser parser = XML_ParserCreate(nullptr);
+  if (!parser) {
+    return;
+  }
+  XML_SetUserData(parser, this);
+  XML_SetStartElementHandler(parser, collectImageSource);
+  XML_SetDefaultHandlerExpand(parser, [](void*, const XML_Char*, int) {});
+
+  bool done = false;
+  while (!done) {
+    void* const buf = XML_GetBuffer(parser, 1024);
+    const int len = buf ? reader.read(buf, 1024) : -1;
+    if (len < 0 || (len == 0 && reader.available() > 0)) {
+      break;
+    }
+    done = reader.available() == 0;
+    if (XML_ParseBuffer(parser, len, done) == XML_STATUS_ERROR) {
+      break;
+    }
+  }
+  XML_ParserFree(parser);
+  reader.close();
+
+  if (prefetchedImages.size() == firstNew) {
+    return;
+  }
+
+  std::vector<std::string> hrefs;
+  hrefs.reserve(prefetchedImages.size() - firstNew);
+  for (size_t i = firstNew; i < prefetchedImages.size(); i++) {
+    hrefs.push_back(prefetchedImages[i].href);
+  }
+
+  FsFile cachedImageFile;
+  const int extracted = epub->readItemContentsToStreams(
+      hrefs, 4096,
+      [this, firstNew, &cachedImageFile](const size_t i) -> Print* {
+        return Storage.openFileForWrite("EHP", prefetchedImages[firstNew + i].cachedPath, cachedImageFile)
+                   ? &cachedImageFile
+                   : nullptr;
+      },
+      [this, firstNew, &cachedImageFile](const size_t i, const bool success) {
+        if (cachedImageFile) {
+          cachedImageFile.flush();
+          cachedImageFile.close();
+        }
+        prefetchedImages[firstNew + i].extracted = success;
+        if (!success) {
+          LOG_ERR("EHP", "Failed to extract image %s", prefetchedImages[firstNew + i].href.c_str());
+        }
+      });
+  LOG_DBG("EHP", "Prefetched %d of %d images", extracted, static_cast<int>(hrefs.size()));
 }
 
 void XMLCALL ChapterHtmlSlimParser::startElement(void* userData, const XML_Char* name, const XML_Char** atts) {
@@ -127,9 +439,9 @@ void XMLCALL ChapterHtmlSlimParser::startElement(void* userData, const XML_Char*
     return;
   }
 
-  // Extract class and style attributes for CSS processing
-  std::string classAttr;
-  std::string styleAttr;
+  // Class and style attributes for CSS processing, viewed in place (expat keeps them alive for this callback)
+  std::string_view classAttr;
+  std::string_view styleAttr;
   if (atts != nullptr) {
     for (int i = 0; atts[i]; i += 2) {
       if (strcmp(atts[i], "class") == 0) {
@@ -139,15 +451,17 @@ void XMLCALL ChapterHtmlSlimParser::startElement(void* userData, const XML_Char*
       }
     }
   }
+  // Recorded before anything can return early, so deeper elements always see their true ancestors
+  if (self->cssParser && self->cssParser->hasAncestorSelectors()) {
+    self->cssElementStack.enter(self->depth, name, classAttr);
+  }
 
-  auto centeredBlockStyle = BlockStyle();
-  centeredBlockStyle.textAlignDefined = true;
-  centeredBlockStyle.alignment = CssTextAlign::Center;
+  const TagKind kind = tagKind(name);
 
   // Special handling for tables - show placeholder text instead of dropping silently
-  if (strcmp(name, "table") == 0) {
+  if (kind == TagKind::Table) {
     // Add placeholder text
-    self->startNewTextBlock(centeredBlockStyle);
+    self->beginBlock(FlowBlock::Centered);
 
     self->italicUntilDepth = min(self->italicUntilDepth, self->depth);
     // Advance depth before processing character data (like you would for an element with text)
@@ -159,7 +473,7 @@ void XMLCALL ChapterHtmlSlimParser::startElement(void* userData, const XML_Char*
     return;
   }
 
-  if (matches(name, IMAGE_TAGS, NUM_IMAGE_TAGS)) {
+  if (kind == TagKind::Image) {
     std::string src;
     std::string alt;
     if (atts != nullptr) {
@@ -178,22 +492,31 @@ void XMLCALL ChapterHtmlSlimParser::startElement(void* userData, const XML_Char*
           // Resolve the image path relative to the HTML file
           std::string resolvedPath = FsHelpers::normalisePath(self->contentBase + src);
 
-          // Create a unique filename for the cached image
-          std::string ext;
-          size_t extPos = resolvedPath.rfind('.');
-          if (extPos != std::string::npos) {
-            ext = resolvedPath.substr(extPos);
-          }
-          std::string cachedImagePath = self->imageBasePath + std::to_string(self->imageCounter++) + ext;
-
-          // Extract image to cache file
-          FsFile cachedImageFile;
+          std::string cachedImagePath;
           bool extractSuccess = false;
-          if (Storage.openFileForWrite("EHP", cachedImagePath, cachedImageFile)) {
-            extractSuccess = self->epub->readItemContentsToStream(resolvedPath, cachedImageFile, 4096);
-            cachedImageFile.flush();
-            cachedImageFile.close();
-            delay(50);  // Give SD card time to sync
+          const auto found =
+              std::find_if(self->prefetchedImages.begin(), self->prefetchedImages.end(),
+                           [&resolvedPath](const PrefetchedImage& image) { return image.href == resolvedPath; });
+          PrefetchedImage* prefetched = found != self->prefetchedImages.end() ? &*found : nullptr;
+          if (prefetched) {
+            cachedImagePath = prefetched->cachedPath;
+            extractSuccess = prefetched->extracted;
+          } else {
+            cachedImagePath = self->nextCachedImagePath(resolvedPath);
+
+            // Extract image to cache file
+            FsFile cachedImageFile;
+            if (Storage.openFileForWrite("EHP", cachedImagePath, cachedImageFile)) {
+              extractSuccess = self->epub->readItemContentsToStream(resolvedPath, cachedImageFile, 4096);
+              cachedImageFile.flush();
+              cachedImageFile.close();
+              delay(50);  // Give SD card time to sync
+            }
+            if (extractSuccess) {
+              // Later references, and the batch pass, reuse this copy
+              self->prefetchedImages.push_back({resolvedPath, cachedImagePath, true});
+              prefetched = &self->prefetchedImages.back();
+            }
           }
 
           if (extractSuccess) {
@@ -203,58 +526,18 @@ void XMLCALL ChapterHtmlSlimParser::startElement(void* userData, const XML_Char*
             if (decoder && decoder->getDimensions(cachedImagePath, dims)) {
               LOG_DBG("EHP", "Image dimensions: %dx%d", dims.width, dims.height);
 
-              // Scale to fit viewport while maintaining aspect ratio
-              int maxWidth = self->viewportWidth;
-              int maxHeight = self->viewportHeight;
-              float scaleX = (dims.width > maxWidth) ? (float)maxWidth / dims.width : 1.0f;
-              float scaleY = (dims.height > maxHeight) ? (float)maxHeight / dims.height : 1.0f;
-              float scale = (scaleX < scaleY) ? scaleX : scaleY;
-              if (scale > 1.0f) scale = 1.0f;
-
-              int displayWidth = (int)(dims.width * scale);
-              int displayHeight = (int)(dims.height * scale);
-
-              LOG_DBG("EHP", "Display size: %dx%d (scale %.2f)", displayWidth, displayHeight, scale);
-
-              // Create page for image - only break if image won't fit remaining space
-              if (self->currentPage && !self->currentPage->elements.empty() &&
-                  (self->currentPageNextY + displayHeight > self->viewportHeight)) {
-                self->completePageFn(std::move(self->currentPage));
-                self->currentPage.reset(new Page());
-                if (!self->currentPage) {
-                  LOG_ERR("EHP", "Failed to create new page");
-                  return;
-                }
-                self->currentPageNextY = 0;
-              } else if (!self->currentPage) {
-                self->currentPage.reset(new Page());
-                if (!self->currentPage) {
-                  LOG_ERR("EHP", "Failed to create initial page");
-                  return;
-                }
-                self->currentPageNextY = 0;
-              }
-
-              // Create ImageBlock and add to page
-              auto imageBlock = std::make_shared<ImageBlock>(cachedImagePath, displayWidth, displayHeight);
-              if (!imageBlock) {
-                LOG_ERR("EHP", "Failed to create ImageBlock");
+              if (!self->placeImage(cachedImagePath, dims.width, dims.height)) {
                 return;
               }
-              int xPos = (self->viewportWidth - displayWidth) / 2;
-              auto pageImage = std::make_shared<PageImage>(imageBlock, xPos, self->currentPageNextY);
-              if (!pageImage) {
-                LOG_ERR("EHP", "Failed to create PageImage");
-                return;
-              }
-              self->currentPage->elements.push_back(pageImage);
-              self->currentPageNextY += displayHeight;
 
               self->depth += 1;
               return;
             } else {
               LOG_ERR("EHP", "Failed to get image dimensions");
               Storage.remove(cachedImagePath.c_str());
+              if (prefetched) {
+                prefetched->extracted = false;
+              }
             }
           } else {
             LOG_ERR("EHP", "Failed to extract image");
@@ -265,7 +548,7 @@ void XMLCALL ChapterHtmlSlimParser::startElement(void* userData, const XML_Char*
       // Fallback to alt text if image processing fails
       if (!alt.empty()) {
         alt = "[Image: " + alt + "]";
-        self->startNewTextBlock(centeredBlockStyle);
+        self->beginBlock(FlowBlock::Centered);
         self->italicUntilDepth = std::min(self->italicUntilDepth, self->depth);
         self->depth += 1;
         self->characterData(userData, alt.c_str(), alt.length());
@@ -281,7 +564,7 @@ void XMLCALL ChapterHtmlSlimParser::startElement(void* userData, const XML_Char*
     }
   }
 
-  if (matches(name, SKIP_TAGS, NUM_SKIP_TAGS)) {
+  if (kind == TagKind::Skip) {
     // start skip
     self->skipUntilDepth = self->depth;
     self->depth += 1;
@@ -303,8 +586,16 @@ void XMLCALL ChapterHtmlSlimParser::startElement(void* userData, const XML_Char*
   // Compute CSS style for this element
   CssStyle cssStyle;
   if (self->cssParser) {
-    // Get combined tag + class styles
-    cssStyle = self->cssParser->resolveStyle(name, classAttr);
+    // Get combined tag + class styles, resolved once per distinct combination
+    const auto styleKey = CssStyleCache::keyOf(name, classAttr);
+    if (!self->cssStyleCache.lookup(styleKey, cssStyle)) {
+      bool ancestorDependent = false;
+      cssStyle = self->cssParser->resolveStyle(name, classAttr, self->cssElementStack, ancestorDependent);
+      // Styles that depend on where the element sits are resolved every time
+      if (!ancestorDependent) {
+        self->cssStyleCache.insert(styleKey, cssStyle);
+      }
+    }
     // Merge inline style (highest priority)
     if (!styleAttr.empty()) {
       CssStyle inlineStyle = CssParser::parseInlineStyle(styleAttr);
@@ -312,37 +603,26 @@ void XMLCALL ChapterHtmlSlimParser::startElement(void* userData, const XML_Char*
     }
   }
 
-  const float emSize = static_cast<float>(self->renderer.getLineHeight(self->fontId)) * self->lineCompression;
-  const auto userAlignmentBlockStyle = BlockStyle::fromCssStyle(
-      cssStyle, emSize, static_cast<CssTextAlign>(self->paragraphAlignment), self->viewportWidth);
-
-  if (matches(name, HEADER_TAGS, NUM_HEADER_TAGS)) {
+  if (kind == TagKind::Header) {
     self->currentCssStyle = cssStyle;
-    auto headerBlockStyle = BlockStyle::fromCssStyle(cssStyle, emSize, CssTextAlign::Center, self->viewportWidth);
-    headerBlockStyle.textAlignDefined = true;
-    if (self->embeddedStyle && cssStyle.hasTextAlign()) {
-      headerBlockStyle.alignment = cssStyle.textAlign;
-    }
-    self->startNewTextBlock(headerBlockStyle);
+    self->beginBlock(FlowBlock::Header, cssStyle);
     self->boldUntilDepth = std::min(self->boldUntilDepth, self->depth);
     self->updateEffectiveInlineStyle();
-  } else if (matches(name, BLOCK_TAGS, NUM_BLOCK_TAGS)) {
-    if (strcmp(name, "br") == 0) {
-      if (self->partWordBufferIndex > 0) {
-        // flush word preceding <br/> to currentTextBlock before calling startNewTextBlock
-        self->flushPartWordBuffer();
-      }
-      self->startNewTextBlock(self->currentTextBlock->getBlockStyle());
-    } else {
-      self->currentCssStyle = cssStyle;
-      self->startNewTextBlock(userAlignmentBlockStyle);
-      self->updateEffectiveInlineStyle();
+  } else if (kind == TagKind::LineBreak) {
+    if (self->partWordBufferIndex > 0) {
+      // flush word preceding <br/> to currentTextBlock before calling startNewTextBlock
+      self->flushPartWordBuffer();
+    }
+    self->beginBlock(FlowBlock::Repeat);
+  } else if (kind == TagKind::Block || kind == TagKind::ListItem) {
+    self->currentCssStyle = cssStyle;
+    self->beginBlock(FlowBlock::Css, cssStyle);
+    self->updateEffectiveInlineStyle();
 
-      if (strcmp(name, "li") == 0) {
-        self->currentTextBlock->addWord("\xe2\x80\xa2", EpdFontFamily::REGULAR);
-      }
+    if (kind == TagKind::ListItem) {
+      self->addWord("\xe2\x80\xa2", EpdFontFamily::REGULAR, false);
     }
-  } else if (matches(name, UNDERLINE_TAGS, NUM_UNDERLINE_TAGS)) {
+  } else if (kind == TagKind::Underline) {
     // Flush buffer before style change so preceding text gets current style
     if (self->partWordBufferIndex > 0) {
       self->flushPartWordBuffer();
@@ -364,7 +644,7 @@ void XMLCALL ChapterHtmlSlimParser::startElement(void* userData, const XML_Char*
     }
     self->inlineStyleStack.push_back(entry);
     self->updateEffectiveInlineStyle();
-  } else if (matches(name, BOLD_TAGS, NUM_BOLD_TAGS)) {
+  } else if (kind == TagKind::Bold) {
     // Flush buffer before style change so preceding text gets current style
     if (self->partWordBufferIndex > 0) {
       self->flushPartWordBuffer();
@@ -386,7 +666,7 @@ void XMLCALL ChapterHtmlSlimParser::startElement(void* userData, const XML_Char*
     }
     self->inlineStyleStack.push_back(entry);
     self->updateEffectiveInlineStyle();
-  } else if (matches(name, ITALIC_TAGS, NUM_ITALIC_TAGS)) {
+  } else if (kind == TagKind::Italic) {
     // Flush buffer before style change so preceding text gets current style
     if (self->partWordBufferIndex > 0) {
       self->flushPartWordBuffer();
@@ -408,7 +688,7 @@ void XMLCALL ChapterHtmlSlimParser::startElement(void* userData, const XML_Char*
     }
     self->inlineStyleStack.push_back(entry);
     self->updateEffectiveInlineStyle();
-  } else if (strcmp(name, "span") == 0 || !isHeaderOrBlock(name)) {
+  } else {
     // Handle span and other inline elements for CSS styling
     if (cssStyle.hasFontWeight() || cssStyle.hasFontStyle() || cssStyle.hasTextDecoration()) {
       // Flush buffer before style change so preceding text gets current style
@@ -503,15 +783,13 @@ void XMLCALL ChapterHtmlSlimParser::characterData(void* userData, const XML_Char
     self->partWordBuffer[self->partWordBufferIndex++] = s[i];
   }
 
-  // If we have > 750 words buffered up, perform the layout and consume out all but the last line
-  // There should be enough here to build out 1-2 full pages and doing this will free up a lot of
+  // If we have too many words buffered up, perform the layout and consume out all but the last line
+  // There should be enough here to build out several full pages and doing this will free up a lot of
   // memory.
   // Spotted when reading Intermezzo, there are some really long text blocks in there.
-  if (self->currentTextBlock->size() > 750) {
+  if (self->currentTextBlock->size() > MAX_BUFFERED_WORDS) {
     LOG_DBG("EHP", "Text block too long, splitting into multiple pages");
-    self->currentTextBlock->layoutAndExtractLines(
-        self->renderer, self->fontId, self->viewportWidth,
-        [self](const std::shared_ptr<TextBlock>& textBlock) { self->addLineToPage(textBlock); }, false);
+    self->splitTextBlock();
   }
 }
 
@@ -544,17 +822,17 @@ void XMLCALL ChapterHtmlSlimParser::endElement(void* userData, const XML_Char* n
   const bool willClearUnderline = self->underlineUntilDepth == self->depth - 1;
 
   const bool styleWillChange = willPopStyleStack || willClearBold || willClearItalic || willClearUnderline;
-  const bool headerOrBlockTag = isHeaderOrBlock(name);
+  const TagKind kind = tagKind(name);
+  const bool headerOrBlockTag = isHeaderOrBlock(kind);
 
   // Flush buffer with current style BEFORE any style changes
   if (self->partWordBufferIndex > 0) {
     // Flush if style will change OR if we're closing a block/structural element
-    const bool isInlineTag = !headerOrBlockTag && strcmp(name, "table") != 0 &&
-                             !matches(name, IMAGE_TAGS, NUM_IMAGE_TAGS) && self->depth != 1;
-    const bool shouldFlush = styleWillChange || headerOrBlockTag || matches(name, BOLD_TAGS, NUM_BOLD_TAGS) ||
-                             matches(name, ITALIC_TAGS, NUM_ITALIC_TAGS) ||
-                             matches(name, UNDERLINE_TAGS, NUM_UNDERLINE_TAGS) || strcmp(name, "table") == 0 ||
-                             matches(name, IMAGE_TAGS, NUM_IMAGE_TAGS) || self->depth == 1;
+    const bool isInlineTag =
+        !headerOrBlockTag && kind != TagKind::Table && kind != TagKind::Image && self->depth != 1;
+    const bool shouldFlush = styleWillChange || headerOrBlockTag || kind == TagKind::Bold || kind == TagKind::Italic ||
+                             kind == TagKind::Underline || kind == TagKind::Table || kind == TagKind::Image ||
+                             self->depth == 1;
 
     if (shouldFlush) {
       self->flushPartWordBuffer();
@@ -601,95 +879,264 @@ void XMLCALL ChapterHtmlSlimParser::endElement(void* userData, const XML_Char* n
   }
 }
 
-bool ChapterHtmlSlimParser::parseAndBuildPages() {
-  auto paragraphAlignmentBlockStyle = BlockStyle();
-  paragraphAlignmentBlockStyle.textAlignDefined = true;
-  // Resolve None sentinel to Justify for initial block (no CSS context yet)
-  const auto align = (this->paragraphAlignment == static_cast<uint8_t>(CssTextAlign::None))
-                         ? CssTextAlign::Justify
-                         : static_cast<CssTextAlign>(this->paragraphAlignment);
-  paragraphAlignmentBlockStyle.alignment = align;
-  startNewTextBlock(paragraphAlignmentBlockStyle);
+ChapterHtmlSlimParser::~ChapterHtmlSlimParser() {
+  freeXmlParser();
+  if (flowFile) {
+    flowFile.close();
+  }
+  if (recordingFlow) {
+    // Never got to the end of the chapter
+    Storage.remove(flowPath.c_str());
+  }
+}
 
-  const XML_Parser parser = XML_ParserCreate(nullptr);
-  int done;
+void ChapterHtmlSlimParser::freeXmlParser() {
+  if (xmlParser) {
+    XML_StopParser(xmlParser, XML_FALSE);                // Stop any pending processing
+    XML_SetElementHandler(xmlParser, nullptr, nullptr);  // Clear callbacks
+    XML_SetCharacterDataHandler(xmlParser, nullptr);
+    XML_ParserFree(xmlParser);
+    xmlParser = nullptr;
+  }
+  if (reader) {
+    reader->close();
+    reader.reset();
+  }
+  zip.reset();
+}
 
-  if (!parser) {
+bool ChapterHtmlSlimParser::hasFlowFile(const std::string& flowPath, const bool embeddedStyle) {
+  FsFile file;
+  if (flowPath.empty() || !Storage.exists(flowPath.c_str()) || !Storage.openFileForRead("EHP", flowPath, file)) {
+    return false;
+  }
+  uint8_t header[FLOW_COMPLETE_OFFSET + 1] = {};
+  const bool valid = file.read(header, sizeof(header)) == sizeof(header) && header[0] == FLOW_FILE_VERSION &&
+                     header[1] == CSS_CACHE_VERSION && header[2] == static_cast<uint8_t>(embeddedStyle) &&
+                     header[FLOW_COMPLETE_OFFSET] == 1;
+  file.close();
+  return valid;
+}
+
+bool ChapterHtmlSlimParser::beginFlowReplay() {
+  if (!Storage.openFileForRead("EHP", flowPath, flowFile)) {
+    return false;
+  }
+  flowFile.seek(FLOW_COMPLETE_OFFSET + 1);
+  replayingFlow = true;
+  parsingComplete = false;
+  LOG_DBG("EHP", "Laying out %s from its flow file", itemHref.c_str());
+  return true;
+}
+
+bool ChapterHtmlSlimParser::replayFlowOps() {
+  for (int i = 0; i < FLOW_OPS_PER_CHUNK; i++) {
+    FlowOp op;
+    if (flowFile.read(reinterpret_cast<uint8_t*>(&op), sizeof(op)) != sizeof(op)) {
+      LOG_ERR("EHP", "Flow file ended early");
+      return false;
+    }
+
+    switch (op) {
+      case FlowOp::Block: {
+        FlowBlock kind;
+        CssStyle cssStyle;
+        serialization::readPod(flowFile, kind);
+        if (kind == FlowBlock::Css || kind == FlowBlock::Header) {
+          serialization::readPod(flowFile, cssStyle);
+        }
+        beginBlock(kind, cssStyle);
+        break;
+      }
+      case FlowOp::Word: {
+        uint8_t flags;
+        uint8_t length;
+        serialization::readPod(flowFile, flags);
+        serialization::readPod(flowFile, length);
+        if (length > MAX_WORD_SIZE || flowFile.read(partWordBuffer, length) != length) {
+          LOG_ERR("EHP", "Bad word in flow file");
+          return false;
+        }
+        partWordBuffer[length] = '\0';
+        addWord(partWordBuffer, static_cast<EpdFontFamily::Style>(flags & ~FLOW_WORD_CONTINUES),
+                (flags & FLOW_WORD_CONTINUES) != 0);
+        break;
+      }
+      case FlowOp::Image: {
+        std::string cachedPath;
+        uint16_t width;
+        uint16_t height;
+        serialization::readString(flowFile, cachedPath);
+        serialization::readPod(flowFile, width);
+        serialization::readPod(flowFile, height);
+        if (!Storage.exists(cachedPath.c_str())) {
+          LOG_ERR("EHP", "Cached image %s is gone", cachedPath.c_str());
+          return false;
+        }
+        placeImage(cachedPath, width, height);
+        break;
+      }
+      case FlowOp::SplitTextBlock:
+        splitTextBlock();
+        break;
+      case FlowOp::End:
+        flowFile.close();
+        replayingFlow = false;
+        finishPages();
+        parsingComplete = true;
+        return true;
+      default:
+        LOG_ERR("EHP", "Unknown flow op %u", static_cast<uint8_t>(op));
+        return false;
+    }
+  }
+  return true;
+}
+
+void ChapterHtmlSlimParser::finishFlowRecording() {
+  if (!recordingFlow) {
+    return;
+  }
+  serialization::writePod(flowFile, FlowOp::End);
+  flowFile.seek(FLOW_COMPLETE_OFFSET);
+  serialization::writePod(flowFile, static_cast<uint8_t>(1));
+  flowFile.close();
+  recordingFlow = false;
+}
+
+void ChapterHtmlSlimParser::finishPages() {
+  // Process last page if there is still text
+  if (currentTextBlock) {
+    makePages();
+    completePageFn(std::move(currentPage));
+    completedPageCount++;
+    currentPage.reset();
+    currentTextBlock.reset();
+  }
+  LOG_DBG("EHP", "Word width cache: %lu hits, %lu misses", static_cast<unsigned long>(wordWidthCache.getHits()),
+          static_cast<unsigned long>(wordWidthCache.getMisses()));
+  LOG_DBG("EHP", "CSS style cache: %lu hits, %lu misses", static_cast<unsigned long>(cssStyleCache.getHits()),
+          static_cast<unsigned long>(cssStyleCache.getMisses()));
+}
+
+bool ChapterHtmlSlimParser::beginParsing() {
+  // A flow recorded by an earlier build skips inflating, XML parsing and CSS resolution entirely
+  if (hasFlowFile(flowPath, embeddedStyle) && beginFlowReplay()) {
+    return true;
+  }
+
+  if (!flowPath.empty()) {
+    recordingFlow = Storage.openFileForWrite("EHP", flowPath, flowFile);
+    if (recordingFlow) {
+      serialization::writePod(flowFile, FLOW_FILE_VERSION);
+      serialization::writePod(flowFile, CSS_CACHE_VERSION);
+      serialization::writePod(flowFile, embeddedStyle);
+      serialization::writePod(flowFile, static_cast<uint8_t>(0));  // Placeholder for complete flag
+    }
+  }
+
+  beginBlock(FlowBlock::Initial);
+
+  xmlParser = XML_ParserCreate(nullptr);
+  if (!xmlParser) {
     LOG_ERR("EHP", "Couldn't allocate memory for parser");
     return false;
   }
 
   // Handle HTML entities (like &nbsp;) that aren't in XML spec or DTD
   // Using DefaultHandlerExpand preserves normal entity expansion from DOCTYPE
-  XML_SetDefaultHandlerExpand(parser, defaultHandlerExpand);
-
-  FsFile file;
-  if (!Storage.openFileForRead("EHP", filepath, file)) {
-    XML_ParserFree(parser);
+  XML_SetDefaultHandlerExpand(xmlParser, defaultHandlerExpand);
+
+  // Inflate the spine item straight into expat's buffer rather than staging it on the SD card
+  zip.reset(new ZipFile(epub->getPath(), epub->getZipIndexPath(), epub->getInflateContext(),
+                        epub->getNestedInflateContext()));
+  reader.reset(new ZipEntryReader(*zip));
+  if (!reader->open(FsHelpers::normalisePath(itemHref).c_str())) {
+    LOG_ERR("EHP", "Could not open %s for reading", itemHref.c_str());
+    freeXmlParser();
     return false;
   }
 
-  // Get file size to decide whether to show indexing popup.
-  if (popupFn && file.size() >= MIN_SIZE_FOR_POPUP) {
+  // Get item size to decide whether to show indexing popup.
+  if (popupFn && reader->size() >= MIN_SIZE_FOR_POPUP) {
     popupFn();
   }
+  imagePrefetchPending = reader->size() <= MAX_SIZE_FOR_IMAGE_PREFETCH;
 
-  XML_SetUserData(parser, this);
-  XML_SetElementHandler(parser, startElement, endElement);
-  XML_SetCharacterDataHandler(parser, characterData);
+  XML_SetUserData(xmlParser, this);
+  XML_SetElementHandler(xmlParser, startElement, endElement);
+  XML_SetCharacterDataHandler(xmlParser, characterData);
+  parsingComplete = false;
+  return true;
+}
 
-  do {
-    void* const buf = XML_GetBuffer(parser, 1024);
-    if (!buf) {
-      LOG_ERR("EHP", "Couldn't allocate memory for buffer");
-      XML_StopParser(parser, XML_FALSE);                // Stop any pending processing
-      XML_SetElementHandler(parser, nullptr, nullptr);  // Clear callbacks
-      XML_SetCharacterDataHandler(parser, nullptr);
-      XML_ParserFree(parser);
-      file.close();
-      return false;
+bool ChapterHtmlSlimParser::parseNextChunk() {
+  if (replayingFlow) {
+    if (replayFlowOps()) {
+      return true;
     }
+    // Drop the flow so the next build parses the chapter again, extracting missing images anew
+    flowFile.close();
+    replayingFlow = false;
+    Storage.remove(flowPath.c_str());
+    return false;
+  }
 
-    const size_t len = file.read(buf, 1024);
+  if (!xmlParser) {
+    LOG_ERR("EHP", "parseNextChunk called without an active parser");
+    return false;
+  }
 
-    if (len == 0 && file.available() > 0) {
-      LOG_ERR("EHP", "File read error");
-      XML_StopParser(parser, XML_FALSE);                // Stop any pending processing
-      XML_SetElementHandler(parser, nullptr, nullptr);  // Clear callbacks
-      XML_SetCharacterDataHandler(parser, nullptr);
-      XML_ParserFree(parser);
-      file.close();
-      return false;
-    }
+  // Deferred until the first page is out so it never delays what the reader is waiting for
+  if (imagePrefetchPending && completedPageCount > 0) {
+    imagePrefetchPending = false;
+    prefetchImages();
+  }
+
+  void* const buf = XML_GetBuffer(xmlParser, PARSE_CHUNK_SIZE);
+  if (!buf) {
+    LOG_ERR("EHP", "Couldn't allocate memory for buffer");
+    freeXmlParser();
+    return false;
+  }
 
-    done = file.available() == 0;
+  const int len = reader->read(buf, PARSE_CHUNK_SIZE);
 
-    if (XML_ParseBuffer(parser, static_cast<int>(len), done) == XML_STATUS_ERROR) {
-      LOG_ERR("EHP", "Parse error at line %lu:\n%s", XML_GetCurrentLineNumber(parser),
-              XML_ErrorString(XML_GetErrorCode(parser)));
-      XML_StopParser(parser, XML_FALSE);                // Stop any pending processing
-      XML_SetElementHandler(parser, nullptr, nullptr);  // Clear callbacks
-      XML_SetCharacterDataHandler(parser, nullptr);
-      XML_ParserFree(parser);
-      file.close();
-      return false;
-    }
-  } while (!done);
+  if (len < 0 || (len == 0 && reader->available() > 0)) {
+    LOG_ERR("EHP", "File read error");
+    freeXmlParser();
+    return false;
+  }
 
-  XML_StopParser(parser, XML_FALSE);                // Stop any pending processing
-  XML_SetElementHandler(parser, nullptr, nullptr);  // Clear callbacks
-  XML_SetCharacterDataHandler(parser, nullptr);
-  XML_ParserFree(parser);
-  file.close();
+  const bool done = reader->available() == 0;
 
-  // Process last page if there is still text
-  if (currentTextBlock) {
-    makePages();
-    completePageFn(std::move(currentPage));
-    currentPage.reset();
-    currentTextBlock.reset();
+  if (XML_ParseBuffer(xmlParser, len, done) == XML_STATUS_ERROR) {
+    LOG_ERR("EHP", "Parse error at line %lu:\n%s", XML_GetCurrentLineNumber(xmlParser),
+            XML_ErrorString(XML_GetErrorCode(xmlParser)));
+    freeXmlParser();
+    return false;
+  }
+
+  if (!done) {
+    return true;
   }
 
+  freeXmlParser();
+  finishPages();
+  finishFlowRecording();
+  parsingComplete = true;
+  return true;
+}
+
+bool ChapterHtmlSlimParser::parseAndBuildPages() {
+  if (!beginParsing()) {
+    return false;
+  }
+  while (!parsingComplete) {
+    if (!parseNextChunk()) {
+      return false;
+    }
+  }
   return true;
 }
 
@@ -698,6 +1145,7 @@ void ChapterHtmlSlimParser::addLineToPage(std::shared_ptr<TextBlock> line) {
 
   if (currentPageNextY + lineHeight > viewportHeight) {
     completePageFn(std::move(currentPage));
+    completedPageCount++;
     currentPage.reset(new Page());
     currentPageNextY = 0;
   }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <HalStorage.h>
 #include <expat.h>
 
 #include <climits>
@@ -7,20 +8,25 @@
 #include <memory>
 
 #include "../ParsedText.h"
+#include "../WordWidthCache.h"
 #include "../blocks/ImageBlock.h"
 #include "../blocks/TextBlock.h"
+#include "../css/CssElementStack.h"
 #include "../css/CssParser.h"
 #include "../css/CssStyle.h"
+#include "../css/CssStyleCache.h"
 
 class Page;
 class GfxRenderer;
 class Epub;
+class ZipFile;
+class ZipEntryReader;
 
 #define MAX_WORD_SIZE 200
 
 class ChapterHtmlSlimParser {
   std::shared_ptr<Epub> epub;
-  const std::string& filepath;
+  const std::string& itemHref;
   GfxRenderer& renderer;
   std::function<void(std::unique_ptr<Page>)> completePageFn;
   std::function<void()> popupFn;  // Popup callback
@@ -35,8 +41,10 @@ class ChapterHtmlSlimParser {
   int partWordBufferIndex = 0;
   bool nextWordContinues = false;  // true when next flushed word attaches to previous (inline element boundary)
   std::unique_ptr<ParsedText> currentTextBlock = nullptr;
+  WordWidthCache wordWidthCache;
   std::unique_ptr<Page> currentPage = nullptr;
   int16_t currentPageNextY = 0;
+  int completedPageCount = 0;
   int fontId;
   float lineCompression;
   bool extraParagraphSpacing;
@@ -45,11 +53,38 @@ class ChapterHtmlSlimParser {
   uint16_t viewportHeight;
   bool hyphenationEnabled;
   const CssParser* cssParser;
+  CssStyleCache cssStyleCache;
+  CssElementStack cssElementStack;  // Only kept when the stylesheets have descendant or child selectors
   bool embeddedStyle;
   std::string contentBase;
   std::string imageBasePath;
   int imageCounter = 0;
 
+  // Incremental parsing state, live between beginParsing() and the end of the chapter
+  XML_Parser xmlParser = nullptr;
+  std::unique_ptr<ZipFile> zip;
+  std::unique_ptr<ZipEntryReader> reader;
+  bool parsingComplete = false;
+
+  // Flow file: a layout independent record of what parsing produced, see ChapterHtmlSlimParser.cpp. Recorded while
+  // parsing the XHTML and replayed in its place by later builds with different layout settings.
+  enum class FlowOp : uint8_t { Block = 0, Word = 1, Image = 2, SplitTextBlock = 3, End = 4 };
+  enum class FlowBlock : uint8_t { Initial = 0, Css = 1, Header = 2, Centered = 3, Repeat = 4 };
+  std::string flowPath;
+  FsFile flowFile;
+  bool recordingFlow = false;
+  bool replayingFlow = false;
+
+  // Images already extracted for this chapter, one at a time or in the batch pass (see prefetchImages), looked up by
+  // resolved href. The batch pass runs once the first page is complete, for chapters small enough to scan twice.
+  struct PrefetchedImage {
+    std::string href;
+    std::string cachedPath;
+    bool extracted = false;
+  };
+  std::vector<PrefetchedImage> prefetchedImages;
+  bool imagePrefetchPending = false;
+
   // Style tracking (replaces depth-based approach)
   struct StyleStackEntry {
     int depth = 0;
@@ -65,26 +100,40 @@ class ChapterHtmlSlimParser {
 
   void updateEffectiveInlineStyle();
   void startNewTextBlock(const BlockStyle& blockStyle);
+  // Layout steps, recorded to the flow file when one is being written
+  BlockStyle resolveBlockStyle(FlowBlock kind, const CssStyle& cssStyle);
+  void beginBlock(FlowBlock kind, const CssStyle& cssStyle = CssStyle());
+  void addWord(const char* word, EpdFontFamily::Style fontStyle, bool attachToPrevious);
+  bool placeImage(const std::string& cachedPath, int width, int height);
+  void splitTextBlock();
+  bool beginFlowReplay();
+  bool replayFlowOps();
+  void finishFlowRecording();
+  void finishPages();
   void flushPartWordBuffer();
   void makePages();
+  std::string nextCachedImagePath(const std::string& resolvedPath);
+  void prefetchImages();
+  void freeXmlParser();
   // XML callbacks
+  static void XMLCALL collectImageSource(void* userData, const XML_Char* name, const XML_Char** atts);
   static void XMLCALL startElement(void* userData, const XML_Char* name, const XML_Char** atts);
   static void XMLCALL characterData(void* userData, const XML_Char* s, int len);
   static void XMLCALL defaultHandlerExpand(void* userData, const XML_Char* s, int len);
   static void XMLCALL endElement(void* userData, const XML_Char* name);
 
  public:
-  explicit ChapterHtmlSlimParser(std::shared_ptr<Epub> epub, const std::string& filepath, GfxRenderer& renderer,
+  explicit ChapterHtmlSlimParser(std::shared_ptr<Epub> epub, const std::string& itemHref, GfxRenderer& renderer,
                                  const int fontId, const float lineCompression, const bool extraParagraphSpacing,
                                  const uint8_t paragraphAlignment, const uint16_t viewportWidth,
                                  const uint16_t viewportHeight, const bool hyphenationEnabled,
                                  const std::function<void(std::unique_ptr<Page>)>& completePageFn,
                                  const bool embeddedStyle, const std::string& contentBase,
                                  const std::string& imageBasePath, const std::function<void()>& popupFn = nullptr,
-                                 const CssParser* cssParser = nullptr)
+                                 const CssParser* cssParser = nullptr, std::string flowPath = {})
 
       : epub(epub),
-        filepath(filepath),
+        itemHref(itemHref),
         renderer(renderer),
         fontId(fontId),
         lineCompression(lineCompression),
@@ -98,9 +147,18 @@ class ChapterHtmlSlimParser {
         cssParser(cssParser),
         embeddedStyle(embeddedStyle),
         contentBase(contentBase),
-        imageBasePath(imageBasePath) {}
+        imageBasePath(imageBasePath),
+        flowPath(std::move(flowPath)) {}
 
-  ~ChapterHtmlSlimParser() = default;
+  ~ChapterHtmlSlimParser();
+  // Parses the whole chapter in one go
   bool parseAndBuildPages();
+  // Incremental form of parseAndBuildPages(): beginParsing() once, then parseNextChunk() until isParsingComplete().
+  // Pages are handed to completePageFn as they fill up. Returns false on error, after which the parser is unusable.
+  bool beginParsing();
+  bool parseNextChunk();
+  bool isParsingComplete() const { return parsingComplete; }
+  // True if flowPath holds a complete flow for these settings, in which case parsing won't need the CSS rules
+  static bool hasFlowFile(const std::string& flowPath, bool embeddedStyle);
   void addLineToPage(std::shared_ptr<TextBlock> line);
 };
@@ -1,5 +1,6 @@
 #include "ContentOpfParser.h"
 
+#include <Fnv1a.h>
 #include <FsHelpers.h>
 #include <Logging.h>
 #include <Serialization.h>
@@ -190,7 +191,7 @@ void XMLCALL ContentOpfParser::startElement(void* userData, const XML_Char* name
     // Record index entry for fast lookup later
     if (self->tempItemStore) {
       ItemIndexEntry entry;
-      entry.idHash = fnvHash(itemId);
+      entry.idHash = fnv1a(itemId);
       entry.idLen = static_cast<uint16_t>(itemId.size());
       entry.fileOffset = static_cast<uint32_t>(self->tempItemStore.position());
       self->itemIndex.push_back(entry);
@@ -248,7 +249,7 @@ void XMLCALL ContentOpfParser::startElement(void* userData, const XML_Char* name
 
           if (self->useItemIndex) {
             // Fast path: binary search
-            uint32_t targetHash = fnvHash(idref);
+            uint32_t targetHash = fnv1a(idref);
             uint16_t targetLen = static_cast<uint16_t>(idref.size());
 
             auto it = std::lower_bound(self->itemIndex.begin(), self->itemIndex.end(),
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// FNV-1a hashes, used for cache keys, file names and on-card lookup tables. Passing an earlier result as `hash`
+// continues hashing, so a key can be fed in pieces. Several of the hashes end up on the SD card, so the results must
+// never change.
+constexpr uint32_t FNV1A_32_BASIS = 2166136261u;
+constexpr uint64_t FNV1A_64_BASIS = 14695981039346656037ull;
+
+constexpr uint32_t fnv1aByte(const uint32_t hash, const uint8_t byte) { return (hash ^ byte) * 16777619u; }
+constexpr uint64_t fnv1a64Byte(const uint64_t hash, const uint8_t byte) { return (hash ^ byte) * 1099511628211ull; }
+
+inline uint32_t fnv1a(const void* data, const size_t length, uint32_t hash = FNV1A_32_BASIS) {
+  const auto* bytes = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < length; i++) {
+    hash = fnv1aByte(hash, bytes[i]);
+  }
+  return hash;
+}
+
+inline uint32_t fnv1a(const std::string_view s, const uint32_t hash = FNV1A_32_BASIS) {
+  return fnv1a(s.data(), s.size(), hash);
+}
+
+inline uint64_t fnv1a64(const void* data, const size_t length, uint64_t hash = FNV1A_64_BASIS) {
+  const auto* bytes = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < length; i++) {
+    hash = fnv1a64Byte(hash, bytes[i]);
+  }
+  return hash;
+}
+
+inline uint64_t fnv1a64(const std::string_view s, const uint64_t hash = FNV1A_64_BASIS) {
+  return fnv1a64(s.data(), s.size(), hash);
+}
@@ -664,19 +664,33 @@ std::string GfxRenderer::truncatedText(const int fontId, const char* text, const
                                        const EpdFontFamily::Style style) const {
   if (!text || maxWidth <= 0) return "";
 
-  std::string item = text;
   const char* ellipsis = "...";
-  int textWidth = getTextWidth(fontId, item.c_str(), style);
-  if (textWidth <= maxWidth) {
+  const auto it = fontMap.find(fontId);
+  if (it == fontMap.end()) {
+    LOG_ERR("GFX", "Font %d not found", fontId);
+    return ellipsis;
+  }
+  const EpdFontFamily& font = it->second;
+  if (font.getTextAdvance(text, style) <= maxWidth) {
     // Text fits, return as is
-    return item;
+    return text;
   }
 
-  while (!item.empty() && getTextWidth(fontId, (item + ellipsis).c_str(), style) >= maxWidth) {
-    utf8RemoveLastChar(item);
+  // One pass over the text: keep the longest code point prefix that still leaves room for the ellipsis
+  const int available = maxWidth - font.getTextAdvance(ellipsis, style);
+  const auto* cursor = reinterpret_cast<const uint8_t*>(text);
+  size_t keptBytes = 0;
+  int width = 0;
+  uint32_t cp;
+  while ((cp = utf8NextCodepoint(&cursor))) {
+    width += font.getAdvance(cp, style);
+    if (width >= available) {
+      break;
+    }
+    keptBytes = reinterpret_cast<const char*>(cursor) - text;
   }
 
-  return item.empty() ? ellipsis : item + ellipsis;
+  return keptBytes == 0 ? ellipsis : std::string(text, keptBytes) + ellipsis;
 }
 
 // Note: Internal driver treats screen in command orientation; this library exposes a logical orientation
@@ -717,18 +731,13 @@ int GfxRenderer::getSpaceWidth(const int fontId) const {
   return fontMap.at(fontId).getGlyph(' ', EpdFontFamily::REGULAR)->advanceX;
 }
 
-int GfxRenderer::getTextAdvanceX(const int fontId, const char* text) const {
-  if (fontMap.count(fontId) == 0) {
+int GfxRenderer::getTextAdvanceX(const int fontId, const char* text, const EpdFontFamily::Style style) const {
+  const auto it = fontMap.find(fontId);
+  if (it == fontMap.end()) {
     LOG_ERR("GFX", "Font %d not found", fontId);
     return 0;
   }
-
-  uint32_t cp;
-  int width = 0;
-  while ((cp = utf8NextCodepoint(reinterpret_cast<const uint8_t**>(&text)))) {
-    width += fontMap.at(fontId).getGlyph(cp, EpdFontFamily::REGULAR)->advanceX;
-  }
-  return width;
+  return it->second.getTextAdvance(text, style);
 }
 
 int GfxRenderer::getFontAscenderSize(const int fontId) const {
@@ -349,6 +349,14 @@ enum class StrId : uint16_t {
   STR_BOOK_S_STYLE,
   STR_EMBEDDED_STYLE,
   STR_OPDS_SERVER_URL,
+  STR_CACHE_LIMIT,
+  STR_MB_256,
+  STR_MB_512,
+  STR_GB_1,
+  STR_GB_4,
+  STR_UNLIMITED,
+  STR_CACHE_IN_USE,
+  STR_BOOKS_LOWER,
   // Sentinel - must be last
   _COUNT
 };
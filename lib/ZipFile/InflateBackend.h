@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Raw DEFLATE decoding used by ZipFile, kept behind a small interface so a different decoder can be selected at
+// build time with -DZIP_INFLATE_BACKEND=<backend>. A backend is an `Inflater` struct providing:
+//
+//   static constexpr const char* BACKEND_NAME;
+//   void reset();                               // start a new stream
+//   InflateStatus inflate(const uint8_t* in, size_t* inBytes, uint8_t* outStart, uint8_t* outNext, size_t* outBytes,
+//                         uint32_t flags);
+//
+// inflate() consumes up to *inBytes of input and writes up to *outBytes at outNext, then sets both to the amounts
+// actually used. By default outStart is a circular INFLATE_WINDOW_SIZE buffer that doubles as the LZ77 dictionary;
+// with INFLATE_NON_WRAPPING_OUTPUT, outStart..outNext holds all of the stream's output so far instead.
+// test/run_inflate_benchmark.sh measures every backend listed there against test/epubs.
+
+#define ZIP_INFLATE_BACKEND_TINFL 1
+
+#ifndef ZIP_INFLATE_BACKEND
+#define ZIP_INFLATE_BACKEND ZIP_INFLATE_BACKEND_TINFL
+#endif
+
+constexpr size_t INFLATE_WINDOW_SIZE = 32768;
+
+constexpr uint32_t INFLATE_HAS_MORE_INPUT = 1;
+constexpr uint32_t INFLATE_NON_WRAPPING_OUTPUT = 2;
+
+enum class InflateStatus : int8_t { Failed = -1, Done = 0, NeedsMoreInput = 1, HasMoreOutput = 2 };
+
+#if ZIP_INFLATE_BACKEND == ZIP_INFLATE_BACKEND_TINFL
+#include <miniz.h>
+
+// miniz tinfl: compact, all state in one struct
+struct Inflater {
+  static constexpr const char* BACKEND_NAME = "tinfl";
+
+  tinfl_decompressor state;
+
+  void reset() {
+    memset(&state, 0, sizeof(state));
+    tinfl_init(&state);
+  }
+
+  InflateStatus inflate(const uint8_t* in, size_t* inBytes, uint8_t* outStart, uint8_t* outNext, size_t* outBytes,
+                        const uint32_t flags) {
+    mz_uint32 tinflFlags = 0;
+    if (flags & INFLATE_HAS_MORE_INPUT) {
+      tinflFlags |= TINFL_FLAG_HAS_MORE_INPUT;
+    }
+    if (flags & INFLATE_NON_WRAPPING_OUTPUT) {
+      tinflFlags |= TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF;
+    }
+
+    const tinfl_status status = tinfl_decompress(&state, in, inBytes, outStart, outNext, outBytes, tinflFlags);
+    switch (status) {
+      case TINFL_STATUS_DONE:
+        return InflateStatus::Done;
+      case TINFL_STATUS_NEEDS_MORE_INPUT:
+        return InflateStatus::NeedsMoreInput;
+      case TINFL_STATUS_HAS_MORE_OUTPUT:
+        return InflateStatus::HasMoreOutput;
+      default:
+        return InflateStatus::Failed;
+    }
+  }
+};
+static_assert(TINFL_LZ_DICT_SIZE == INFLATE_WINDOW_SIZE, "tinfl window must match INFLATE_WINDOW_SIZE");
+
+#else
+#error "Unknown ZIP_INFLATE_BACKEND"
+#endif
@@ -4,32 +4,132 @@
 #include <Logging.h>
 #include <miniz.h>
 
+#include "InflateBackend.h"
+
 #include <algorithm>
+#include <functional>
+
+namespace {
+constexpr uint32_t CENTRAL_DIR_SIG = 0x02014b50;
+constexpr size_t CENTRAL_DIR_HEADER_SIZE = 46;
+
+// Central directory index layout: version, zip file size, record count, 256-entry fanout, sorted records.
+// fanout[b] holds the number of records whose leading hash byte is <= b (same idea as a git pack index).
+constexpr uint8_t ZIP_INDEX_VERSION = 1;
+constexpr uint32_t INDEX_FANOUT_OFFSET = sizeof(uint8_t) + sizeof(uint32_t) + sizeof(uint32_t);
+constexpr uint32_t INDEX_RECORDS_OFFSET = INDEX_FANOUT_OFFSET + 256 * sizeof(uint32_t);
+// Records gathered per central directory pass while building, bounds build-time RAM to ~24KB
+constexpr uint32_t INDEX_RECORDS_PER_PASS = 1024;
+// Windows at or below this many records are read in a single call rather than bisected further
+constexpr uint32_t INDEX_LINEAR_SCAN_RECORDS = 16;
+// Compressed bytes read per SD call when inflating a whole entry into memory
+constexpr size_t INFLATE_INPUT_CHUNK_SIZE = 1024;
+
+uint16_t readLe16(const uint8_t* p) { return static_cast<uint16_t>(p[0] | p[1] << 8); }
+uint32_t readLe32(const uint8_t* p) {
+  return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 | static_cast<uint32_t>(p[2]) << 16 |
+         static_cast<uint32_t>(p[3]) << 24;
+}
+}  // namespace
 
-bool inflateOneShot(const uint8_t* inputBuf, const size_t deflatedSize, uint8_t* outputBuf, const size_t inflatedSize) {
-  // Setup inflator
-  const auto inflator = static_cast<tinfl_decompressor*>(malloc(sizeof(tinfl_decompressor)));
-  if (!inflator) {
-    LOG_ERR("ZIP", "Failed to allocate memory for inflator");
+bool InflateContext::acquire(const size_t minInputBufferSize, const bool withDictionary) {
+  // The render and prefetch tasks can both reach for a book's shared context, so the claim must be atomic
+  bool expected = false;
+  if (!inUse.compare_exchange_strong(expected, true)) {
     return false;
   }
-  memset(inflator, 0, sizeof(tinfl_decompressor));
-  tinfl_init(inflator);
 
-  size_t inBytes = deflatedSize;
-  size_t outBytes = inflatedSize;
-  const tinfl_status status = tinfl_decompress(inflator, inputBuf, &inBytes, nullptr, outputBuf, &outBytes,
-                                               TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF);
-  free(inflator);
+  if (!inflator) {
+    inflator = static_cast<Inflater*>(malloc(sizeof(Inflater)));
+  }
+  if (withDictionary && !dictionary) {
+    dictionary = static_cast<uint8_t*>(malloc(INFLATE_WINDOW_SIZE));
+  }
+  if (inputBufferSize < minInputBufferSize) {
+    free(inputBuffer);
+    inputBuffer = static_cast<uint8_t*>(malloc(minInputBufferSize));
+    inputBufferSize = inputBuffer ? minInputBufferSize : 0;
+  }
 
-  if (status != TINFL_STATUS_DONE) {
-    LOG_ERR("ZIP", "tinfl_decompress() failed with status %d", status);
+  if (!inflator || (withDictionary && !dictionary) || !inputBuffer) {
+    LOG_ERR("ZIP", "Failed to allocate memory for inflate context");
+    inUse.store(false);
     return false;
   }
 
+  inflator->reset();
   return true;
 }
 
+void InflateContext::freeMemory() {
+  // Claim the context so a concurrent acquire cannot see buffers being freed
+  bool expected = false;
+  if (!inUse.compare_exchange_strong(expected, true)) {
+    return;
+  }
+  free(inflator);
+  free(dictionary);
+  free(inputBuffer);
+  inflator = nullptr;
+  dictionary = nullptr;
+  inputBuffer = nullptr;
+  inputBufferSize = 0;
+  inUse.store(false);
+}
+
+InflateContext* ZipFile::acquireInflateContext(const size_t inputBufferSize, const bool withDictionary) {
+  if (sharedInflateContext && sharedInflateContext->acquire(inputBufferSize, withDictionary)) {
+    return sharedInflateContext;
+  }
+  // Shared context is busy (e.g. an image extracted while a chapter is being streamed)
+  if (nestedInflateContext && nestedInflateContext->acquire(inputBufferSize, withDictionary)) {
+    return nestedInflateContext;
+  }
+  // No caller context is free, allocate for the lifetime of this ZipFile
+  if (ownInflateContext.acquire(inputBufferSize, withDictionary)) {
+    return &ownInflateContext;
+  }
+  return nullptr;
+}
+
+// Inflates straight from the zip into a caller buffer holding the whole entry, so no dictionary window or compressed
+// copy of the entry is needed. The file must be positioned at the entry data.
+bool ZipFile::inflateToBuffer(InflateContext& context, const size_t deflatedSize, uint8_t* outputBuf,
+                              const size_t inflatedSize) {
+  size_t fileRemainingBytes = deflatedSize;
+  size_t outputCursor = 0;
+
+  while (true) {
+    const size_t toRead = fileRemainingBytes < context.inputBufferSize ? fileRemainingBytes : context.inputBufferSize;
+    const size_t bytesRead = toRead > 0 ? file.read(context.inputBuffer, toRead) : 0;
+    if (toRead > 0 && bytesRead == 0) {
+      LOG_ERR("ZIP", "Could not read more bytes");
+      return false;
+    }
+    fileRemainingBytes -= bytesRead;
+
+    // Each call consumes the whole chunk unless the stream ends or fails
+    size_t inBytes = bytesRead;
+    size_t outBytes = inflatedSize - outputCursor;
+    const InflateStatus status =
+        context.inflator->inflate(context.inputBuffer, &inBytes, outputBuf, outputBuf + outputCursor, &outBytes,
+                                  INFLATE_NON_WRAPPING_OUTPUT | (fileRemainingBytes > 0 ? INFLATE_HAS_MORE_INPUT : 0));
+    outputCursor += outBytes;
+
+    if (status == InflateStatus::Done) {
+      return true;
+    }
+    if (status != InflateStatus::NeedsMoreInput) {
+      LOG_ERR("ZIP", "Inflate failed with status %d", static_cast<int>(status));
+      return false;
+    }
+    if (fileRemainingBytes == 0) {
+      LOG_ERR("ZIP", "Unexpected EOF");
+      return false;
+    }
+  }
+}
+
 bool ZipFile::loadAllFileStatSlims() {
   const bool wasOpen = isOpen();
   if (!wasOpen && !open()) {
@@ -101,6 +201,14 @@ bool ZipFile::loadFileStatSlim(const char* filename, FileStatSlim* fileStat) {
     return false;
   }
 
+  if (ensureIndex()) {
+    const bool found = findInIndex(filename, fileStat);
+    if (!wasOpen) {
+      close();
+    }
+    return found;
+  }
+
   if (!loadZipDetails()) {
     if (!wasOpen) {
       close();
@@ -177,6 +285,212 @@ bool ZipFile::loadFileStatSlim(const char* filename, FileStatSlim* fileStat) {
   return found;
 }
 
+bool ZipFile::readCentralDirEntry(FileStatSlim& fileStat, char* itemName, uint16_t& nameLen) {
+  uint8_t header[CENTRAL_DIR_HEADER_SIZE];
+  if (file.read(header, sizeof(header)) != sizeof(header) || readLe32(header) != CENTRAL_DIR_SIG) {
+    return false;
+  }
+
+  fileStat.method = readLe16(header + 10);
+  fileStat.compressedSize = readLe32(header + 20);
+  fileStat.uncompressedSize = readLe32(header + 24);
+  nameLen = readLe16(header + 28);
+  const uint16_t extraLen = readLe16(header + 30);
+  const uint16_t commentLen = readLe16(header + 32);
+  fileStat.localHeaderOffset = readLe32(header + 42);
+
+  if (nameLen < 256) {
+    if (file.read(itemName, nameLen) != nameLen) {
+      return false;
+    }
+    itemName[nameLen] = '\0';
+  } else {
+    // Name too long for any path we look up, skip it
+    itemName[0] = '\0';
+    file.seekCur(nameLen);
+  }
+
+  file.seekCur(extraLen + commentLen);
+  return true;
+}
+
+bool ZipFile::ensureIndex() {
+  if (indexState == IndexState::Unknown) {
+    if (indexPath.empty()) {
+      indexState = IndexState::Unavailable;
+    } else if (openIndex() || (buildIndex() && openIndex())) {
+      indexState = IndexState::Ready;
+    } else {
+      LOG_ERR("ZIP", "Central directory index unavailable, falling back to scanning");
+      indexState = IndexState::Unavailable;
+    }
+  }
+  return indexState == IndexState::Ready;
+}
+
+bool ZipFile::openIndex() {
+  if (!Storage.exists(indexPath.c_str()) || !Storage.openFileForRead("ZIP", indexPath, indexFile)) {
+    return false;
+  }
+
+  uint8_t header[INDEX_FANOUT_OFFSET];
+  if (indexFile.read(header, sizeof(header)) != sizeof(header) || header[0] != ZIP_INDEX_VERSION ||
+      readLe32(header + 1) != static_cast<uint32_t>(file.size())) {
+    LOG_DBG("ZIP", "Central directory index is stale, rebuilding");
+    indexFile.close();
+    return false;
+  }
+
+  indexEntryCount = readLe32(header + 5);
+  if (indexFile.size() != INDEX_RECORDS_OFFSET + indexEntryCount * sizeof(IndexRecord)) {
+    LOG_ERR("ZIP", "Central directory index is truncated, rebuilding");
+    indexFile.close();
+    return false;
+  }
+  return true;
+}
+
+bool ZipFile::buildIndex() {
+  if (!loadZipDetails()) {
+    return false;
+  }
+
+  FsFile out;
+  if (!Storage.openFileForWrite("ZIP", indexPath, out)) {
+    return false;
+  }
+
+  const uint32_t zipFileSize = file.size();
+  std::vector<uint32_t> fanout(256, 0);
+
+  // Header is rewritten once the record count and fanout are known
+  out.write(ZIP_INDEX_VERSION);
+  out.write(reinterpret_cast<const uint8_t*>(&zipFileSize), sizeof(zipFileSize));
+  out.write(reinterpret_cast<const uint8_t*>(&indexEntryCount), sizeof(indexEntryCount));
+  out.write(reinterpret_cast<const uint8_t*>(fanout.data()), fanout.size() * sizeof(uint32_t));
+
+  // Holding every record at once does not fit in RAM for large books, so each pass over the central directory
+  // only collects a slice of the leading-hash-byte range. Slices are written in order, so the file ends up sorted.
+  const uint32_t passes = std::min<uint32_t>(zipDetails.totalEntries / INDEX_RECORDS_PER_PASS + 1, 256);
+  std::vector<IndexRecord> records;
+  records.reserve(std::min<uint32_t>(zipDetails.totalEntries, INDEX_RECORDS_PER_PASS));
+
+  uint32_t written = 0;
+  FileStatSlim fileStat = {};
+  char itemName[256];
+  uint16_t nameLen = 0;
+
+  for (uint32_t pass = 0; pass < passes; pass++) {
+    const uint32_t bucketStart = pass * 256 / passes;
+    const uint32_t bucketEnd = (pass + 1) * 256 / passes;
+
+    records.clear();
+    file.seek(zipDetails.centralDirOffset);
+    for (uint32_t i = 0; i < zipDetails.totalEntries && readCentralDirEntry(fileStat, itemName, nameLen); i++) {
+      if (nameLen >= 256) {
+        continue;
+      }
+      const uint64_t hash = fnv1a64(itemName, nameLen);
+      const uint32_t bucket = hash >> 56;
+      if (bucket < bucketStart || bucket >= bucketEnd) {
+        continue;
+      }
+      records.push_back({hash, nameLen, fileStat.method, fileStat.compressedSize, fileStat.uncompressedSize,
+                         fileStat.localHeaderOffset});
+    }
+
+    std::sort(records.begin(), records.end(), [](const IndexRecord& a, const IndexRecord& b) {
+      return a.hash < b.hash || (a.hash == b.hash && a.len < b.len);
+    });
+    for (const auto& record : records) {
+      fanout[record.hash >> 56]++;
+    }
+    out.write(reinterpret_cast<const uint8_t*>(records.data()), records.size() * sizeof(IndexRecord));
+    written += records.size();
+  }
+
+  for (size_t i = 1; i < fanout.size(); i++) {
+    fanout[i] += fanout[i - 1];
+  }
+
+  out.seek(INDEX_FANOUT_OFFSET - sizeof(uint32_t));
+  out.write(reinterpret_cast<const uint8_t*>(&written), sizeof(written));
+  out.write(reinterpret_cast<const uint8_t*>(fanout.data()), fanout.size() * sizeof(uint32_t));
+  out.close();
+
+  LOG_DBG("ZIP", "Built central directory index with %u entries in %u passes", written, passes);
+  return true;
+}
+
+bool ZipFile::findInIndex(const char* filename, FileStatSlim* fileStat) {
+  const size_t len = strlen(filename);
+  const uint64_t hash = fnv1a64(filename, len);
+  const uint32_t bucket = hash >> 56;
+
+  // The fanout gives the record range sharing this leading hash byte
+  uint32_t range[2] = {0, 0};
+  if (bucket == 0) {
+    indexFile.seek(INDEX_FANOUT_OFFSET);
+    indexFile.read(&range[1], sizeof(uint32_t));
+  } else {
+    indexFile.seek(INDEX_FANOUT_OFFSET + (bucket - 1) * sizeof(uint32_t));
+    indexFile.read(range, sizeof(range));
+  }
+
+  const uint32_t end = std::min(range[1], indexEntryCount);
+  uint32_t lo = range[0];
+  uint32_t hi = end;
+  if (lo >= hi) {
+    return false;
+  }
+
+  // Bisect on the card until the remaining window can be read at once. The first record not less than the key
+  // always stays within [lo, hi].
+  IndexRecord window[INDEX_LINEAR_SCAN_RECORDS + 1];
+  while (hi - lo > INDEX_LINEAR_SCAN_RECORDS) {
+    const uint32_t mid = lo + (hi - lo) / 2;
+    indexFile.seek(INDEX_RECORDS_OFFSET + mid * sizeof(IndexRecord));
+    if (indexFile.read(&window[0], sizeof(IndexRecord)) != sizeof(IndexRecord)) {
+      return false;
+    }
+    if (window[0].hash < hash || (window[0].hash == hash && window[0].len < len)) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  const uint32_t count = std::min(hi + 1, end) - lo;
+  indexFile.seek(INDEX_RECORDS_OFFSET + lo * sizeof(IndexRecord));
+  if (indexFile.read(window, count * sizeof(IndexRecord)) != static_cast<int>(count * sizeof(IndexRecord))) {
+    return false;
+  }
+
+  // Records only carry a hash of the name, so a candidate is confirmed against the name in its local header
+  for (uint32_t i = 0; i < count; i++) {
+    if (window[i].hash == hash && window[i].len == len &&
+        localHeaderNameMatches(window[i].localHeaderOffset, filename, len)) {
+      fileStat->method = window[i].method;
+      fileStat->compressedSize = window[i].compressedSize;
+      fileStat->uncompressedSize = window[i].uncompressedSize;
+      fileStat->localHeaderOffset = window[i].localHeaderOffset;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ZipFile::localHeaderNameMatches(const uint32_t localHeaderOffset, const char* filename, const size_t len) {
+  constexpr size_t localHeaderSize = 30;
+  uint8_t buffer[localHeaderSize + 256];
+  if (len >= 256 || !file.seek(localHeaderOffset) ||
+      file.read(buffer, localHeaderSize + len) != static_cast<int>(localHeaderSize + len)) {
+    return false;
+  }
+  return readLe32(buffer) == 0x04034b50 /* MZ_ZIP_LOCAL_DIR_HEADER_SIG */ && readLe16(buffer + 26) == len &&
+         memcmp(buffer + localHeaderSize, filename, len) == 0;
+}
+
 long ZipFile::getDataOffset(const FileStatSlim& fileStat) {
   const bool wasOpen = isOpen();
   if (!wasOpen && !open()) {
@@ -278,6 +592,13 @@ bool ZipFile::loadZipDetails() {
   return true;
 }
 
+ZipFile::~ZipFile() {
+  if (indexFile) {
+    indexFile.close();
+  }
+  close();
+}
+
 bool ZipFile::open() {
   if (!Storage.openFileForRead("ZIP", filePath, file)) {
     return false;
@@ -314,6 +635,41 @@ int ZipFile::fillUncompressedSizes(std::vector<SizeTarget>& targets, std::vector
     return 0;
   }
 
+  if (ensureIndex()) {
+    // Index records are sorted the same way as targets, so a single sequential walk matches them all
+    int matched = 0;
+    auto target = targets.begin();
+    IndexRecord block[INDEX_LINEAR_SCAN_RECORDS];
+    indexFile.seek(INDEX_RECORDS_OFFSET);
+    for (uint32_t consumed = 0; consumed < indexEntryCount && target != targets.end();) {
+      const uint32_t count = std::min(indexEntryCount - consumed, INDEX_LINEAR_SCAN_RECORDS);
+      if (indexFile.read(block, count * sizeof(IndexRecord)) != static_cast<int>(count * sizeof(IndexRecord))) {
+        break;
+      }
+      consumed += count;
+
+      for (uint32_t i = 0; i < count; i++) {
+        const IndexRecord& record = block[i];
+        while (target != targets.end() &&
+               (target->hash < record.hash || (target->hash == record.hash && target->len < record.len))) {
+          ++target;
+        }
+        while (target != targets.end() && target->hash == record.hash && target->len == record.len) {
+          if (target->index < sizes.size()) {
+            sizes[target->index] = record.uncompressedSize;
+            matched++;
+          }
+          ++target;
+        }
+      }
+    }
+
+    if (!wasOpen) {
+      close();
+    }
+    return matched;
+  }
+
   if (!loadZipDetails()) {
     if (!wasOpen) {
       close();
@@ -350,7 +706,7 @@ int ZipFile::fillUncompressedSizes(std::vector<SizeTarget>& targets, std::vector
       file.read(itemName, nameLen);
       itemName[nameLen] = '\0';
 
-      uint64_t hash = fnvHash64(itemName, nameLen);
+      uint64_t hash = fnv1a64(itemName, nameLen);
       SizeTarget key = {hash, nameLen, 0};
 
       auto it = std::lower_bound(targets.begin(), targets.end(), key, [](const SizeTarget& a, const SizeTarget& b) {
@@ -429,31 +785,22 @@ uint8_t* ZipFile::readFileToMemory(const char* filename, size_t* size, const boo
 
     // Continue out of block with data set
   } else if (fileStat.method == MZ_DEFLATED) {
-    // Read out deflated content from file
-    const auto deflatedData = static_cast<uint8_t*>(malloc(deflatedDataSize));
-    if (deflatedData == nullptr) {
-      LOG_ERR("ZIP", "Failed to allocate memory for decompression buffer");
+    // Inflate in chunks straight into the output buffer rather than holding the whole compressed entry in memory
+    InflateContext* context = acquireInflateContext(INFLATE_INPUT_CHUNK_SIZE, false);
+    if (!context) {
+      free(data);
       if (!wasOpen) {
         close();
       }
       return nullptr;
     }
 
-    const size_t dataRead = file.read(deflatedData, deflatedDataSize);
+    const bool success = inflateToBuffer(*context, deflatedDataSize, data, inflatedDataSize);
+    context->release();
     if (!wasOpen) {
       close();
     }
 
-    if (dataRead != deflatedDataSize) {
-      LOG_ERR("ZIP", "Failed to read data, expected %d got %d", deflatedDataSize, dataRead);
-      free(deflatedData);
-      free(data);
-      return nullptr;
-    }
-
-    const bool success = inflateOneShot(deflatedData, deflatedDataSize, data, inflatedDataSize);
-    free(deflatedData);
-
     if (!success) {
       LOG_ERR("ZIP", "Failed to inflate file");
       free(data);
@@ -481,91 +828,100 @@ bool ZipFile::readFileToStream(const char* filename, Print& out, const size_t ch
   }
 
   FileStatSlim fileStat = {};
-  if (!loadFileStatSlim(filename, &fileStat)) {
-    return false;
+  const bool success = loadFileStatSlim(filename, &fileStat) && streamEntry(fileStat, out, chunkSize);
+
+  if (!wasOpen) {
+    close();
+  }
+  return success;
+}
+
+int ZipFile::readFilesToStreams(const std::vector<std::string>& filenames, const size_t chunkSize,
+                                const std::function<Print*(size_t)>& openOutput,
+                                const std::function<void(size_t, bool)>& closeOutput) {
+  const bool wasOpen = isOpen();
+  if (!wasOpen && !open()) {
+    return 0;
   }
 
+  struct BatchEntry {
+    FileStatSlim fileStat;
+    size_t index;
+  };
+  std::vector<BatchEntry> entries;
+  entries.reserve(filenames.size());
+  for (size_t i = 0; i < filenames.size(); i++) {
+    FileStatSlim fileStat = {};
+    if (loadFileStatSlim(filenames[i].c_str(), &fileStat)) {
+      entries.push_back({fileStat, i});
+    } else {
+      closeOutput(i, false);
+    }
+  }
+
+  // Visit entries in archive order so the card is read front to back instead of seeking around per entry
+  std::sort(entries.begin(), entries.end(), [](const BatchEntry& a, const BatchEntry& b) {
+    return a.fileStat.localHeaderOffset < b.fileStat.localHeaderOffset;
+  });
+
+  int extracted = 0;
+  for (const auto& entry : entries) {
+    Print* out = openOutput(entry.index);
+    const bool success = out && streamEntry(entry.fileStat, *out, chunkSize);
+    closeOutput(entry.index, success);
+    if (success) {
+      extracted++;
+    }
+  }
+
+  if (!wasOpen) {
+    close();
+  }
+  return extracted;
+}
+
+bool ZipFile::streamEntry(const FileStatSlim& fileStat, Print& out, const size_t chunkSize) {
   const long fileOffset = getDataOffset(fileStat);
   if (fileOffset < 0) {
     return false;
   }
 
+  if (fileStat.method != MZ_NO_COMPRESSION && fileStat.method != MZ_DEFLATED) {
+    LOG_ERR("ZIP", "Unsupported compression method");
+    return false;
+  }
+
+  InflateContext* context = acquireInflateContext(chunkSize, fileStat.method == MZ_DEFLATED);
+  if (!context) {
+    return false;
+  }
+
   file.seek(fileOffset);
   const auto deflatedDataSize = fileStat.compressedSize;
   const auto inflatedDataSize = fileStat.uncompressedSize;
+  uint8_t* fileReadBuffer = context->inputBuffer;
+  bool success = false;
 
   if (fileStat.method == MZ_NO_COMPRESSION) {
     // no deflation, just read content
-    const auto buffer = static_cast<uint8_t*>(malloc(chunkSize));
-    if (!buffer) {
-      LOG_ERR("ZIP", "Failed to allocate memory for buffer");
-      if (!wasOpen) {
-        close();
-      }
-      return false;
-    }
-
     size_t remaining = inflatedDataSize;
+    success = true;
     while (remaining > 0) {
-      const size_t dataRead = file.read(buffer, remaining < chunkSize ? remaining : chunkSize);
+      const size_t dataRead = file.read(fileReadBuffer, remaining < chunkSize ? remaining : chunkSize);
       if (dataRead == 0) {
         LOG_ERR("ZIP", "Could not read more bytes");
-        free(buffer);
-        if (!wasOpen) {
-          close();
-        }
-        return false;
+        success = false;
+        break;
       }
 
-      out.write(buffer, dataRead);
+      out.write(fileReadBuffer, dataRead);
       remaining -= dataRead;
     }
-
-    if (!wasOpen) {
-      close();
-    }
-    free(buffer);
-    return true;
-  }
-
-  if (fileStat.method == MZ_DEFLATED) {
-    // Setup inflator
-    const auto inflator = static_cast<tinfl_decompressor*>(malloc(sizeof(tinfl_decompressor)));
-    if (!inflator) {
-      LOG_ERR("ZIP", "Failed to allocate memory for inflator");
-      if (!wasOpen) {
-        close();
-      }
-      return false;
-    }
-    memset(inflator, 0, sizeof(tinfl_decompressor));
-    tinfl_init(inflator);
-
-    // Setup file read buffer
-    const auto fileReadBuffer = static_cast<uint8_t*>(malloc(chunkSize));
-    if (!fileReadBuffer) {
-      LOG_ERR("ZIP", "Failed to allocate memory for zip file read buffer");
-      free(inflator);
-      if (!wasOpen) {
-        close();
-      }
-      return false;
-    }
-
-    const auto outputBuffer = static_cast<uint8_t*>(malloc(TINFL_LZ_DICT_SIZE));
-    if (!outputBuffer) {
-      LOG_ERR("ZIP", "Failed to allocate memory for dictionary");
-      free(inflator);
-      free(fileReadBuffer);
-      if (!wasOpen) {
-        close();
-      }
-      return false;
-    }
-    memset(outputBuffer, 0, TINFL_LZ_DICT_SIZE);
+  } else {
+    const auto inflator = context->inflator;
+    const auto outputBuffer = context->dictionary;
 
     size_t fileRemainingBytes = deflatedDataSize;
-    size_t processedOutputBytes = 0;
     size_t fileReadBufferFilledBytes = 0;
     size_t fileReadBufferCursor = 0;
     size_t outputCursor = 0;  // Current offset in the circular dictionary
@@ -575,7 +931,8 @@ bool ZipFile::readFileToStream(const char* filename, Print& out, const size_t ch
       if (fileReadBufferCursor >= fileReadBufferFilledBytes) {
         if (fileRemainingBytes == 0) {
           // Should not be hit, but a safe protection
-          break;  // EOF
+          LOG_ERR("ZIP", "Unexpected EOF");
+          break;
         }
 
         fileReadBufferFilledBytes =
@@ -585,77 +942,204 @@ bool ZipFile::readFileToStream(const char* filename, Print& out, const size_t ch
 
         if (fileReadBufferFilledBytes == 0) {
           // Bad read
-          break;  // EOF
+          LOG_ERR("ZIP", "Unexpected EOF");
+          break;
         }
       }
 
       // Available bytes in fileReadBuffer to process
       size_t inBytes = fileReadBufferFilledBytes - fileReadBufferCursor;
       // Space remaining in outputBuffer
-      size_t outBytes = TINFL_LZ_DICT_SIZE - outputCursor;
+      size_t outBytes = INFLATE_WINDOW_SIZE - outputCursor;
 
-      const tinfl_status status = tinfl_decompress(inflator, fileReadBuffer + fileReadBufferCursor, &inBytes,
-                                                   outputBuffer, outputBuffer + outputCursor, &outBytes,
-                                                   fileRemainingBytes > 0 ? TINFL_FLAG_HAS_MORE_INPUT : 0);
+      const InflateStatus status =
+          inflator->inflate(fileReadBuffer + fileReadBufferCursor, &inBytes, outputBuffer, outputBuffer + outputCursor,
+                            &outBytes, fileRemainingBytes > 0 ? INFLATE_HAS_MORE_INPUT : 0);
 
       // Update input position
       fileReadBufferCursor += inBytes;
 
       // Write output chunk
       if (outBytes > 0) {
-        processedOutputBytes += outBytes;
         if (out.write(outputBuffer + outputCursor, outBytes) != outBytes) {
           LOG_ERR("ZIP", "Failed to write all output bytes to stream");
-          if (!wasOpen) {
-            close();
-          }
-          free(outputBuffer);
-          free(fileReadBuffer);
-          free(inflator);
-          return false;
+          break;
         }
         // Update output position in buffer (with wraparound)
-        outputCursor = (outputCursor + outBytes) & (TINFL_LZ_DICT_SIZE - 1);
+        outputCursor = (outputCursor + outBytes) & (INFLATE_WINDOW_SIZE - 1);
       }
 
-      if (status < 0) {
-        LOG_ERR("ZIP", "tinfl_decompress() failed with status %d", status);
-        if (!wasOpen) {
-          close();
-        }
-        free(outputBuffer);
-        free(fileReadBuffer);
-        free(inflator);
-        return false;
+      if (status == InflateStatus::Failed) {
+        LOG_ERR("ZIP", "Inflate failed");
+        break;
       }
 
-      if (status == TINFL_STATUS_DONE) {
-        LOG_ERR("ZIP", "Decompressed %d bytes into %d bytes", deflatedDataSize, inflatedDataSize);
-        if (!wasOpen) {
-          close();
-        }
-        free(inflator);
-        free(fileReadBuffer);
-        free(outputBuffer);
-        return true;
+      if (status == InflateStatus::Done) {
+        LOG_DBG("ZIP", "Decompressed %d bytes into %d bytes", deflatedDataSize, inflatedDataSize);
+        success = true;
+        break;
       }
     }
+  }
 
-    // If we get here, EOF reached without TINFL_STATUS_DONE
-    LOG_ERR("ZIP", "Unexpected EOF");
-    if (!wasOpen) {
+  context->release();
+  return success;
+}
+
+bool ZipEntryReader::open(const char* filename, const size_t chunkSize) {
+  close();
+
+  ownsZipHandle = !zip.isOpen();
+  if (ownsZipHandle && !zip.open()) {
+    ownsZipHandle = false;
+    return false;
+  }
+
+  if (!zip.loadFileStatSlim(filename, &fileStat)) {
+    close();
+    return false;
+  }
+
+  const long fileOffset = zip.getDataOffset(fileStat);
+  if (fileOffset < 0) {
+    close();
+    return false;
+  }
+
+  if (fileStat.method == MZ_DEFLATED) {
+    context = zip.acquireInflateContext(chunkSize, true);
+    if (!context) {
       close();
+      return false;
     }
-    free(outputBuffer);
-    free(fileReadBuffer);
-    free(inflator);
+    readBufferSize = chunkSize;
+  } else if (fileStat.method != MZ_NO_COMPRESSION) {
+    LOG_ERR("ZIP", "Unsupported compression method");
+    close();
     return false;
   }
 
-  if (!wasOpen) {
-    close();
+  inputPos = static_cast<uint32_t>(fileOffset);
+  inputRemaining = fileStat.method == MZ_DEFLATED ? fileStat.compressedSize : fileStat.uncompressedSize;
+  zip.file.seek(inputPos);
+  opened = true;
+  return true;
+}
+
+bool ZipEntryReader::fillReadBuffer() {
+  // Someone else may have moved the shared handle since our last read
+  if (zip.file.position() != inputPos) {
+    zip.file.seek(inputPos);
   }
 
-  LOG_ERR("ZIP", "Unsupported compression method");
-  return false;
+  readBufferFilled =
+      zip.file.read(context->inputBuffer, inputRemaining < readBufferSize ? inputRemaining : readBufferSize);
+  readBufferCursor = 0;
+  if (readBufferFilled == 0) {
+    LOG_ERR("ZIP", "Could not read more bytes");
+    return false;
+  }
+
+  inputPos += readBufferFilled;
+  inputRemaining -= readBufferFilled;
+  return true;
+}
+
+int ZipEntryReader::read(void* buf, const size_t len) {
+  if (!opened) {
+    return -1;
+  }
+
+  auto* out = static_cast<uint8_t*>(buf);
+
+  if (fileStat.method == MZ_NO_COMPRESSION) {
+    const size_t toRead = inputRemaining < len ? inputRemaining : len;
+    if (toRead == 0) {
+      return 0;
+    }
+    if (zip.file.position() != inputPos) {
+      zip.file.seek(inputPos);
+    }
+    const size_t dataRead = zip.file.read(out, toRead);
+    if (dataRead == 0) {
+      LOG_ERR("ZIP", "Could not read more bytes");
+      return -1;
+    }
+    inputPos += dataRead;
+    inputRemaining -= dataRead;
+    delivered += dataRead;
+    return static_cast<int>(dataRead);
+  }
+
+  size_t produced = 0;
+  while (produced < len) {
+    // Hand out anything already inflated before asking for more
+    if (pendingBytes > 0) {
+      const size_t toCopy = pendingBytes < len - produced ? pendingBytes : len - produced;
+      memcpy(out + produced, context->dictionary + pendingStart, toCopy);
+      pendingStart += toCopy;
+      pendingBytes -= toCopy;
+      produced += toCopy;
+      continue;
+    }
+
+    if (inflateDone) {
+      break;
+    }
+
+    if (readBufferCursor >= readBufferFilled && inputRemaining > 0 && !fillReadBuffer()) {
+      return -1;
+    }
+
+    size_t inBytes = readBufferFilled - readBufferCursor;
+    size_t outBytes = INFLATE_WINDOW_SIZE - dictionaryCursor;
+    uint8_t* dictionary = context->dictionary;
+    const InflateStatus status =
+        context->inflator->inflate(context->inputBuffer + readBufferCursor, &inBytes, dictionary,
+                                   dictionary + dictionaryCursor, &outBytes,
+                                   inputRemaining > 0 ? INFLATE_HAS_MORE_INPUT : 0);
+
+    readBufferCursor += inBytes;
+    pendingStart = dictionaryCursor;
+    pendingBytes = outBytes;
+    dictionaryCursor = (dictionaryCursor + outBytes) & (INFLATE_WINDOW_SIZE - 1);
+
+    if (status == InflateStatus::Failed) {
+      LOG_ERR("ZIP", "Inflate failed");
+      return -1;
+    }
+
+    if (status == InflateStatus::Done) {
+      inflateDone = true;
+    } else if (outBytes == 0 && readBufferCursor >= readBufferFilled && inputRemaining == 0) {
+      LOG_ERR("ZIP", "Unexpected EOF");
+      return -1;
+    }
+  }
+
+  delivered += produced;
+  return static_cast<int>(produced);
+}
+
+void ZipEntryReader::close() {
+  if (context) {
+    context->release();
+    context = nullptr;
+  }
+  if (ownsZipHandle) {
+    zip.close();
+  }
+  ownsZipHandle = false;
+  opened = false;
+  fileStat = {};
+  inputPos = 0;
+  inputRemaining = 0;
+  delivered = 0;
+  readBufferSize = 0;
+  readBufferFilled = 0;
+  readBufferCursor = 0;
+  dictionaryCursor = 0;
+  pendingStart = 0;
+  pendingBytes = 0;
+  inflateDone = false;
 }
@@ -1,11 +1,48 @@
 #pragma once
+#include <Fnv1a.h>
 #include <HalStorage.h>
 
+#include <atomic>
+#include <functional>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
+struct Inflater;
+class ZipEntryReader;
+
+// Inflate working memory: decompressor state, the 32KB dictionary window and a compressed input buffer. Buffers are
+// allocated on first use and kept until freeMemory(), so one context can serve every entry read of a book session
+// instead of churning ~45KB of heap per read. A context serves one read at a time (acquire/release); the claim is
+// atomic, so tasks sharing a context never need an outside lock for it.
+class InflateContext {
+  friend class ZipFile;
+  friend class ZipEntryReader;
+
+  Inflater* inflator = nullptr;
+  uint8_t* dictionary = nullptr;
+  uint8_t* inputBuffer = nullptr;
+  size_t inputBufferSize = 0;
+  std::atomic<bool> inUse{false};
+
+ public:
+  InflateContext() = default;
+  ~InflateContext() { freeMemory(); }
+  InflateContext(const InflateContext&) = delete;
+  InflateContext& operator=(const InflateContext&) = delete;
+
+  // Claims the context for one read, allocating whatever is still missing, and resets the decompressor.
+  // Returns false if the context is already in use or allocation fails.
+  bool acquire(size_t minInputBufferSize, bool withDictionary);
+  void release() { inUse.store(false); }
+  // Frees all buffers. No-op while the context is in use.
+  void freeMemory();
+  bool isAllocated() const { return inflator || dictionary || inputBuffer; }
+};
+
 class ZipFile {
+  friend class ZipEntryReader;
+
  public:
   struct FileStatSlim {
     uint16_t method;             // Compression method
@@ -27,17 +64,20 @@ class ZipFile {
     uint16_t index;  // Caller's index (e.g. spine index)
   };
 
-  // FNV-1a 64-bit hash computed from char buffer (no std::string allocation)
-  static uint64_t fnvHash64(const char* s, size_t len) {
-    uint64_t hash = 14695981039346656037ull;
-    for (size_t i = 0; i < len; i++) {
-      hash ^= static_cast<uint8_t>(s[i]);
-      hash *= 1099511628211ull;
-    }
-    return hash;
-  }
-
  private:
+  // On-SD central directory index record, sorted by (hash, len)
+  struct IndexRecord {
+    uint64_t hash;
+    uint16_t len;
+    uint16_t method;
+    uint32_t compressedSize;
+    uint32_t uncompressedSize;
+    uint32_t localHeaderOffset;
+  };
+  static_assert(sizeof(IndexRecord) == 24, "IndexRecord must be packed");
+
+  enum class IndexState : uint8_t { Unknown, Ready, Unavailable };
+
   const std::string& filePath;
   FsFile file;
   ZipDetails zipDetails = {0, 0, false};
@@ -47,13 +87,43 @@ class ZipFile {
   uint32_t lastCentralDirPos = 0;
   bool lastCentralDirPosValid = false;
 
+  // Inflate memory borrowed from the caller (either may be null), and a fallback that lives as long as this ZipFile
+  InflateContext* sharedInflateContext;
+  InflateContext* nestedInflateContext;
+  InflateContext ownInflateContext;
+
+  // Persistent central directory index (only used when an index path is given)
+  std::string indexPath;
+  FsFile indexFile;
+  uint32_t indexEntryCount = 0;
+  IndexState indexState = IndexState::Unknown;
+
   bool loadFileStatSlim(const char* filename, FileStatSlim* fileStat);
   long getDataOffset(const FileStatSlim& fileStat);
   bool loadZipDetails();
+  bool readCentralDirEntry(FileStatSlim& fileStat, char* itemName, uint16_t& nameLen);
+  bool ensureIndex();
+  bool openIndex();
+  bool buildIndex();
+  bool findInIndex(const char* filename, FileStatSlim* fileStat);
+  bool localHeaderNameMatches(uint32_t localHeaderOffset, const char* filename, size_t len);
+  InflateContext* acquireInflateContext(size_t inputBufferSize, bool withDictionary);
+  bool inflateToBuffer(InflateContext& context, size_t deflatedSize, uint8_t* outputBuf, size_t inflatedSize);
+  bool streamEntry(const FileStatSlim& fileStat, Print& out, size_t chunkSize);
 
  public:
-  explicit ZipFile(const std::string& filePath) : filePath(filePath) {}
-  ~ZipFile() = default;
+  // indexPath is optional: when set, entry lookups go through a sorted central directory index stored at that path
+  // (built on first use) instead of scanning the central directory.
+  // inflateContext is optional: when set (and not busy), reads reuse its buffers instead of allocating their own.
+  // nestedInflateContext is optional too: it serves a read started while inflateContext is busy with another one
+  // (e.g. an image extracted while the chapter around it is still being streamed).
+  explicit ZipFile(const std::string& filePath, std::string indexPath = {}, InflateContext* inflateContext = nullptr,
+                   InflateContext* nestedInflateContext = nullptr)
+      : filePath(filePath),
+        sharedInflateContext(inflateContext),
+        nestedInflateContext(nestedInflateContext),
+        indexPath(std::move(indexPath)) {}
+  ~ZipFile();
   // Zip file can be opened and closed by hand in order to allow for quick calculation of inflated file size
   // It is NOT recommended to pre-open it for any kind of inflation due to memory constraints
   bool isOpen() const { return !!file; }
@@ -61,7 +131,7 @@ class ZipFile {
   bool close();
   bool loadAllFileStatSlims();
   bool getInflatedFileSize(const char* filename, size_t* size);
-  // Batch lookup: scan ZIP central dir once and fill sizes for matching targets.
+  // Batch lookup: scan ZIP central dir (or walk the index) once and fill sizes for matching targets.
   // targets must be sorted by (hash, len). sizes[target.index] receives uncompressedSize.
   // Returns number of targets matched.
   int fillUncompressedSizes(std::vector<SizeTarget>& targets, std::vector<uint32_t>& sizes);
@@ -69,4 +139,56 @@ class ZipFile {
   // These functions will open and close the zip as needed
   uint8_t* readFileToMemory(const char* filename, size_t* size = nullptr, bool trailingNullByte = false);
   bool readFileToStream(const char* filename, Print& out, size_t chunkSize);
+  // Batch variant of readFileToStream: extracts every entry in one forward pass over the zip, in local header order.
+  // openOutput(i) is called right before filenames[i] is extracted and returns its destination (nullptr skips it);
+  // closeOutput(i, success) is called once per entry, including ones that could not be found.
+  // Returns the number of entries extracted successfully.
+  int readFilesToStreams(const std::vector<std::string>& filenames, size_t chunkSize,
+                         const std::function<Print*(size_t)>& openOutput,
+                         const std::function<void(size_t, bool)>& closeOutput);
+};
+
+// Pull-based reader over a single zip entry. Inflated bytes are produced on demand into the caller's buffer, so
+// parsers can consume an entry directly without staging it in a temp file on the SD card.
+// The ZipFile must outlive the reader and should not be used for other reads while an entry is open.
+class ZipEntryReader {
+  ZipFile& zip;
+  ZipFile::FileStatSlim fileStat = {};
+  bool opened = false;
+  bool ownsZipHandle = false;
+
+  // Position of the next compressed byte in the zip file and how many remain
+  uint32_t inputPos = 0;
+  size_t inputRemaining = 0;
+  size_t delivered = 0;
+
+  // Inflate state (deflated entries only), leased from the zip for as long as the entry is open
+  InflateContext* context = nullptr;
+  size_t readBufferSize = 0;
+  size_t readBufferFilled = 0;
+  size_t readBufferCursor = 0;
+  size_t dictionaryCursor = 0;
+  // Inflated bytes sitting in the dictionary window that have not been handed out yet
+  size_t pendingStart = 0;
+  size_t pendingBytes = 0;
+  bool inflateDone = false;
+
+  bool fillReadBuffer();
+
+ public:
+  explicit ZipEntryReader(ZipFile& zip) : zip(zip) {}
+  ~ZipEntryReader() { close(); }
+  ZipEntryReader(const ZipEntryReader&) = delete;
+  ZipEntryReader& operator=(const ZipEntryReader&) = delete;
+
+  bool open(const char* filename, size_t chunkSize = 1024);
+  // Reads up to len inflated bytes into buf. Returns the number of bytes read, 0 at the end of the entry, or -1 on
+  // error.
+  int read(void* buf, size_t len);
+  void close();
+  bool isOpen() const { return opened; }
+  // Inflated size of the open entry
+  size_t size() const { return fileStat.uncompressedSize; }
+  // Inflated bytes not yet returned by read()
+  size_t available() const { return opened ? fileStat.uncompressedSize - delivered : 0; }
 };
@@ -0,0 +1,249 @@
+#include "CacheManager.h"
+
+#include <HalStorage.h>
+#include <Logging.h>
+#include <Serialization.h>
+
+#include <algorithm>
+
+#include "CrossPointSettings.h"
+
+namespace {
+constexpr uint8_t CACHE_INDEX_FILE_VERSION = 1;
+constexpr char CACHE_DIR[] = "/.crosspoint";
+constexpr char CACHE_INDEX_FILE[] = "/.crosspoint/cache.bin";
+
+bool isBookCacheDir(const std::string& name) {
+  return name.rfind("epub_", 0) == 0 || name.rfind("xtc_", 0) == 0 || name.rfind("txt_", 0) == 0;
+}
+
+std::string dirNameOf(const std::string& cachePath) {
+  const size_t lastSlash = cachePath.find_last_of('/');
+  return lastSlash == std::string::npos ? cachePath : cachePath.substr(lastSlash + 1);
+}
+
+// Layout data that is rebuilt from the book on the next open: section and flow caches, extracted images and their
+// pixel caches. Metadata, covers and progress are left alone.
+bool isRebuildable(const std::string& name, const bool isDirectory) {
+  if (isDirectory) {
+    return name == "sections" || name == "flows";
+  }
+  return name.rfind("img_", 0) == 0 || (name.size() > 4 && name.compare(name.size() - 4, 4, ".pxc") == 0);
+}
+}  // namespace
+
+CacheManager CacheManager::instance;
+
+CachedBook* CacheManager::find(const std::string& dirName) {
+  auto it = std::find_if(books.begin(), books.end(), [&](const CachedBook& book) { return book.dirName == dirName; });
+  return it == books.end() ? nullptr : &*it;
+}
+
+uint32_t CacheManager::measureDir(const std::string& path) {
+  auto dir = Storage.open(path.c_str());
+  if (!dir || !dir.isDirectory()) {
+    if (dir) dir.close();
+    return 0;
+  }
+
+  uint32_t total = 0;
+  char name[128];
+  for (auto file = dir.openNextFile(); file; file = dir.openNextFile()) {
+    if (file.isDirectory()) {
+      file.getName(name, sizeof(name));
+      file.close();
+      total += measureDir(path + "/" + name);
+    } else {
+      total += file.size();
+      file.close();
+    }
+  }
+  dir.close();
+  return total;
+}
+
+bool CacheManager::trimBook(const std::string& path) {
+  auto dir = Storage.open(path.c_str());
+  if (!dir || !dir.isDirectory()) {
+    if (dir) dir.close();
+    return false;
+  }
+
+  // Collect first, removing entries while iterating the directory would skip some
+  std::vector<std::pair<std::string, bool>> victims;
+  char name[128];
+  for (auto file = dir.openNextFile(); file; file = dir.openNextFile()) {
+    file.getName(name, sizeof(name));
+    const bool isDirectory = file.isDirectory();
+    file.close();
+    if (isRebuildable(name, isDirectory)) {
+      victims.emplace_back(name, isDirectory);
+    }
+  }
+  dir.close();
+
+  for (const auto& victim : victims) {
+    const std::string victimPath = path + "/" + victim.first;
+    if (victim.second) {
+      Storage.removeDir(victimPath.c_str());
+    } else {
+      Storage.remove(victimPath.c_str());
+    }
+  }
+  return !victims.empty();
+}
+
+uint64_t CacheManager::getTotalSize() const {
+  uint64_t total = 0;
+  for (const auto& book : books) {
+    total += book.size;
+  }
+  return total;
+}
+
+void CacheManager::enforceLimit(const std::string& keepDirName) {
+  const uint64_t limit = SETTINGS.getCacheLimitBytes();
+  uint64_t total = getTotalSize();
+  if (total <= limit) {
+    return;
+  }
+  LOG_DBG("CACHE", "Cache over limit (%llu of %llu bytes)", total, limit);
+
+  std::sort(books.begin(), books.end(),
+            [](const CachedBook& a, const CachedBook& b) { return a.lastRead < b.lastRead; });
+
+  // Cheapest first: drop layout data of the least recently read books
+  for (auto& book : books) {
+    if (total <= limit) break;
+    if (book.dirName == keepDirName) continue;
+    const std::string path = std::string(CACHE_DIR) + "/" + book.dirName;
+    if (trimBook(path)) {
+      const uint32_t trimmedSize = measureDir(path);
+      LOG_DBG("CACHE", "Trimmed %s: %lu -> %lu bytes", book.dirName.c_str(), static_cast<unsigned long>(book.size),
+              static_cast<unsigned long>(trimmedSize));
+      total -= book.size - std::min(book.size, trimmedSize);
+      book.size = trimmedSize;
+    }
+  }
+
+  // Then whole books, oldest first
+  auto it = books.begin();
+  while (total > limit && it != books.end()) {
+    if (it->dirName == keepDirName) {
+      ++it;
+      continue;
+    }
+    const std::string path = std::string(CACHE_DIR) + "/" + it->dirName;
+    LOG_DBG("CACHE", "Removing %s (%lu bytes)", it->dirName.c_str(), static_cast<unsigned long>(it->size));
+    if (!Storage.removeDir(path.c_str())) {
+      LOG_ERR("CACHE", "Failed to remove: %s", path.c_str());
+      ++it;
+      continue;
+    }
+    total -= it->size;
+    it = books.erase(it);
+  }
+}
+
+void CacheManager::onBookOpened(const std::string& cachePath) {
+  const std::string dirName = dirNameOf(cachePath);
+  CachedBook* book = find(dirName);
+  if (!book) {
+    books.push_back({dirName, 0, 0});
+    book = &books.back();
+  }
+  book->lastRead = ++clock;
+  saveToFile();
+}
+
+void CacheManager::onBookClosed(const std::string& cachePath) {
+  const std::string dirName = dirNameOf(cachePath);
+  CachedBook* book = find(dirName);
+  if (!book) {
+    return;
+  }
+  book->size = measureDir(cachePath);
+  enforceLimit(dirName);
+  saveToFile();
+}
+
+void CacheManager::rescan() {
+  std::vector<CachedBook> found;
+  auto root = Storage.open(CACHE_DIR);
+  if (root && root.isDirectory()) {
+    char name[128];
+    for (auto file = root.openNextFile(); file; file = root.openNextFile()) {
+      file.getName(name, sizeof(name));
+      const bool isDirectory = file.isDirectory();
+      file.close();
+      if (!isDirectory || !isBookCacheDir(name)) continue;
+
+      const CachedBook* known = find(name);
+      found.push_back({name, 0, known ? known->lastRead : 0});
+    }
+  }
+  if (root) root.close();
+
+  for (auto& book : found) {
+    book.size = measureDir(std::string(CACHE_DIR) + "/" + book.dirName);
+  }
+  books = std::move(found);
+  LOG_DBG("CACHE", "Rescanned cache: %d books, %llu bytes", static_cast<int>(books.size()), getTotalSize());
+  saveToFile();
+}
+
+bool CacheManager::saveToFile() const {
+  Storage.mkdir(CACHE_DIR);
+
+  FsFile outputFile;
+  if (!Storage.openFileForWrite("CACHE", CACHE_INDEX_FILE, outputFile)) {
+    return false;
+  }
+
+  serialization::writePod(outputFile, CACHE_INDEX_FILE_VERSION);
+  serialization::writePod(outputFile, clock);
+  serialization::writePod(outputFile, static_cast<uint16_t>(books.size()));
+  for (const auto& book : books) {
+    serialization::writeString(outputFile, book.dirName);
+    serialization::writePod(outputFile, book.size);
+    serialization::writePod(outputFile, book.lastRead);
+  }
+
+  outputFile.close();
+  return true;
+}
+
+bool CacheManager::loadFromFile() {
+  FsFile inputFile;
+  if (!Storage.exists(CACHE_INDEX_FILE) || !Storage.openFileForRead("CACHE", CACHE_INDEX_FILE, inputFile)) {
+    // First boot with the cache manager: pick up what's already on the card
+    rescan();
+    return false;
+  }
+
+  uint8_t version;
+  serialization::readPod(inputFile, version);
+  if (version != CACHE_INDEX_FILE_VERSION) {
+    LOG_ERR("CACHE", "Deserialization failed: Unknown version %u", version);
+    inputFile.close();
+    rescan();
+    return false;
+  }
+
+  uint16_t count;
+  serialization::readPod(inputFile, clock);
+  serialization::readPod(inputFile, count);
+  books.clear();
+  books.reserve(count);
+  for (uint16_t i = 0; i < count; i++) {
+    CachedBook book;
+    serialization::readString(inputFile, book.dirName);
+    serialization::readPod(inputFile, book.size);
+    serialization::readPod(inputFile, book.lastRead);
+    books.push_back(std::move(book));
+  }
+
+  inputFile.close();
+  LOG_DBG("CACHE", "Cache index loaded (%d books)", count);
+  return true;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct CachedBook {
+  std::string dirName;  // epub_<hash>, xtc_<hash> or txt_<hash> under /.crosspoint
+  uint32_t size;
+  uint32_t lastRead;  // Position in reading order, 0 if never opened since the cache was indexed
+};
+
+// Keeps the per-book cache directories in /.crosspoint within the configured cache limit. Sizes and reading order
+// are kept in /.crosspoint/cache.bin so the limit can be enforced without walking the whole cache each time.
+// When over the limit, the least recently read books lose their layout data first (sections, flows, extracted images),
+// which is rebuilt on the next open; only if that isn't enough are whole book caches, including progress, removed.
+class CacheManager {
+  // Static instance
+  static CacheManager instance;
+
+  std::vector<CachedBook> books;
+  uint32_t clock = 0;
+
+  CachedBook* find(const std::string& dirName);
+  static uint32_t measureDir(const std::string& path);
+  static bool trimBook(const std::string& path);
+  void enforceLimit(const std::string& keepDirName);
+
+ public:
+  ~CacheManager() = default;
+
+  // Get singleton instance
+  static CacheManager& getInstance() { return instance; }
+
+  // Called with a book's cache path as it is opened and closed. Closing measures what reading it added and trims
+  // other books if the cache went over the limit.
+  void onBookOpened(const std::string& cachePath);
+  void onBookClosed(const std::string& cachePath);
+
+  // Walks /.crosspoint to pick up book caches created or removed behind the manager's back
+  void rescan();
+
+  const std::vector<CachedBook>& getBooks() const { return books; }
+  uint64_t getTotalSize() const;
+
+  bool saveToFile() const;
+  bool loadFromFile();
+};
+
+// Helper macro to access the cache manager
+#define CACHE_MANAGER CacheManager::getInstance()
@@ -134,6 +134,7 @@ uint8_t CrossPointSettings::writeSettings(FsFile& file, bool count_only) const {
   writer.writeItem(file, frontButtonRight);
   writer.writeItem(file, fadingFix);
   writer.writeItem(file, embeddedStyle);
+  writer.writeItem(file, cacheLimit);
   // New fields need to be added at end for backward compatibility
 
   return writer.item_count;
@@ -261,6 +262,8 @@ bool CrossPointSettings::loadFromFile() {
     if (++settingsRead >= fileSettingsCount) break;
     serialization::readPod(inputFile, embeddedStyle);
     if (++settingsRead >= fileSettingsCount) break;
+    readAndValidate(inputFile, cacheLimit, CACHE_LIMIT_COUNT);
+    if (++settingsRead >= fileSettingsCount) break;
     // New fields added at end for backward compatibility
   } while (false);
 
@@ -384,3 +387,19 @@ int CrossPointSettings::getReaderFontId() const {
       }
   }
 }
+
+uint64_t CrossPointSettings::getCacheLimitBytes() const {
+  switch (cacheLimit) {
+    case CACHE_256_MB:
+      return 256ULL * 1024 * 1024;
+    case CACHE_512_MB:
+      return 512ULL * 1024 * 1024;
+    case CACHE_1_GB:
+    default:
+      return 1024ULL * 1024 * 1024;
+    case CACHE_4_GB:
+      return 4096ULL * 1024 * 1024;
+    case CACHE_UNLIMITED:
+      return UINT64_MAX;
+  }
+}
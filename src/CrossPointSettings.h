@@ -113,6 +113,16 @@ class CrossPointSettings {
     REFRESH_FREQUENCY_COUNT
   };
 
+  // Space the book caches in /.crosspoint may take before least recently read books are trimmed
+  enum CACHE_LIMIT {
+    CACHE_256_MB = 0,
+    CACHE_512_MB = 1,
+    CACHE_1_GB = 2,
+    CACHE_4_GB = 3,
+    CACHE_UNLIMITED = 4,
+    CACHE_LIMIT_COUNT
+  };
+
   // Short power button press actions
   enum SHORT_PWRBTN { IGNORE = 0, SLEEP = 1, PAGE_TURN = 2, SHORT_PWRBTN_COUNT };
 
@@ -174,6 +184,8 @@ class CrossPointSettings {
   uint8_t fadingFix = 0;
   // Use book's embedded CSS styles for EPUB rendering (1 = enabled, 0 = disabled)
   uint8_t embeddedStyle = 1;
+  // Book cache budget
+  uint8_t cacheLimit = CACHE_1_GB;
 
   ~CrossPointSettings() = default;
 
@@ -194,6 +206,7 @@ class CrossPointSettings {
   float getReaderLineCompression() const;
   unsigned long getSleepTimeoutMs() const;
   int getRefreshFrequency() const;
+  uint64_t getCacheLimitBytes() const;
 };
 
 // Helper macro to access settings
@@ -1,12 +1,14 @@
 #include "EpubReaderActivity.h"
 
-#include <Epub/Page.h>
 #include <FsHelpers.h>
 #include <GfxRenderer.h>
 #include <HalStorage.h>
 #include <I18n.h>
 #include <Logging.h>
 
+#include <algorithm>
+#include <climits>
+
 #include "CrossPointSettings.h"
 #include "CrossPointState.h"
 #include "EpubReaderChapterSelectionActivity.h"
@@ -24,6 +26,11 @@ constexpr unsigned long skipChapterMs = 700;
 constexpr unsigned long goHomeMs = 1000;
 constexpr int statusBarMargin = 19;
 constexpr int progressBarMarginTop = 1;
+// The prefetch task waits this long after the last button event before doing more work
+constexpr unsigned long prefetchInputBackoffMs = 500;
+// Below this much free heap, pages with images first free what the book session keeps loaded (PNG decoding alone
+// needs about 58KB)
+constexpr size_t imagePageMinFreeHeap = 64 * 1024;
 
 int clampPercent(int percent) {
   if (percent < 0) {
@@ -101,11 +108,21 @@ void EpubReaderActivity::onEnter() {
   APP_STATE.saveToFile();
   RECENT_BOOKS.addBook(epub->getPath(), epub->getTitle(), epub->getAuthor(), epub->getThumbBmpPath());
 
+  xTaskCreate(&prefetchTaskTrampoline, "EpubPrefetch",
+              8192,                // Stack size, section building needs as much as rendering
+              this,                // Parameters
+              0,                   // Priority, only runs when the main loop and render task are idle
+              &prefetchTaskHandle  // Task handle
+  );
+  assert(prefetchTaskHandle != nullptr && "Failed to create prefetch task");
+
   // Trigger first update
   requestUpdate();
 }
 
 void EpubReaderActivity::onExit() {
+  // Stop background section building before anything else touches the SD card
+  stopPrefetchTask();
   ActivityWithSubactivity::onExit();
 
   // Reset orientation back to portrait for the rest of the UI
@@ -118,6 +135,10 @@ void EpubReaderActivity::onExit() {
 }
 
 void EpubReaderActivity::loop() {
+  if (mappedInput.wasAnyPressed() || mappedInput.wasAnyReleased()) {
+    lastInputTime = millis();
+  }
+
   // Pass input responsibility to sub activity if exists
   if (subActivity) {
     subActivity->loop();
@@ -165,12 +186,19 @@ void EpubReaderActivity::loop() {
 
   // Enter reader menu activity.
   if (mappedInput.wasReleased(MappedInputManager::Button::Confirm)) {
-    const int currentPage = section ? section->currentPage + 1 : 0;
-    const int totalPages = section ? section->pageCount : 0;
+    int currentPage = 0;
+    int totalPages = 0;
     float bookProgress = 0.0f;
-    if (epub && epub->getBookSize() > 0 && section && section->pageCount > 0) {
-      const float chapterProgress = static_cast<float>(section->currentPage) / static_cast<float>(section->pageCount);
-      bookProgress = epub->calculateProgress(currentSpineIndex, chapterProgress) * 100.0f;
+    {
+      // The prefetch task may be indexing the section (growing its page count) or dropping it after a failure
+      RenderLock lock(*this);
+      currentPage = section ? section->currentPage + 1 : 0;
+      totalPages = section ? section->pageCount : 0;
+      if (epub && epub->getBookSize() > 0 && section && section->pageCount > 0) {
+        const float chapterProgress =
+            static_cast<float>(section->currentPage) / static_cast<float>(section->pageCount);
+        bookProgress = epub->calculateProgress(currentSpineIndex, chapterProgress) * 100.0f;
+      }
     }
     const int bookProgressPercent = clampPercent(static_cast<int>(bookProgress + 0.5f));
     exitActivity();
@@ -220,51 +248,35 @@ void EpubReaderActivity::loop() {
 
   const bool skipChapter = SETTINGS.longPressChapterSkip && mappedInput.getHeldTime() > skipChapterMs;
 
-  if (skipChapter) {
-    // We don't want to delete the section mid-render, so grab the semaphore
-    {
-      RenderLock lock(*this);
+  {
+    // We don't want to delete the section mid-render, and the prefetch task may be indexing it (growing its page
+    // count) or dropping it after a failure, so grab the semaphore for every access
+    RenderLock lock(*this);
+    if (skipChapter) {
       nextPageNumber = 0;
       currentSpineIndex = nextTriggered ? currentSpineIndex + 1 : currentSpineIndex - 1;
       section.reset();
-    }
-    requestUpdate();
-    return;
-  }
-
-  // No current section, attempt to rerender the book
-  if (!section) {
-    requestUpdate();
-    return;
-  }
-
-  if (prevTriggered) {
-    if (section->currentPage > 0) {
-      section->currentPage--;
-    } else {
-      // We don't want to delete the section mid-render, so grab the semaphore
-      {
-        RenderLock lock(*this);
+    } else if (!section) {
+      // No current section, attempt to rerender the book
+    } else if (prevTriggered) {
+      if (section->currentPage > 0) {
+        section->currentPage--;
+      } else {
         nextPageNumber = UINT16_MAX;
         currentSpineIndex--;
         section.reset();
       }
-    }
-    requestUpdate();
-  } else {
-    if (section->currentPage < section->pageCount - 1) {
-      section->currentPage++;
     } else {
-      // We don't want to delete the section mid-render, so grab the semaphore
-      {
-        RenderLock lock(*this);
+      if (section->currentPage < section->pageCount - 1 || section->isIndexing()) {
+        section->currentPage++;
+      } else {
         nextPageNumber = 0;
         currentSpineIndex++;
         section.reset();
       }
     }
-    requestUpdate();
   }
+  requestUpdate();
 }
 
 void EpubReaderActivity::onReaderMenuBack(const uint8_t orientation) {
@@ -414,9 +426,12 @@ void EpubReaderActivity::onReaderMenuConfirm(EpubReaderMenuActivity::MenuAction
           // 2. BACKUP: Read current progress
           // We use the current variables that track our position
           uint16_t backupSpine = currentSpineIndex;
-          uint16_t backupPage = section->currentPage;
-          uint16_t backupPageCount = section->pageCount;
+          uint16_t backupPage = section ? section->currentPage : 0;
+          uint16_t backupPageCount = section ? section->pageCount : 0;
 
+          // Close every section file before its directory goes, including one the prefetch task is still building
+          prefetchSection.reset();
+          prefetchQueue.clear();
           section.reset();
           // 3. WIPE: Clear the cache directory
           epub->clearCache();
@@ -436,6 +451,8 @@ void EpubReaderActivity::onReaderMenuConfirm(EpubReaderMenuActivity::MenuAction
         const int currentPage = section ? section->currentPage : 0;
         const int totalPages = section ? section->pageCount : 0;
         exitActivity();
+        // Syncing needs WiFi and TLS, which need all the heap they can get
+        epub->freeMemory();
         enterNewActivity(new KOReaderSyncActivity(
             renderer, mappedInput, epub, epub->getPath(), currentSpineIndex, currentPage, totalPages,
             [this]() {
@@ -528,24 +545,52 @@ void EpubReaderActivity::render(Activity::RenderLock&& lock) {
                             (showProgressBar ? (metrics.bookProgressBarHeight + progressBarMarginTop) : 0);
   }
 
+  SectionLayout currentLayout;
+  currentLayout.fontId = SETTINGS.getReaderFontId();
+  currentLayout.lineCompression = SETTINGS.getReaderLineCompression();
+  currentLayout.extraParagraphSpacing = SETTINGS.extraParagraphSpacing;
+  currentLayout.paragraphAlignment = SETTINGS.paragraphAlignment;
+  currentLayout.viewportWidth = renderer.getScreenWidth() - orientedMarginLeft - orientedMarginRight;
+  currentLayout.viewportHeight = renderer.getScreenHeight() - orientedMarginTop - orientedMarginBottom;
+  currentLayout.hyphenationEnabled = SETTINGS.hyphenationEnabled;
+  currentLayout.embeddedStyle = SETTINGS.embeddedStyle;
+  if (!(currentLayout == layout)) {
+    // Anything prefetched so far was laid out for different settings
+    prefetchSection.reset();
+    prefetchQueue.clear();
+    layout = currentLayout;
+  }
+
   if (!section) {
     const auto filepath = epub->getSpineItem(currentSpineIndex).href;
     LOG_DBG("ERS", "Loading file: %s, index: %d", filepath.c_str(), currentSpineIndex);
-    section = std::unique_ptr<Section>(new Section(epub, currentSpineIndex, renderer));
+    if (prefetchSection && prefetchSection->getSpineIndex() == currentSpineIndex) {
+      // Still being built in the background, carry on from where the prefetch got to
+      LOG_DBG("ERS", "Taking over prefetched section at page %d", prefetchSection->pageCount);
+      section = std::move(prefetchSection);
+    } else {
+      prefetchSection.reset();
+      section = std::unique_ptr<Section>(new Section(epub, currentSpineIndex, renderer));
+    }
 
-    const uint16_t viewportWidth = renderer.getScreenWidth() - orientedMarginLeft - orientedMarginRight;
-    const uint16_t viewportHeight = renderer.getScreenHeight() - orientedMarginTop - orientedMarginBottom;
+    // Only index up to the page being opened, the prefetch task indexes the rest. Positioning by proportion (last
+    // page, percent jump, changed layout) needs the final page count, so those index the whole chapter first.
+    const bool needsFinalPageCount = nextPageNumber == UINT16_MAX || pendingPercentJump ||
+                                     (cachedChapterTotalPageCount > 0 && currentSpineIndex == cachedSpineIndex);
+    const int targetPage = needsFinalPageCount ? INT_MAX : nextPageNumber;
 
-    if (!section->loadSectionFile(SETTINGS.getReaderFontId(), SETTINGS.getReaderLineCompression(),
-                                  SETTINGS.extraParagraphSpacing, SETTINGS.paragraphAlignment, viewportWidth,
-                                  viewportHeight, SETTINGS.hyphenationEnabled, SETTINGS.embeddedStyle)) {
+    if (section->isIndexing()) {
+      if (!section->continueSectionFile(targetPage)) {
+        LOG_ERR("ERS", "Failed to persist page data to SD");
+        section.reset();
+        return;
+      }
+    } else if (!loadSectionFile(*section)) {
       LOG_DBG("ERS", "Cache not found, building...");
 
       const auto popupFn = [this]() { GUI.drawPopup(renderer, tr(STR_INDEXING)); };
 
-      if (!section->createSectionFile(SETTINGS.getReaderFontId(), SETTINGS.getReaderLineCompression(),
-                                      SETTINGS.extraParagraphSpacing, SETTINGS.paragraphAlignment, viewportWidth,
-                                      viewportHeight, SETTINGS.hyphenationEnabled, SETTINGS.embeddedStyle, popupFn)) {
+      if (!beginSectionFile(*section, popupFn) || !section->continueSectionFile(targetPage)) {
         LOG_ERR("ERS", "Failed to persist page data to SD");
         section.reset();
         return;
@@ -582,6 +627,23 @@ void EpubReaderActivity::render(Activity::RenderLock&& lock) {
     }
   }
 
+  // Paged forward past what has been indexed so far
+  if (section->isIndexing() && section->currentPage >= section->pageCount) {
+    if (!section->continueSectionFile(section->currentPage)) {
+      LOG_ERR("ERS", "Failed to persist page data to SD");
+      section.reset();
+      return;
+    }
+    if (section->currentPage >= section->pageCount && section->pageCount > 0) {
+      // The chapter ended on the last indexed page
+      nextPageNumber = 0;
+      currentSpineIndex++;
+      section.reset();
+      requestUpdate();
+      return;
+    }
+  }
+
   renderer.clearScreen();
 
   if (section->pageCount == 0) {
@@ -601,8 +663,7 @@ void EpubReaderActivity::render(Activity::RenderLock&& lock) {
   }
 
   {
-    auto p = section->loadPageFromSectionFile();
-    if (!p) {
+    if (!section->loadPageFromSectionFile(pageView)) {
       LOG_ERR("ERS", "Failed to load page from SD - clearing section cache");
       section->clearCache();
       section.reset();
@@ -611,10 +672,127 @@ void EpubReaderActivity::render(Activity::RenderLock&& lock) {
       return;
     }
     const auto start = millis();
-    renderContents(std::move(p), orientedMarginTop, orientedMarginRight, orientedMarginBottom, orientedMarginLeft);
+    renderContents(pageView, orientedMarginTop, orientedMarginRight, orientedMarginBottom, orientedMarginLeft);
     LOG_DBG("ERS", "Rendered page in %dms", millis() - start);
   }
-  saveProgress(currentSpineIndex, section->currentPage, section->pageCount);
+  // A provisional page count would be taken for a layout change on the next open, so leave it out until it's final
+  saveProgress(currentSpineIndex, section->currentPage, section->isIndexing() ? 0 : section->pageCount);
+  startPrefetch();
+}
+
+bool EpubReaderActivity::loadSectionFile(Section& target) const {
+  return target.loadSectionFile(layout.fontId, layout.lineCompression, layout.extraParagraphSpacing,
+                                layout.paragraphAlignment, layout.viewportWidth, layout.viewportHeight,
+                                layout.hyphenationEnabled, layout.embeddedStyle);
+}
+
+bool EpubReaderActivity::beginSectionFile(Section& target, const std::function<void()>& popupFn) const {
+  return target.beginSectionFile(layout.fontId, layout.lineCompression, layout.extraParagraphSpacing,
+                                 layout.paragraphAlignment, layout.viewportWidth, layout.viewportHeight,
+                                 layout.hyphenationEnabled, layout.embeddedStyle, popupFn);
+}
+
+// Called with the render lock held, once the current page is on screen
+void EpubReaderActivity::startPrefetch() {
+  prefetchQueue.clear();
+  if (currentSpineIndex + 1 < epub->getSpineItemsCount()) {
+    prefetchQueue.push_back(currentSpineIndex + 1);
+  }
+  if (currentSpineIndex > 0) {
+    prefetchQueue.push_back(currentSpineIndex - 1);
+  }
+  if (prefetchSection && std::find(prefetchQueue.begin(), prefetchQueue.end(), prefetchSection->getSpineIndex()) ==
+                             prefetchQueue.end()) {
+    prefetchSection.reset();
+  }
+  if (prefetchTaskHandle) {
+    xTaskNotifyGive(prefetchTaskHandle);
+  }
+}
+
+void EpubReaderActivity::stopPrefetchTask() {
+  // The task only does work while holding the render lock, so it is never deleted halfway through a page
+  RenderLock lock(*this);
+  if (prefetchTaskHandle) {
+    vTaskDelete(prefetchTaskHandle);
+    prefetchTaskHandle = nullptr;
+  }
+  prefetchSection.reset();
+  prefetchQueue.clear();
+  prefetchBusy = false;
+}
+
+void EpubReaderActivity::prefetchTaskTrampoline(void* param) {
+  auto* self = static_cast<EpubReaderActivity*>(param);
+  self->prefetchTaskLoop();
+}
+
+void EpubReaderActivity::prefetchTaskLoop() {
+  while (true) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    prefetchBusy = true;
+    bool moreWork = true;
+    while (moreWork) {
+      // Stay out of the way while buttons are in use, the next render is likely right behind them
+      if (millis() - lastInputTime < prefetchInputBackoffMs) {
+        vTaskDelay(pdMS_TO_TICKS(prefetchInputBackoffMs));
+        continue;
+      }
+      {
+        RenderLock lock(*this);
+        moreWork = prefetchStep();
+      }
+      vTaskDelay(1);  // Let the main loop and render task in between pages
+    }
+    prefetchBusy = false;
+  }
+}
+
+// Does one page worth of background indexing, returns false once there is nothing left to do.
+// Called with the render lock held.
+bool EpubReaderActivity::prefetchStep() {
+  // Sub activities render and read the SD card from their own task, wait until they exit (which requests a render)
+  if (subActivity || !epub) {
+    return false;
+  }
+
+  // The rest of the chapter being read comes first
+  if (section && section->isIndexing()) {
+    if (!section->continueSectionFile(section->pageCount)) {
+      LOG_ERR("ERS", "Failed to index the rest of the chapter");
+      section.reset();
+      return false;
+    }
+    return true;
+  }
+
+  while (!prefetchSection) {
+    if (prefetchQueue.empty()) {
+      return false;
+    }
+    const int spineIndex = prefetchQueue.front();
+    prefetchQueue.erase(prefetchQueue.begin());
+
+    std::unique_ptr<Section> candidate(new Section(epub, spineIndex, renderer));
+    if (loadSectionFile(*candidate)) {
+      continue;  // Already cached
+    }
+    if (!beginSectionFile(*candidate, nullptr)) {
+      LOG_ERR("ERS", "Failed to start prefetching section %d", spineIndex);
+      continue;
+    }
+    LOG_DBG("ERS", "Prefetching section %d", spineIndex);
+    prefetchSection = std::move(candidate);
+  }
+
+  if (!prefetchSection->continueSectionFile(prefetchSection->pageCount)) {
+    LOG_ERR("ERS", "Failed to prefetch section %d", prefetchSection->getSpineIndex());
+    prefetchSection.reset();
+  } else if (!prefetchSection->isIndexing()) {
+    LOG_DBG("ERS", "Prefetched section %d: %d pages", prefetchSection->getSpineIndex(), prefetchSection->pageCount);
+    prefetchSection.reset();
+  }
+  return true;
 }
 
 void EpubReaderActivity::saveProgress(int spineIndex, int currentPage, int pageCount) {
@@ -634,14 +812,18 @@ void EpubReaderActivity::saveProgress(int spineIndex, int currentPage, int pageC
     LOG_ERR("ERS", "Could not save progress!");
   }
 }
-void EpubReaderActivity::renderContents(std::unique_ptr<Page> page, const int orientedMarginTop,
+void EpubReaderActivity::renderContents(const PageView& page, const int orientedMarginTop,
                                         const int orientedMarginRight, const int orientedMarginBottom,
                                         const int orientedMarginLeft) {
   // Force full refresh for pages with images when anti-aliasing is on,
   // as grayscale tones require half refresh to display correctly
-  bool forceFullRefresh = page->hasImages() && SETTINGS.textAntiAliasing;
+  bool forceFullRefresh = page.hasImages() && SETTINGS.textAntiAliasing;
+
+  if (page.hasImages() && ESP.getFreeHeap() < imagePageMinFreeHeap) {
+    epub->freeMemory();
+  }
 
-  page->render(renderer, SETTINGS.getReaderFontId(), orientedMarginLeft, orientedMarginTop);
+  page.render(renderer, SETTINGS.getReaderFontId(), orientedMarginLeft, orientedMarginTop);
   renderStatusBar(orientedMarginRight, orientedMarginBottom, orientedMarginLeft);
   if (forceFullRefresh || pagesUntilFullRefresh <= 1) {
     renderer.displayBuffer(HalDisplay::HALF_REFRESH);
@@ -659,13 +841,13 @@ void EpubReaderActivity::renderContents(std::unique_ptr<Page> page, const int or
   if (SETTINGS.textAntiAliasing) {
     renderer.clearScreen(0x00);
     renderer.setRenderMode(GfxRenderer::GRAYSCALE_LSB);
-    page->render(renderer, SETTINGS.getReaderFontId(), orientedMarginLeft, orientedMarginTop);
+    page.render(renderer, SETTINGS.getReaderFontId(), orientedMarginLeft, orientedMarginTop);
     renderer.copyGrayscaleLsbBuffers();
 
     // Render and copy to MSB buffer
     renderer.clearScreen(0x00);
     renderer.setRenderMode(GfxRenderer::GRAYSCALE_MSB);
-    page->render(renderer, SETTINGS.getReaderFontId(), orientedMarginLeft, orientedMarginTop);
+    page.render(renderer, SETTINGS.getReaderFontId(), orientedMarginLeft, orientedMarginTop);
     renderer.copyGrayscaleMsbBuffers();
 
     // display grayscale part
@@ -712,15 +894,18 @@ void EpubReaderActivity::renderStatusBar(const int orientedMarginRight, const in
   if (showProgressText || showProgressPercentage || showBookPercentage) {
     // Right aligned text for progress counter
     char progressStr[32];
+    // The page count is a lower bound while the chapter is still being indexed
+    const char* pageCountSuffix = section->isIndexing() ? "+" : "";
 
     // Hide percentage when progress bar is shown to reduce clutter
     if (showProgressPercentage) {
-      snprintf(progressStr, sizeof(progressStr), "%d/%d  %.0f%%", section->currentPage + 1, section->pageCount,
-               bookProgress);
+      snprintf(progressStr, sizeof(progressStr), "%d/%d%s  %.0f%%", section->currentPage + 1, section->pageCount,
+               pageCountSuffix, bookProgress);
     } else if (showBookPercentage) {
       snprintf(progressStr, sizeof(progressStr), "%.0f%%", bookProgress);
     } else {
-      snprintf(progressStr, sizeof(progressStr), "%d/%d", section->currentPage + 1, section->pageCount);
+      snprintf(progressStr, sizeof(progressStr), "%d/%d%s", section->currentPage + 1, section->pageCount,
+               pageCountSuffix);
     }
 
     progressTextWidth = renderer.getTextWidth(SMALL_FONT_ID, progressStr);
@@ -1,13 +1,18 @@
 #pragma once
 #include <Epub.h>
+#include <Epub/PageCodec.h>
 #include <Epub/Section.h>
 
+#include <atomic>
+#include <vector>
+
 #include "EpubReaderMenuActivity.h"
 #include "activities/ActivityWithSubactivity.h"
 
 class EpubReaderActivity final : public ActivityWithSubactivity {
   std::shared_ptr<Epub> epub;
   std::unique_ptr<Section> section = nullptr;
+  PageView pageView;  // Page on screen; its buffers are reused from one page to the next
   int currentSpineIndex = 0;
   int nextPageNumber = 0;
   int pagesUntilFullRefresh = 0;
@@ -24,7 +29,43 @@ class EpubReaderActivity final : public ActivityWithSubactivity {
   const std::function<void()> onGoBack;
   const std::function<void()> onGoHome;
 
-  void renderContents(std::unique_ptr<Page> page, int orientedMarginTop, int orientedMarginRight,
+  // Parameters a section file is laid out with
+  struct SectionLayout {
+    int fontId = 0;
+    float lineCompression = 0;
+    bool extraParagraphSpacing = false;
+    uint8_t paragraphAlignment = 0;
+    uint16_t viewportWidth = 0;
+    uint16_t viewportHeight = 0;
+    bool hyphenationEnabled = false;
+    bool embeddedStyle = false;
+
+    bool operator==(const SectionLayout& other) const {
+      return fontId == other.fontId && lineCompression == other.lineCompression &&
+             extraParagraphSpacing == other.extraParagraphSpacing && paragraphAlignment == other.paragraphAlignment &&
+             viewportWidth == other.viewportWidth && viewportHeight == other.viewportHeight &&
+             hyphenationEnabled == other.hyphenationEnabled && embeddedStyle == other.embeddedStyle;
+    }
+  };
+  SectionLayout layout;  // Set by render(), shared with the prefetch task
+
+  // Low priority task that, once a page is on screen, finishes indexing the current chapter and then builds the
+  // sections around it. Works one page at a time under the render lock and backs off while buttons are in use.
+  TaskHandle_t prefetchTaskHandle = nullptr;
+  std::unique_ptr<Section> prefetchSection = nullptr;  // Section being built in the background
+  std::vector<int> prefetchQueue;                      // Spine indexes still to build
+  std::atomic<bool> prefetchBusy{false};
+  std::atomic<unsigned long> lastInputTime{0};
+  [[noreturn]] static void prefetchTaskTrampoline(void* param);
+  [[noreturn]] void prefetchTaskLoop();
+  bool prefetchStep();
+  void startPrefetch();
+  void stopPrefetchTask();
+
+  bool loadSectionFile(Section& target) const;
+  bool beginSectionFile(Section& target, const std::function<void()>& popupFn) const;
+
+  void renderContents(const PageView& page, int orientedMarginTop, int orientedMarginRight,
                       int orientedMarginBottom, int orientedMarginLeft);
   void renderStatusBar(int orientedMarginRight, int orientedMarginBottom, int orientedMarginLeft) const;
   void saveProgress(int spineIndex, int currentPage, int pageCount);
@@ -45,4 +86,5 @@ class EpubReaderActivity final : public ActivityWithSubactivity {
   void onExit() override;
   void loop() override;
   void render(Activity::RenderLock&& lock) override;
+  bool preventAutoSleep() override { return prefetchBusy; }
 };
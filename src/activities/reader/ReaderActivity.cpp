@@ -2,6 +2,7 @@
 
 #include <HalStorage.h>
 
+#include "CacheManager.h"
 #include "CrossPointSettings.h"
 #include "Epub.h"
 #include "EpubReaderActivity.h"
@@ -83,6 +84,8 @@ void ReaderActivity::goToLibrary(const std::string& fromBookPath) {
 void ReaderActivity::onGoToEpubReader(std::unique_ptr<Epub> epub) {
   const auto epubPath = epub->getPath();
   currentBookPath = epubPath;
+  currentCachePath = epub->getCachePath();
+  CACHE_MANAGER.onBookOpened(currentCachePath);
   exitActivity();
   enterNewActivity(new EpubReaderActivity(
       renderer, mappedInput, std::move(epub), [this, epubPath] { goToLibrary(epubPath); }, [this] { onGoBack(); }));
@@ -91,6 +94,8 @@ void ReaderActivity::onGoToEpubReader(std::unique_ptr<Epub> epub) {
 void ReaderActivity::onGoToXtcReader(std::unique_ptr<Xtc> xtc) {
   const auto xtcPath = xtc->getPath();
   currentBookPath = xtcPath;
+  currentCachePath = xtc->getCachePath();
+  CACHE_MANAGER.onBookOpened(currentCachePath);
   exitActivity();
   enterNewActivity(new XtcReaderActivity(
       renderer, mappedInput, std::move(xtc), [this, xtcPath] { goToLibrary(xtcPath); }, [this] { onGoBack(); }));
@@ -99,6 +104,8 @@ void ReaderActivity::onGoToXtcReader(std::unique_ptr<Xtc> xtc) {
 void ReaderActivity::onGoToTxtReader(std::unique_ptr<Txt> txt) {
   const auto txtPath = txt->getPath();
   currentBookPath = txtPath;
+  currentCachePath = txt->getCachePath();
+  CACHE_MANAGER.onBookOpened(currentCachePath);
   exitActivity();
   enterNewActivity(new TxtReaderActivity(
       renderer, mappedInput, std::move(txt), [this, txtPath] { goToLibrary(txtPath); }, [this] { onGoBack(); }));
@@ -137,3 +144,12 @@ void ReaderActivity::onEnter() {
     onGoToEpubReader(std::move(epub));
   }
 }
+
+void ReaderActivity::onExit() {
+  ActivityWithSubactivity::onExit();
+
+  // The book's cache has grown while reading, account for it once the reader (and its files) are closed
+  if (!currentCachePath.empty()) {
+    CACHE_MANAGER.onBookClosed(currentCachePath);
+  }
+}
@@ -11,6 +11,7 @@ class Txt;
 class ReaderActivity final : public ActivityWithSubactivity {
   std::string initialBookPath;
   std::string currentBookPath;  // Track current book path for navigation
+  std::string currentCachePath;
   const std::function<void()> onGoBack;
   const std::function<void(const std::string&)> onGoToLibrary;
   static std::unique_ptr<Epub> loadEpub(const std::string& path);
@@ -34,5 +35,6 @@ class ReaderActivity final : public ActivityWithSubactivity {
         onGoBack(onGoBack),
         onGoToLibrary(onGoToLibrary) {}
   void onEnter() override;
+  void onExit() override;
   bool isReaderActivity() const override { return true; }
 };
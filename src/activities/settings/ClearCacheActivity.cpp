@@ -5,6 +5,7 @@
 #include <I18n.h>
 #include <Logging.h>
 
+#include "CacheManager.h"
 #include "MappedInputManager.h"
 #include "components/UITheme.h"
 #include "fontIds.h"
@@ -31,6 +32,11 @@ void ClearCacheActivity::render(Activity::RenderLock&&) {
     renderer.drawCenteredText(UI_10_FONT_ID, pageHeight / 2 + 10, tr(STR_CLEAR_CACHE_WARNING_3), true);
     renderer.drawCenteredText(UI_10_FONT_ID, pageHeight / 2 + 30, tr(STR_CLEAR_CACHE_WARNING_4), true);
 
+    const auto usedMb = static_cast<unsigned long>(CACHE_MANAGER.getTotalSize() / (1024 * 1024));
+    const std::string usage = std::string(tr(STR_CACHE_IN_USE)) + ": " + std::to_string(usedMb) + " MB (" +
+                              std::to_string(CACHE_MANAGER.getBooks().size()) + " " + tr(STR_BOOKS_LOWER) + ")";
+    renderer.drawCenteredText(UI_10_FONT_ID, pageHeight / 2 + 70, usage.c_str());
+
     const auto labels = mappedInput.mapLabels(tr(STR_CANCEL), tr(STR_CLEAR_BUTTON), "", "");
     GUI.drawButtonHints(renderer, labels.btn1, labels.btn2, labels.btn3, labels.btn4);
     renderer.displayBuffer();
@@ -109,6 +115,7 @@ void ClearCacheActivity::clearCache() {
     }
   }
   root.close();
+  CACHE_MANAGER.rescan();
 
   LOG_DBG("CLEAR_CACHE", "Cache cleared: %d removed, %d failed", clearedCount, failedCount);
 
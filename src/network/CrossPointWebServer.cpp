@@ -10,6 +10,7 @@
 
 #include <algorithm>
 
+#include "CacheManager.h"
 #include "CrossPointSettings.h"
 #include "SettingsList.h"
 #include "html/FilesPageHtml.generated.h"
@@ -133,6 +134,7 @@ void CrossPointWebServer::begin() {
   server->on("/files", HTTP_GET, [this] { handleFileList(); });
 
   server->on("/api/status", HTTP_GET, [this] { handleStatus(); });
+  server->on("/api/cache", HTTP_GET, [this] { handleCacheStats(); });
   server->on("/api/files", HTTP_GET, [this] { handleFileListData(); });
   server->on("/download", HTTP_GET, [this] { handleDownload(); });
 
@@ -326,6 +328,26 @@ void CrossPointWebServer::handleStatus() const {
   server->send(200, "application/json", json);
 }
 
+void CrossPointWebServer::handleCacheStats() const {
+  const uint64_t limit = SETTINGS.getCacheLimitBytes();
+
+  JsonDocument doc;
+  doc["usedBytes"] = CACHE_MANAGER.getTotalSize();
+  // 0 when unlimited
+  doc["limitBytes"] = limit == UINT64_MAX ? 0 : limit;
+  JsonArray books = doc["books"].to<JsonArray>();
+  for (const auto& book : CACHE_MANAGER.getBooks()) {
+    JsonObject entry = books.add<JsonObject>();
+    entry["dir"] = book.dirName;
+    entry["bytes"] = book.size;
+    entry["lastRead"] = book.lastRead;
+  }
+
+  String json;
+  serializeJson(doc, json);
+  server->send(200, "application/json", json);
+}
+
 void CrossPointWebServer::scanFiles(const char* path, const std::function<void(FileInfo)>& callback) const {
   FsFile root = Storage.open(path);
   if (!root) {
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "Print.h"
+
+// Minimal Arduino surface so firmware libraries can be built into host-side tools.
+
+using std::max;
+using std::min;
+
+inline unsigned long millis() {
+  using namespace std::chrono;
+  static const auto start = steady_clock::now();
+  return static_cast<unsigned long>(duration_cast<milliseconds>(steady_clock::now() - start).count());
+}
+
+inline void delay(const unsigned long ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+
+class String : public std::string {
+ public:
+  using std::string::string;
+  String(const std::string& s) : std::string(s) {}  // NOLINT(google-explicit-constructor)
+};
+
+struct HostEsp {
+  uint32_t getFreeHeap() const { return 256 * 1024; }
+};
+inline HostEsp ESP;
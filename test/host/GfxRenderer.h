@@ -0,0 +1,22 @@
+#pragma once
+
+#include <EpdFontFamily.h>
+
+#include <cstring>
+
+// Host-side stand-in for the renderer so block code can be linked into host tools. Drawing is a no-op and text
+// measures a fixed advance per byte.
+class GfxRenderer {
+ public:
+  static constexpr int HOST_ADVANCE = 9;
+
+  void drawText(int, int, int, const char*, bool = true, EpdFontFamily::Style = EpdFontFamily::REGULAR) const {}
+  void drawLine(int, int, int, int, bool = true) const {}
+  int getTextWidth(int, const char* text, EpdFontFamily::Style = EpdFontFamily::REGULAR) const {
+    return HOST_ADVANCE * static_cast<int>(strlen(text));
+  }
+  int getTextAdvanceX(int fontId, const char* text, EpdFontFamily::Style = EpdFontFamily::REGULAR) const {
+    return getTextWidth(fontId, text);
+  }
+  int getFontAscenderSize(int) const { return 16; }
+};
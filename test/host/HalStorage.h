@@ -0,0 +1,115 @@
+#pragma once
+
+#include <sys/stat.h>
+
+#include <cstdio>
+#include <string>
+
+#include "Arduino.h"
+
+// Host-side stand-in for the SD card storage layer backed by stdio. Every call that would hit the card is counted
+// in hostIoStats so tools can report I/O per operation.
+
+struct HostIoStats {
+  uint64_t opens = 0;
+  uint64_t reads = 0;
+  uint64_t seeks = 0;
+  uint64_t writes = 0;
+  uint64_t bytesRead = 0;
+
+  void reset() { *this = HostIoStats{}; }
+};
+inline HostIoStats hostIoStats;
+
+class FsFile : public Print {
+  FILE* handle = nullptr;
+
+ public:
+  FsFile() = default;
+  explicit FsFile(FILE* handle) : handle(handle) {}
+  FsFile(const FsFile&) = delete;
+  FsFile& operator=(const FsFile&) = delete;
+  FsFile(FsFile&& other) noexcept : handle(other.handle) { other.handle = nullptr; }
+  FsFile& operator=(FsFile&& other) noexcept {
+    close();
+    handle = other.handle;
+    other.handle = nullptr;
+    return *this;
+  }
+  ~FsFile() override { close(); }
+
+  explicit operator bool() const { return handle != nullptr; }
+
+  size_t write(const uint8_t b) override { return write(&b, 1); }
+  size_t write(const uint8_t* buffer, const size_t size) override {
+    hostIoStats.writes++;
+    return fwrite(buffer, 1, size, handle);
+  }
+
+  int read(void* buffer, const size_t size) {
+    hostIoStats.reads++;
+    const size_t n = fread(buffer, 1, size, handle);
+    hostIoStats.bytesRead += n;
+    return static_cast<int>(n);
+  }
+  int read() {
+    uint8_t b;
+    return read(&b, 1) == 1 ? b : -1;
+  }
+
+  bool seek(const uint64_t pos) {
+    hostIoStats.seeks++;
+    return fseek(handle, static_cast<long>(pos), SEEK_SET) == 0;
+  }
+  bool seekCur(const int64_t offset) {
+    hostIoStats.seeks++;
+    return fseek(handle, static_cast<long>(offset), SEEK_CUR) == 0;
+  }
+  uint64_t position() const { return static_cast<uint64_t>(ftell(handle)); }
+  uint64_t size() const {
+    struct stat st = {};
+    return fstat(fileno(handle), &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+  }
+  int available() const { return static_cast<int>(size() - position()); }
+  void flush() override { fflush(handle); }
+  void close() {
+    if (handle) {
+      fclose(handle);
+      handle = nullptr;
+    }
+  }
+};
+
+class HalStorage {
+ public:
+  bool exists(const char* path) {
+    struct stat st = {};
+    return stat(path, &st) == 0;
+  }
+  bool remove(const char* path) { return ::remove(path) == 0; }
+  bool mkdir(const char* path, bool = true) { return ::mkdir(path, 0755) == 0 || exists(path); }
+
+  bool openFileForRead(const char*, const std::string& path, FsFile& file) { return openFile(path, "rb", file); }
+  bool openFileForRead(const char* moduleName, const char* path, FsFile& file) {
+    return openFileForRead(moduleName, std::string(path), file);
+  }
+  bool openFileForWrite(const char*, const std::string& path, FsFile& file) { return openFile(path, "w+b", file); }
+  bool openFileForWrite(const char* moduleName, const char* path, FsFile& file) {
+    return openFileForWrite(moduleName, std::string(path), file);
+  }
+
+  static HalStorage& getInstance() {
+    static HalStorage instance;
+    return instance;
+  }
+
+ private:
+  static bool openFile(const std::string& path, const char* mode, FsFile& file) {
+    hostIoStats.opens++;
+    FILE* handle = fopen(path.c_str(), mode);
+    file = FsFile(handle);
+    return handle != nullptr;
+  }
+};
+
+#define Storage HalStorage::getInstance()
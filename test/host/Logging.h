@@ -0,0 +1,8 @@
+#pragma once
+
+#include <cstdio>
+
+// Host logging: errors go to stderr, everything else is dropped to keep tool output clean.
+#define LOG_ERR(origin, format, ...) fprintf(stderr, "[ERR] [" origin "] " format "\n", ##__VA_ARGS__)
+#define LOG_INF(origin, format, ...)
+#define LOG_DBG(origin, format, ...)
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Reads a zip's central directory straight from disk with stdio, independently of ZipFile, so host tools have a
+// ground truth to check ZipFile against. I/O done here is not counted in hostIoStats.
+
+struct ZipListingEntry {
+  std::string name;
+  uint16_t method;
+  uint32_t crc32;
+  uint32_t compressedSize;
+  uint32_t uncompressedSize;
+};
+
+namespace zip_listing {
+inline uint16_t le16(const uint8_t* p) { return static_cast<uint16_t>(p[0] | p[1] << 8); }
+inline uint32_t le32(const uint8_t* p) { return p[0] | p[1] << 8 | p[2] << 16 | static_cast<uint32_t>(p[3]) << 24; }
+}  // namespace zip_listing
+
+inline std::vector<ZipListingEntry> listZipEntries(const std::string& path) {
+  using zip_listing::le16;
+  using zip_listing::le32;
+
+  std::vector<ZipListingEntry> entries;
+  FILE* f = fopen(path.c_str(), "rb");
+  if (!f) {
+    return entries;
+  }
+  fseek(f, 0, SEEK_END);
+  const long fileSize = ftell(f);
+  const long scan = std::min<long>(fileSize, 1024);
+  std::vector<uint8_t> tail(scan);
+  fseek(f, fileSize - scan, SEEK_SET);
+  if (fread(tail.data(), 1, scan, f) != static_cast<size_t>(scan)) {
+    fclose(f);
+    return entries;
+  }
+
+  long eocd = -1;
+  for (long i = scan - 22; i >= 0; i--) {
+    if (le32(&tail[i]) == 0x06054b50) {
+      eocd = i;
+      break;
+    }
+  }
+  if (eocd < 0) {
+    fclose(f);
+    return entries;
+  }
+
+  const uint16_t total = le16(&tail[eocd + 10]);
+  fseek(f, le32(&tail[eocd + 16]), SEEK_SET);
+  for (uint16_t i = 0; i < total; i++) {
+    uint8_t header[46];
+    if (fread(header, 1, sizeof(header), f) != sizeof(header) || le32(header) != 0x02014b50) {
+      break;
+    }
+    ZipListingEntry entry{std::string(le16(header + 28), '\0'), le16(header + 10), le32(header + 16),
+                          le32(header + 20), le32(header + 24)};
+    if (fread(entry.name.data(), 1, entry.name.size(), f) != entry.name.size()) {
+      break;
+    }
+    fseek(f, le16(header + 30) + le16(header + 32), SEEK_CUR);
+    if (!entry.name.empty() && entry.name.back() != '/') {
+      entries.push_back(std::move(entry));
+    }
+  }
+  fclose(f);
+  return entries;
+}
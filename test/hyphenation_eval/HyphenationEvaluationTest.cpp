@@ -2,9 +2,12 @@
 
 #include <algorithm>
 #include <cctype>
+#include <chrono>
 #include <cmath>
+#include <cstdlib>
 #include <fstream>
 #include <functional>
+#include <iomanip>
 #include <iostream>
 #include <sstream>
 #include <string>
@@ -14,6 +17,58 @@
 #include "lib/Epub/Epub/hyphenation/LanguageHyphenator.h"
 #include "lib/Epub/Epub/hyphenation/LanguageRegistry.h"
 
+// Usage: HyphenationEvaluationTest [language|all]
+//        HyphenationEvaluationTest --benchmark [language|all] [--min-seconds S] [--json FILE] [--baseline FILE]
+//                                  [--max-regression PERCENT]
+//
+// Without arguments prints the F1 score per language; with a language prints detailed results for it.
+// --benchmark hyphenates every word of each language's corpus, as layout does (collect codepoints, trim, run the
+// patterns), for at least S seconds per language (default 1). It reports words/second (best of 5 rounds), heap
+// allocations per word and trie nodes visited per word. --json writes those figures as JSON, and --baseline compares
+// against such a file and fails if any language allocates more or visits more trie nodes per word. Those two are
+// deterministic, so the gate gives the same answer on any host. words/s is only compared for information, unless
+// --max-regression is given: then a language more than PERCENT slower fails too. Throughput is only comparable on the
+// same machine, so only gate it against a baseline recorded there before the change. run_hyphenation_eval.sh
+// compares against test/hyphenation_eval/benchmark_baseline.json unless given another baseline.
+
+#ifdef HOST_HEAP_TRACKING
+// Linked with -Wl,--wrap=malloc,... so every allocation made while hyphenating is counted
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+}
+
+namespace {
+uint64_t allocationCount = 0;
+}  // namespace
+
+extern "C" {
+void* __wrap_malloc(const size_t size) {
+  allocationCount++;
+  return __real_malloc(size);
+}
+void* __wrap_calloc(const size_t count, const size_t size) {
+  allocationCount++;
+  return __real_calloc(count, size);
+}
+void* __wrap_realloc(void* ptr, const size_t size) {
+  allocationCount++;
+  return __real_realloc(ptr, size);
+}
+}
+
+void* operator new(const size_t size) {
+  void* ptr = malloc(size);
+  if (!ptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+#endif
+
 struct TestCase {
   std::string word;
   std::string hyphenated;
@@ -129,10 +184,20 @@ std::string positionsToHyphenated(const std::string& word, const std::vector<siz
 }
 
 std::vector<size_t> hyphenateWordWithHyphenator(const std::string& word, const LanguageHyphenator& hyphenator) {
-  auto cps = collectCodepoints(word);
+  WordCodepoints cps;
+  if (!collectCodepoints(word.c_str(), word.size(), cps)) {
+    return {};
+  }
   trimSurroundingPunctuationAndFootnote(cps);
 
-  return hyphenator.breakIndexes(cps);
+  const BreakIndexSet breaks = hyphenator.breakIndexes(cps);
+  std::vector<size_t> positions;
+  for (size_t i = 0; i < breaks.size(); ++i) {
+    if (breaks[i]) {
+      positions.push_back(i);
+    }
+  }
+  return positions;
 }
 
 std::vector<LanguageConfig> resolveLanguages(const std::string& selection) {
@@ -302,7 +367,205 @@ void printResults(const std::string& language, const std::vector<TestCase>& test
   }
 }
 
+constexpr int BENCHMARK_ROUNDS = 5;
+
+struct BenchmarkResult {
+  std::string language;
+  size_t words = 0;
+  double wordsPerSecond = 0.0;
+  double allocationsPerWord = 0.0;
+  double nodeVisitsPerWord = 0.0;
+};
+
+uint64_t allocationsSoFar() {
+#ifdef HOST_HEAP_TRACKING
+  return allocationCount;
+#else
+  return 0;
+#endif
+}
+
+uint64_t nodeVisitsSoFar() {
+#ifdef LIANG_COUNT_NODE_VISITS
+  return liangNodeVisits;
+#else
+  return 0;
+#endif
+}
+
+BenchmarkResult benchmarkLanguage(const LanguageConfig& lang, const LanguageHyphenator& hyphenator,
+                                  const double minSeconds) {
+  BenchmarkResult result;
+  result.language = lang.cliName;
+
+  // Words are copied out of the test cases first so only hyphenation is timed
+  std::vector<std::string> words;
+  for (const auto& testCase : loadTestData(lang.testDataFile)) {
+    words.push_back(testCase.word);
+  }
+  result.words = words.size();
+  if (words.empty()) {
+    return result;
+  }
+
+  WordCodepoints cps;
+  size_t checksum = 0;
+  uint64_t hyphenated = 0;
+  const uint64_t allocationsBefore = allocationsSoFar();
+  const uint64_t visitsBefore = nodeVisitsSoFar();
+  // The fastest of several rounds is reported, it is the least disturbed by the rest of the machine
+  for (int round = 0; round < BENCHMARK_ROUNDS; round++) {
+    uint64_t roundWords = 0;
+    const auto start = std::chrono::steady_clock::now();
+    double seconds = 0.0;
+    do {
+      for (const auto& word : words) {
+        if (collectCodepoints(word.c_str(), word.size(), cps)) {
+          trimSurroundingPunctuationAndFootnote(cps);
+          checksum += hyphenator.breakIndexes(cps).count();
+        }
+      }
+      roundWords += words.size();
+      seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while (seconds < minSeconds / BENCHMARK_ROUNDS);
+    result.wordsPerSecond = std::max(result.wordsPerSecond, roundWords / seconds);
+    hyphenated += roundWords;
+  }
+
+  result.allocationsPerWord = static_cast<double>(allocationsSoFar() - allocationsBefore) / hyphenated;
+  result.nodeVisitsPerWord = static_cast<double>(nodeVisitsSoFar() - visitsBefore) / hyphenated;
+  // Keeps the loop from being optimized away
+  if (checksum == 0) {
+    std::cerr << "No hyphenation points found for " << lang.cliName << std::endl;
+  }
+  return result;
+}
+
+bool writeBenchmarkJson(const std::string& path, const std::vector<BenchmarkResult>& results) {
+  std::ofstream out(path);
+  if (!out.is_open()) {
+    std::cerr << "Error: Could not write " << path << std::endl;
+    return false;
+  }
+  out << std::fixed << std::setprecision(2) << "{" << std::endl;
+  for (size_t i = 0; i < results.size(); i++) {
+    const auto& result = results[i];
+    out << "  \"" << result.language << "\": {\"words\": " << result.words << ", \"wordsPerSecond\": "
+        << result.wordsPerSecond << ", \"allocationsPerWord\": " << result.allocationsPerWord
+        << ", \"nodeVisitsPerWord\": " << result.nodeVisitsPerWord << "}" << (i + 1 < results.size() ? "," : "")
+        << std::endl;
+  }
+  out << "}" << std::endl;
+  return true;
+}
+
+// Reads a figure of one language back from a file written by writeBenchmarkJson. Returns a negative value if the
+// language or the field is missing.
+double readBaselineField(const std::string& json, const std::string& language, const std::string& field) {
+  const size_t entry = json.find("\"" + language + "\"");
+  if (entry == std::string::npos) {
+    return -1.0;
+  }
+  const size_t entryEnd = json.find('}', entry);
+  const size_t key = json.find("\"" + field + "\":", entry);
+  if (key == std::string::npos || key > entryEnd) {
+    return -1.0;
+  }
+  return std::strtod(json.c_str() + key + field.size() + 3, nullptr);
+}
+
+int runBenchmark(int argc, char* argv[]) {
+  std::string languageSelection = "all";
+  std::string jsonPath;
+  std::string baselinePath;
+  double minSeconds = 1.0;
+  double maxRegressionPercent = -1.0;  // Throughput is not gated unless asked for
+  for (int i = 2; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg == "--min-seconds" && i + 1 < argc) {
+      minSeconds = std::stod(argv[++i]);
+    } else if (arg == "--json" && i + 1 < argc) {
+      jsonPath = argv[++i];
+    } else if (arg == "--baseline" && i + 1 < argc) {
+      baselinePath = argv[++i];
+    } else if (arg == "--max-regression" && i + 1 < argc) {
+      maxRegressionPercent = std::stod(argv[++i]);
+    } else {
+      languageSelection = arg;
+    }
+  }
+
+  const std::vector<LanguageConfig> languages = resolveLanguages(languageSelection);
+  if (languages.empty()) {
+    std::cerr << "Unknown language: " << languageSelection << std::endl;
+    return 1;
+  }
+
+  std::string baseline;
+  if (!baselinePath.empty()) {
+    std::ifstream in(baselinePath);
+    if (!in.is_open()) {
+      std::cerr << "Error: Could not open baseline " << baselinePath << std::endl;
+      return 1;
+    }
+    std::stringstream contents;
+    contents << in.rdbuf();
+    baseline = contents.str();
+  }
+
+  std::vector<BenchmarkResult> results;
+  bool ok = true;
+  std::cout << std::left << std::setw(10) << "language" << std::right << std::setw(8) << "words" << std::setw(14)
+            << "words/s" << std::setw(12) << "allocs/word" << std::setw(12) << "nodes/word"
+            << (baseline.empty() ? "" : "   vs baseline") << std::endl;
+  for (const auto& lang : languages) {
+    const auto* hyphenator = getLanguageHyphenatorForPrimaryTag(lang.primaryTag);
+    if (!hyphenator) {
+      std::cerr << "No hyphenator registered for tag: " << lang.primaryTag << std::endl;
+      ok = false;
+      continue;
+    }
+    const BenchmarkResult result = benchmarkLanguage(lang, *hyphenator, minSeconds);
+    if (result.words == 0) {
+      std::cerr << "No test cases loaded for " << lang.cliName << ". Skipping." << std::endl;
+      continue;
+    }
+    results.push_back(result);
+
+    std::cout << std::left << std::setw(10) << result.language << std::right << std::setw(8) << result.words
+              << std::fixed << std::setprecision(0) << std::setw(14) << result.wordsPerSecond << std::setprecision(2)
+              << std::setw(12) << result.allocationsPerWord << std::setw(12) << result.nodeVisitsPerWord;
+    if (!baseline.empty()) {
+      const double baselineWordsPerSecond = readBaselineField(baseline, result.language, "wordsPerSecond");
+      const double baselineAllocations = readBaselineField(baseline, result.language, "allocationsPerWord");
+      const double baselineNodeVisits = readBaselineField(baseline, result.language, "nodeVisitsPerWord");
+      if (baselineWordsPerSecond > 0 && baselineAllocations >= 0 && baselineNodeVisits >= 0) {
+        const double changePercent = (result.wordsPerSecond / baselineWordsPerSecond - 1.0) * 100.0;
+        const bool slower = maxRegressionPercent >= 0 && changePercent < -maxRegressionPercent;
+        // The baseline holds two decimals
+        const bool moreWork = result.allocationsPerWord > baselineAllocations + 0.005 ||
+                              result.nodeVisitsPerWord > baselineNodeVisits + 0.005;
+        std::cout << std::showpos << std::setprecision(1) << std::setw(11) << changePercent << "%" << std::noshowpos
+                  << (slower ? "   REGRESSION" : "") << (moreWork ? "   MORE WORK PER WORD" : "");
+        ok = !slower && !moreWork && ok;
+      } else {
+        std::cout << "   (not in baseline)";
+      }
+    }
+    std::cout << std::endl;
+  }
+
+  if (!jsonPath.empty()) {
+    ok = writeBenchmarkJson(jsonPath, results) && ok;
+  }
+  return ok ? 0 : 1;
+}
+
 int main(int argc, char* argv[]) {
+  if (argc > 1 && std::string(argv[1]) == "--benchmark") {
+    return runBenchmark(argc, argv);
+  }
+
   const bool summaryMode = argc <= 1;
   const std::string languageSelection = summaryMode ? "all" : argv[1];
 
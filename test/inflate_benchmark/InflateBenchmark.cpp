@@ -0,0 +1,214 @@
+#include <HalStorage.h>
+#include <InflateBackend.h>
+#include <ZipFile.h>
+#include <ZipListing.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Inflate throughput of the build-time selected ZipFile inflate backend over every deflated entry of the given EPUBs.
+// Runs each entry through readFileToStream (32KB window, as chapters and images are read) and readFileToMemory
+// (one-shot, as covers and small items are read), checks the output CRC against the central directory and reports
+// MB/s and peak heap. Built once per backend by test/run_inflate_benchmark.sh.
+//
+// Usage: InflateBenchmark [--min-seconds S] file.epub ...
+
+#ifdef HOST_HEAP_TRACKING
+// Linked with -Wl,--wrap=malloc,... so every allocation ZipFile makes is counted
+#include <malloc.h>
+
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+}
+
+namespace {
+size_t heapInUse = 0;
+size_t heapPeak = 0;
+
+void* trackAllocation(void* ptr) {
+  if (ptr) {
+    heapInUse += malloc_usable_size(ptr);
+    heapPeak = std::max(heapPeak, heapInUse);
+  }
+  return ptr;
+}
+}  // namespace
+
+extern "C" {
+void* __wrap_malloc(const size_t size) { return trackAllocation(__real_malloc(size)); }
+void* __wrap_calloc(const size_t count, const size_t size) { return trackAllocation(__real_calloc(count, size)); }
+void* __wrap_realloc(void* ptr, const size_t size) {
+  if (ptr) {
+    heapInUse -= malloc_usable_size(ptr);
+  }
+  return trackAllocation(__real_realloc(ptr, size));
+}
+void __wrap_free(void* ptr) {
+  if (ptr) {
+    heapInUse -= malloc_usable_size(ptr);
+  }
+  __real_free(ptr);
+}
+}
+
+void* operator new(const size_t size) {
+  void* ptr = malloc(size);
+  if (!ptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+#endif
+
+namespace {
+
+// Discards output while keeping a running CRC so every backend is checked against the stored checksum
+class CrcSink final : public Print {
+ public:
+  mz_ulong crc = MZ_CRC32_INIT;
+  size_t bytes = 0;
+
+  size_t write(const uint8_t b) override { return write(&b, 1); }
+  size_t write(const uint8_t* buffer, const size_t size) override {
+    crc = mz_crc32(crc, buffer, size);
+    bytes += size;
+    return size;
+  }
+};
+
+struct ModeResult {
+  double seconds = 0;
+  uint64_t bytes = 0;
+  size_t peakHeap = 0;
+  bool ok = true;
+};
+
+size_t currentPeak() {
+#ifdef HOST_HEAP_TRACKING
+  return heapPeak;
+#else
+  return 0;
+#endif
+}
+
+void resetPeak() {
+#ifdef HOST_HEAP_TRACKING
+  heapPeak = heapInUse;
+#endif
+}
+
+template <typename Fn>
+ModeResult runMode(const double minSeconds, Fn&& inflateAll) {
+  ModeResult result;
+  resetPeak();
+#ifdef HOST_HEAP_TRACKING
+  const size_t baseline = heapInUse;
+#else
+  const size_t baseline = 0;
+#endif
+  const auto start = std::chrono::steady_clock::now();
+  do {
+    uint64_t bytes = 0;
+    result.ok = inflateAll(bytes) && result.ok;
+    result.bytes += bytes;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  } while (result.seconds < minSeconds && result.ok);
+  result.peakHeap = currentPeak() - baseline;
+  return result;
+}
+
+void printRow(const std::string& mode, const ModeResult& result) {
+  const double mbPerSecond = result.seconds > 0 ? result.bytes / result.seconds / (1024.0 * 1024.0) : 0;
+  std::cout << "  " << std::left << std::setw(10) << mode << std::right << std::fixed << std::setprecision(1)
+            << std::setw(10) << mbPerSecond << " MB/s";
+#ifdef HOST_HEAP_TRACKING
+  std::cout << std::setw(10) << result.peakHeap << " B peak heap";
+#endif
+  std::cout << (result.ok ? "" : "   OUTPUT MISMATCH") << std::endl;
+}
+
+bool benchmarkEpub(const std::string& path, const double minSeconds) {
+  std::vector<ZipListingEntry> entries;
+  uint64_t inflatedBytes = 0;
+  for (auto& entry : listZipEntries(path)) {
+    if (entry.method == MZ_DEFLATED) {
+      inflatedBytes += entry.uncompressedSize;
+      entries.push_back(std::move(entry));
+    }
+  }
+  if (entries.empty()) {
+    std::cerr << "No deflated entries in " << path << std::endl;
+    return false;
+  }
+
+  // One context for the whole run, as Epub does for a book session
+  InflateContext context;
+
+  const auto stream = runMode(minSeconds, [&](uint64_t& bytes) {
+    bool ok = true;
+    for (const auto& entry : entries) {
+      CrcSink sink;
+      ok = ZipFile(path, {}, &context).readFileToStream(entry.name.c_str(), sink, 4096) && sink.crc == entry.crc32 &&
+           ok;
+      bytes += sink.bytes;
+    }
+    return ok;
+  });
+
+  const auto memory = runMode(minSeconds, [&](uint64_t& bytes) {
+    bool ok = true;
+    for (const auto& entry : entries) {
+      size_t size = 0;
+      uint8_t* data = ZipFile(path, {}, &context).readFileToMemory(entry.name.c_str(), &size);
+      ok = data && mz_crc32(MZ_CRC32_INIT, data, size) == entry.crc32 && ok;
+      bytes += size;
+      free(data);
+    }
+    return ok;
+  });
+
+  std::cout << path << " (" << entries.size() << " deflated entries, " << inflatedBytes << " bytes inflated)"
+            << std::endl;
+  printRow("stream", stream);
+  printRow("memory", memory);
+  std::cout << std::endl;
+  return stream.ok && memory.ok;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  double minSeconds = 1.0;
+  std::vector<std::string> epubs;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg == "--min-seconds" && i + 1 < argc) {
+      minSeconds = std::stod(argv[++i]);
+    } else {
+      epubs.push_back(arg);
+    }
+  }
+  if (epubs.empty()) {
+    std::cerr << "Usage: " << argv[0] << " [--min-seconds S] file.epub ..." << std::endl;
+    return 1;
+  }
+
+  std::cout << "Inflate backend: " << Inflater::BACKEND_NAME << " (state " << sizeof(Inflater) << " B, window "
+            << INFLATE_WINDOW_SIZE << " B)" << std::endl
+            << std::endl;
+
+  bool ok = true;
+  for (const auto& epub : epubs) {
+    ok = benchmarkEpub(epub, minSeconds) && ok;
+  }
+  return ok ? 0 : 1;
+}
@@ -24,9 +24,25 @@ CXXFLAGS=(
   -pedantic
   -I"$ROOT_DIR"
   -I"$ROOT_DIR/lib"
+  -I"$ROOT_DIR/lib/Fnv1a"
   -I"$ROOT_DIR/lib/Utf8"
+  -DLIANG_COUNT_NODE_VISITS
 )
 
-c++ "${CXXFLAGS[@]}" "${SOURCES[@]}" -o "$BINARY"
+LDFLAGS=()
+if [[ "$(uname)" == "Linux" ]]; then
+  # Count heap allocations by wrapping the allocator (GNU ld only)
+  CXXFLAGS+=(-DHOST_HEAP_TRACKING)
+  LDFLAGS+=(-Wl,--wrap=malloc -Wl,--wrap=calloc -Wl,--wrap=realloc)
+fi
+
+c++ "${CXXFLAGS[@]}" "${SOURCES[@]}" "${LDFLAGS[@]}" -o "$BINARY"
+
+# Benchmark runs are gated on the stored baseline unless another one is given. The gate checks allocations and trie
+# nodes per word, which do not depend on the host; words/s is only gated with --max-regression.
+BASELINE="$ROOT_DIR/test/hyphenation_eval/benchmark_baseline.json"
+if [[ "${1:-}" == "--benchmark" && " $* " != *" --baseline "* && -f "$BASELINE" ]]; then
+  set -- "$@" --baseline "$BASELINE"
+fi
 
 "$BINARY" "$@"
@@ -0,0 +1,51 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+ROOT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+BUILD_DIR="$ROOT_DIR/build/inflate_benchmark"
+
+# Inflate backends to compare, see lib/ZipFile/InflateBackend.h
+BACKENDS=(
+  TINFL
+)
+
+mkdir -p "$BUILD_DIR"
+
+DEFINES=(
+  -DMINIZ_NO_ZLIB_COMPATIBLE_NAMES=1
+  -DMINIZ_NO_STDIO=1
+)
+
+CXXFLAGS=(
+  -std=c++20
+  -O2
+  -Wall
+  -Wextra
+  -I"$ROOT_DIR/test/host"
+  -I"$ROOT_DIR/lib/ZipFile"
+  -I"$ROOT_DIR/lib/Fnv1a"
+  -I"$ROOT_DIR/lib/miniz"
+  "${DEFINES[@]}"
+)
+
+LDFLAGS=()
+if [[ "$(uname)" == "Linux" ]]; then
+  # Count heap usage by wrapping the allocator (GNU ld only)
+  CXXFLAGS+=(-DHOST_HEAP_TRACKING)
+  LDFLAGS+=(-Wl,--wrap=malloc -Wl,--wrap=calloc -Wl,--wrap=realloc -Wl,--wrap=free)
+fi
+
+# miniz is C; build it separately so it is not compiled as C++
+cc -O2 "${DEFINES[@]}" -c "$ROOT_DIR/lib/miniz/miniz.c" -o "$BUILD_DIR/miniz.o"
+
+if [[ $# -eq 0 ]]; then
+  set -- "$ROOT_DIR"/test/epubs/*.epub
+fi
+
+for backend in "${BACKENDS[@]}"; do
+  binary="$BUILD_DIR/InflateBenchmark_$backend"
+  c++ "${CXXFLAGS[@]}" -DZIP_INFLATE_BACKEND="ZIP_INFLATE_BACKEND_$backend" \
+    "$ROOT_DIR/test/inflate_benchmark/InflateBenchmark.cpp" "$ROOT_DIR/lib/ZipFile/ZipFile.cpp" "$BUILD_DIR/miniz.o" \
+    "${LDFLAGS[@]}" -o "$binary"
+  "$binary" "$@"
+done
@@ -0,0 +1,41 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+ROOT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+BUILD_DIR="$ROOT_DIR/build/section_size_report"
+BINARY="$BUILD_DIR/SectionSizeReport"
+
+mkdir -p "$BUILD_DIR"
+
+SOURCES=(
+  "$ROOT_DIR/test/section_size_report/SectionSizeReport.cpp"
+  "$ROOT_DIR/lib/Epub/Epub/PageCodec.cpp"
+  "$ROOT_DIR/lib/Epub/Epub/blocks/TextBlock.cpp"
+  "$ROOT_DIR/lib/ZipFile/ZipFile.cpp"
+)
+
+CXXFLAGS=(
+  -std=c++20
+  -O2
+  -Wall
+  -Wextra
+  -I"$ROOT_DIR/test/host"
+  -I"$ROOT_DIR/lib/Epub"
+  -I"$ROOT_DIR/lib/EpdFont"
+  -I"$ROOT_DIR/lib/Serialization"
+  -I"$ROOT_DIR/lib/ZipFile"
+  -I"$ROOT_DIR/lib/Fnv1a"
+  -I"$ROOT_DIR/lib/miniz"
+  -DMINIZ_NO_ZLIB_COMPATIBLE_NAMES=1
+  -DMINIZ_NO_STDIO=1
+)
+
+# miniz is C; build it separately so it is not compiled as C++
+cc -O2 -DMINIZ_NO_ZLIB_COMPATIBLE_NAMES=1 -DMINIZ_NO_STDIO=1 -c "$ROOT_DIR/lib/miniz/miniz.c" -o "$BUILD_DIR/miniz.o"
+c++ "${CXXFLAGS[@]}" "${SOURCES[@]}" "$BUILD_DIR/miniz.o" -o "$BINARY"
+
+if [[ $# -eq 0 ]]; then
+  set -- "$ROOT_DIR"/test/epubs/*.epub
+fi
+
+"$BINARY" "$BUILD_DIR" "$@"
@@ -0,0 +1,281 @@
+#include <Epub/PageCodec.h>
+#include <Epub/blocks/TextBlock.h>
+#include <GfxRenderer.h>
+#include <HalStorage.h>
+#include <ZipFile.h>
+#include <ZipListing.h>
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Size of section page records in the current encoding (Epub/PageCodec.h) against the fixed-width encoding used up
+// to section file version 13. Each XHTML item of the given EPUBs is split into words (with bold/italic from <b>,
+// <strong>, <i> and <em>) and laid out on a fixed-advance grid into pages shaped like the reader's, then every page
+// is written both ways. The new records are read back through PageView to check they survive the round trip.
+//
+// Usage: SectionSizeReport <work dir> [file.epub ...]
+
+namespace {
+
+constexpr int VIEWPORT_WIDTH = 464;
+constexpr int LINE_HEIGHT = 22;
+constexpr int LINES_PER_PAGE = 34;
+constexpr int SPACE_WIDTH = 5;
+
+struct Line {
+  std::list<std::string> words;
+  std::list<uint16_t> xpos;
+  std::list<EpdFontFamily::Style> styles;
+  BlockStyle blockStyle;
+};
+
+struct Paragraph {
+  std::vector<std::pair<std::string, EpdFontFamily::Style>> words;
+  bool heading = false;
+};
+
+struct Totals {
+  uint64_t pages = 0;
+  uint64_t lines = 0;
+  uint64_t words = 0;
+  uint64_t legacyBytes = 0;
+  uint64_t compactBytes = 0;
+  uint64_t legacyReads = 0;
+  uint64_t compactReads = 0;
+  bool roundTripOk = true;
+};
+
+// Crude XHTML to paragraphs: enough structure to produce realistic word, style and paragraph statistics
+std::vector<Paragraph> extractParagraphs(const std::string& html) {
+  std::vector<Paragraph> paragraphs(1);
+  int bold = 0;
+  int italic = 0;
+  bool inBody = html.find("<body") == std::string::npos;
+  std::string word;
+
+  const auto flushWord = [&] {
+    if (!word.empty() && inBody) {
+      const auto style = static_cast<EpdFontFamily::Style>((bold > 0 ? EpdFontFamily::BOLD : 0) |
+                                                           (italic > 0 ? EpdFontFamily::ITALIC : 0));
+      paragraphs.back().words.emplace_back(word, style);
+    }
+    word.clear();
+  };
+  const auto endParagraph = [&] {
+    flushWord();
+    if (!paragraphs.back().words.empty()) {
+      paragraphs.emplace_back();
+    }
+  };
+
+  for (size_t i = 0; i < html.size(); i++) {
+    const char c = html[i];
+    if (c == '<') {
+      const size_t end = html.find('>', i);
+      if (end == std::string::npos) break;
+      std::string tag = html.substr(i + 1, end - i - 1);
+      i = end;
+      const bool closing = !tag.empty() && tag[0] == '/';
+      if (closing) tag.erase(0, 1);
+      tag = tag.substr(0, tag.find_first_of(" \t\r\n/"));
+      for (auto& ch : tag) ch = static_cast<char>(tolower(ch));
+
+      if (tag == "body") {
+        inBody = !closing;
+      } else if (tag == "b" || tag == "strong") {
+        flushWord();
+        bold += closing ? -1 : 1;
+      } else if (tag == "i" || tag == "em") {
+        flushWord();
+        italic += closing ? -1 : 1;
+      } else if (tag == "p" || tag == "div" || tag == "br" || tag == "li" || tag == "blockquote" ||
+                 (tag.size() == 2 && tag[0] == 'h' && tag[1] >= '1' && tag[1] <= '6')) {
+        endParagraph();
+        paragraphs.back().heading = !closing && tag[0] == 'h' && tag.size() == 2;
+      }
+    } else if (isspace(static_cast<unsigned char>(c))) {
+      flushWord();
+    } else {
+      word += c;
+    }
+  }
+  endParagraph();
+  paragraphs.pop_back();
+  return paragraphs;
+}
+
+// Greedy fixed-advance layout into pages of lines, positions as ParsedText would produce for justified text
+std::vector<std::vector<Line>> layOut(const std::vector<Paragraph>& paragraphs) {
+  std::vector<std::vector<Line>> pages(1);
+  const auto addLine = [&](Line line) {
+    if (pages.back().size() >= LINES_PER_PAGE) pages.emplace_back();
+    pages.back().push_back(std::move(line));
+  };
+
+  for (const auto& paragraph : paragraphs) {
+    BlockStyle blockStyle;
+    blockStyle.textIndentDefined = true;
+    blockStyle.textIndent = paragraph.heading ? 0 : 20;
+    blockStyle.alignment = paragraph.heading ? CssTextAlign::Center : CssTextAlign::Justify;
+    blockStyle.textAlignDefined = paragraph.heading;
+    blockStyle.marginBottom = paragraph.heading ? 22 : 0;
+
+    Line line;
+    line.blockStyle = blockStyle;
+    int x = blockStyle.textIndent;
+    for (const auto& [text, style] : paragraph.words) {
+      const int width = GfxRenderer::HOST_ADVANCE * static_cast<int>(text.size());
+      if (!line.words.empty() && x + width > VIEWPORT_WIDTH) {
+        addLine(std::move(line));
+        line = Line();
+        line.blockStyle = blockStyle;
+        x = 0;
+      }
+      line.words.push_back(text);
+      line.xpos.push_back(static_cast<uint16_t>(x));
+      line.styles.push_back(style);
+      x += width + SPACE_WIDTH;
+    }
+    if (!line.words.empty()) addLine(std::move(line));
+  }
+  if (pages.back().empty()) pages.pop_back();
+  return pages;
+}
+
+// Bytes and field reads of a page in the version 13 encoding: u16 element count, then per line a tag, two int16
+// positions, u16 word count, u32-length-prefixed words, u16 x positions, a style byte per word and 12 BlockStyle fields
+void addLegacySize(const std::vector<Line>& page, Totals& totals) {
+  constexpr size_t blockStyleBytes = sizeof(CssTextAlign) + 2 * sizeof(bool) + 9 * sizeof(int16_t);
+  totals.legacyBytes += sizeof(uint16_t);
+  totals.legacyReads += 1;
+  for (const auto& line : page) {
+    totals.legacyBytes += sizeof(uint8_t) + 2 * sizeof(int16_t) + sizeof(uint16_t) + blockStyleBytes;
+    totals.legacyReads += 4 + 12;
+    for (const auto& word : line.words) {
+      totals.legacyBytes += sizeof(uint32_t) + word.size() + sizeof(uint16_t) + sizeof(uint8_t);
+      totals.legacyReads += 4;
+    }
+  }
+}
+
+// Mirrors Page::serialize for a page of text lines
+bool writePage(const std::vector<std::shared_ptr<TextBlock>>& blocks, const std::vector<int16_t>& ys, FsFile& file) {
+  PageWriter writer;
+  writer.writeVarUint(blocks.size());
+  for (size_t i = 0; i < blocks.size(); i++) {
+    writer.writeByte(1);  // TAG_PageLine
+    writer.writeVarInt(0);
+    writer.writeVarInt(ys[i]);
+    if (!blocks[i]->serialize(writer)) return false;
+  }
+  return writer.flush(file);
+}
+
+// Loads a page record the way the reader does and compares it with the lines it was written from
+bool readPageMatches(FsFile& file, const std::vector<Line>& page, PageView& view) {
+  if (!view.load(file) || view.getLines().size() != page.size() || view.hasImages()) return false;
+  for (size_t i = 0; i < page.size(); i++) {
+    const auto& loaded = view.getLines()[i];
+    const auto& line = page[i];
+    if (loaded.y != static_cast<int16_t>(i * LINE_HEIGHT) || loaded.wordCount != line.words.size()) return false;
+    auto word = line.words.begin();
+    auto x = line.xpos.begin();
+    auto style = line.styles.begin();
+    for (size_t w = loaded.firstWord; w < loaded.firstWord + loaded.wordCount; w++, ++word, ++x, ++style) {
+      if (*word != view.getWord(w) || *x != view.getWordX(w) || *style != view.getWordStyle(w)) return false;
+    }
+  }
+  return true;
+}
+
+void reportItem(const std::vector<std::vector<Line>>& pages, const std::string& workDir, Totals& totals) {
+  const std::string path = workDir + "/section_size_report.bin";
+  std::vector<uint64_t> offsets;
+
+  {
+    FsFile file;
+    Storage.openFileForWrite("SSR", path, file);
+    for (const auto& page : pages) {
+      std::vector<std::shared_ptr<TextBlock>> blocks;
+      std::vector<int16_t> ys;
+      for (const auto& line : page) {
+        blocks.push_back(std::make_shared<TextBlock>(line.words, line.xpos, line.styles, line.blockStyle));
+        ys.push_back(static_cast<int16_t>(ys.size() * LINE_HEIGHT));
+        totals.words += line.words.size();
+      }
+      offsets.push_back(file.position());
+      totals.roundTripOk = writePage(blocks, ys, file) && totals.roundTripOk;
+      totals.lines += page.size();
+      addLegacySize(page, totals);
+    }
+    totals.compactBytes += file.position();
+    totals.compactReads += 2 * pages.size();
+    totals.pages += pages.size();
+  }
+
+  FsFile in;
+  PageView view;
+  Storage.openFileForRead("SSR", path, in);
+  for (size_t i = 0; i < pages.size(); i++) {
+    in.seek(offsets[i]);
+    totals.roundTripOk = readPageMatches(in, pages[i], view) && totals.roundTripOk;
+  }
+  in.close();
+  Storage.remove(path.c_str());
+}
+
+bool isXhtml(const std::string& name) {
+  for (const char* ext : {".xhtml", ".html", ".htm"}) {
+    const size_t len = strlen(ext);
+    if (name.size() > len && name.compare(name.size() - len, len, ext) == 0) return true;
+  }
+  return false;
+}
+
+bool reportEpub(const std::string& path, const std::string& workDir) {
+  Totals totals;
+  for (const auto& entry : listZipEntries(path)) {
+    if (!isXhtml(entry.name)) continue;
+    size_t size = 0;
+    uint8_t* data = ZipFile(path).readFileToMemory(entry.name.c_str(), &size);
+    if (!data) {
+      std::cerr << "Could not read " << entry.name << " from " << path << std::endl;
+      return false;
+    }
+    const std::string html(reinterpret_cast<const char*>(data), size);
+    free(data);
+    reportItem(layOut(extractParagraphs(html)), workDir, totals);
+  }
+
+  const auto ratio = [](const uint64_t a, const uint64_t b) { return b ? 100.0 * a / b : 0.0; };
+  std::cout << path << " (" << totals.pages << " pages, " << totals.lines << " lines, " << totals.words << " words)"
+            << std::endl;
+  std::cout << "  v13 fixed width   " << std::setw(10) << totals.legacyBytes << " B" << std::setw(10)
+            << std::fixed << std::setprecision(1) << (totals.pages ? 1.0 * totals.legacyReads / totals.pages : 0)
+            << " reads/page" << std::endl;
+  std::cout << "  v14 compact       " << std::setw(10) << totals.compactBytes << " B" << std::setw(10)
+            << (totals.pages ? 1.0 * totals.compactReads / totals.pages : 0) << " reads/page   "
+            << ratio(totals.compactBytes, totals.legacyBytes) << "% of v13" << std::endl;
+  std::cout << "  round trip " << (totals.roundTripOk ? "ok" : "FAILED") << std::endl << std::endl;
+  return totals.roundTripOk;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0] << " <work dir> file.epub ..." << std::endl;
+    return 1;
+  }
+
+  bool ok = true;
+  for (int i = 2; i < argc; i++) {
+    ok = reportEpub(argv[i], argv[1]) && ok;
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,232 @@
+#include <HalStorage.h>
+#include <ZipFile.h>
+#include <ZipListing.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Counts SD card operations per ZipFile entry lookup with and without the on-SD central directory index.
+//
+// Usage: ZipIndexBenchmark <work dir> [--synthetic N] [file.epub ...]
+
+namespace {
+
+struct LookupResult {
+  bool found;
+  size_t size;
+};
+
+struct ModeStats {
+  std::string name;
+  HostIoStats io;
+  size_t lookups = 0;
+};
+
+void putLe16(std::vector<uint8_t>& out, const uint16_t v) {
+  out.push_back(v & 0xFF);
+  out.push_back(v >> 8);
+}
+
+void putLe32(std::vector<uint8_t>& out, const uint32_t v) {
+  putLe16(out, v & 0xFFFF);
+  putLe16(out, v >> 16);
+}
+
+// Writes a stored-only zip with `count` small entries, shaped like an image-heavy comic
+bool writeSyntheticZip(const std::string& path, const int count) {
+  std::vector<uint8_t> body;
+  std::vector<uint8_t> centralDir;
+  const std::string payload = "synthetic entry payload";
+
+  for (int i = 0; i < count; i++) {
+    char name[64];
+    snprintf(name, sizeof(name), "OEBPS/images/page_%05d.jpg", i);
+    const auto nameLen = static_cast<uint16_t>(strlen(name));
+    const auto offset = static_cast<uint32_t>(body.size());
+
+    putLe32(body, 0x04034b50);
+    putLe16(body, 10);  // version needed
+    putLe16(body, 0);   // flags
+    putLe16(body, 0);   // stored
+    putLe32(body, 0);   // time/date
+    putLe32(body, 0);   // crc (not verified by ZipFile)
+    putLe32(body, payload.size());
+    putLe32(body, payload.size());
+    putLe16(body, nameLen);
+    putLe16(body, 0);
+    body.insert(body.end(), name, name + nameLen);
+    body.insert(body.end(), payload.begin(), payload.end());
+
+    putLe32(centralDir, 0x02014b50);
+    putLe16(centralDir, 20);  // version made by
+    putLe16(centralDir, 10);  // version needed
+    putLe16(centralDir, 0);   // flags
+    putLe16(centralDir, 0);   // stored
+    putLe32(centralDir, 0);   // time/date
+    putLe32(centralDir, 0);   // crc
+    putLe32(centralDir, payload.size());
+    putLe32(centralDir, payload.size());
+    putLe16(centralDir, nameLen);
+    putLe16(centralDir, 0);  // extra
+    putLe16(centralDir, 0);  // comment
+    putLe16(centralDir, 0);  // disk
+    putLe16(centralDir, 0);  // internal attrs
+    putLe32(centralDir, 0);  // external attrs
+    putLe32(centralDir, offset);
+    centralDir.insert(centralDir.end(), name, name + nameLen);
+  }
+
+  std::vector<uint8_t> eocd;
+  putLe32(eocd, 0x06054b50);
+  putLe16(eocd, 0);
+  putLe16(eocd, 0);
+  putLe16(eocd, count);
+  putLe16(eocd, count);
+  putLe32(eocd, centralDir.size());
+  putLe32(eocd, body.size());
+  putLe16(eocd, 0);
+
+  FILE* f = fopen(path.c_str(), "wb");
+  if (!f) {
+    return false;
+  }
+  fwrite(body.data(), 1, body.size(), f);
+  fwrite(centralDir.data(), 1, centralDir.size(), f);
+  fwrite(eocd.data(), 1, eocd.size(), f);
+  fclose(f);
+  return true;
+}
+
+LookupResult lookup(ZipFile& zip, const std::string& name) {
+  size_t size = 0;
+  const bool found = zip.getInflatedFileSize(name.c_str(), &size);
+  return {found, size};
+}
+
+// Runs every lookup in `order` and records the I/O spent. `perCall` mirrors Epub, which builds a fresh ZipFile for
+// each item access; otherwise one pre-opened ZipFile is shared.
+ModeStats runMode(const std::string& name, const std::string& zipPath, const std::string& indexPath,
+                  const std::vector<std::string>& order, const bool perCall, std::vector<LookupResult>& results) {
+  ModeStats stats;
+  stats.name = name;
+  results.clear();
+
+  hostIoStats.reset();
+  if (perCall) {
+    for (const auto& entry : order) {
+      ZipFile zip(zipPath, indexPath);
+      results.push_back(lookup(zip, entry));
+    }
+  } else {
+    ZipFile zip(zipPath, indexPath);
+    zip.open();
+    for (const auto& entry : order) {
+      results.push_back(lookup(zip, entry));
+    }
+    zip.close();
+  }
+  stats.io = hostIoStats;
+  stats.lookups = order.size();
+  return stats;
+}
+
+void printRow(const ModeStats& stats) {
+  const double n = stats.lookups ? static_cast<double>(stats.lookups) : 1.0;
+  std::cout << "  " << std::left << std::setw(24) << stats.name << std::right << std::fixed << std::setprecision(2)
+            << std::setw(10) << stats.io.opens / n << std::setw(10) << stats.io.reads / n << std::setw(10)
+            << stats.io.seeks / n << std::setw(14) << stats.io.bytesRead / n << std::endl;
+}
+
+bool benchmarkZip(const std::string& zipPath, const std::string& workDir) {
+  std::vector<std::string> names;
+  for (const auto& entry : listZipEntries(zipPath)) {
+    names.push_back(entry.name);
+  }
+  if (names.empty()) {
+    std::cerr << "No entries found in " << zipPath << std::endl;
+    return false;
+  }
+
+  // Lookups arrive in no particular order on device (spine order, images, CSS), so shuffle deterministically
+  std::vector<std::string> order = names;
+  std::mt19937 rng(1234);
+  std::shuffle(order.begin(), order.end(), rng);
+
+  const std::string indexPath = workDir + "/zip_index_benchmark.idx";
+  Storage.remove(indexPath.c_str());
+
+  std::vector<LookupResult> scanResults;
+  std::vector<LookupResult> indexResults;
+  std::vector<ModeStats> rows;
+
+  rows.push_back(runMode("scan (per call)", zipPath, "", order, true, scanResults));
+  rows.push_back(runMode("scan (shared handle)", zipPath, "", order, false, scanResults));
+
+  hostIoStats.reset();
+  {
+    ZipFile zip(zipPath, indexPath);
+    size_t ignored;
+    zip.getInflatedFileSize(names.front().c_str(), &ignored);
+  }
+  const HostIoStats buildIo = hostIoStats;
+
+  rows.push_back(runMode("index (per call)", zipPath, indexPath, order, true, indexResults));
+  rows.push_back(runMode("index (shared handle)", zipPath, indexPath, order, false, indexResults));
+
+  bool consistent = scanResults.size() == indexResults.size();
+  for (size_t i = 0; consistent && i < scanResults.size(); i++) {
+    consistent = scanResults[i].found && indexResults[i].found && scanResults[i].size == indexResults[i].size;
+  }
+
+  std::cout << zipPath << " (" << names.size() << " entries)" << std::endl;
+  std::cout << "  " << std::left << std::setw(24) << "mode" << std::right << std::setw(10) << "opens" << std::setw(10)
+            << "reads" << std::setw(10) << "seeks" << std::setw(14) << "bytes read" << "   (per lookup)" << std::endl;
+  for (const auto& row : rows) {
+    printRow(row);
+  }
+  std::cout << "  index build (one-off): " << buildIo.reads << " reads, " << buildIo.seeks << " seeks, "
+            << buildIo.writes << " writes" << std::endl;
+  std::cout << "  index results " << (consistent ? "match" : "DO NOT MATCH") << " central directory scan"
+            << std::endl
+            << std::endl;
+
+  Storage.remove(indexPath.c_str());
+  return consistent;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <work dir> [--synthetic N] [file.epub ...]" << std::endl;
+    return 1;
+  }
+
+  const std::string workDir = argv[1];
+  std::vector<std::string> zips;
+  for (int i = 2; i < argc; i++) {
+    const std::string arg = argv[i];
+    if (arg == "--synthetic" && i + 1 < argc) {
+      const int count = std::stoi(argv[++i]);
+      const std::string path = workDir + "/synthetic_" + std::to_string(count) + ".epub";
+      if (!writeSyntheticZip(path, count)) {
+        std::cerr << "Could not write " << path << std::endl;
+        return 1;
+      }
+      zips.push_back(path);
+    } else {
+      zips.push_back(arg);
+    }
+  }
+
+  bool ok = true;
+  for (const auto& zip : zips) {
+    ok = benchmarkZip(zip, workDir) && ok;
+  }
+  return ok ? 0 : 1;
+}